@@ -1,5 +1,47 @@
 #include <cc/bigint.h>
 #include <string.h>
+#include <ctype.h>
+
+/// @brief Check if `size` is the size of a native integer type
+static int cc__bigint_is_native(size_t size) {
+    return size == 1 || size == 2 || size == 4 || size == 8;
+}
+
+/// @brief Read a native integer of 1, 2, 4, or 8 bytes and zero-extend it
+static uint64_t cc__bigint_read_zext(size_t size, const void* src)
+{
+    switch (size)
+    {
+    case 1: return *(const uint8_t*)src;
+    case 2: return *(const uint16_t*)src;
+    case 4: return *(const uint32_t*)src;
+    default: return *(const uint64_t*)src;
+    }
+}
+
+/// @brief Read a native integer of 1, 2, 4, or 8 bytes and sign-extend it
+static int64_t cc__bigint_read_sext(size_t size, const void* src)
+{
+    switch (size)
+    {
+    case 1: return *(const int8_t*)src;
+    case 2: return *(const int16_t*)src;
+    case 4: return *(const int32_t*)src;
+    default: return *(const int64_t*)src;
+    }
+}
+
+/// @brief Write the low bytes of `src` as a native integer of 1, 2, 4, or 8 bytes
+static void cc__bigint_write(size_t size, void* dst, uint64_t src)
+{
+    switch (size)
+    {
+    case 1: *(uint8_t*)dst = (uint8_t)src; break;
+    case 2: *(uint16_t*)dst = (uint16_t)src; break;
+    case 4: *(uint32_t*)dst = (uint32_t)src; break;
+    default: *(uint64_t*)dst = src; break;
+    }
+}
 
 enum cc_bigint_endian cc_bigint_endianness()
 {
@@ -171,16 +213,16 @@ void cc__bigint_add_32(size_t size, void* dst, uint32_t src, int sign_bit)
     }
 }
 
-void cc_bigint_sub_32(size_t size, void* dst, const void* src, int sign_bit)
+void cc__bigint_sub_32(size_t size, void* dst, uint32_t src, int sign_bit)
 {
     if (size == 1)
-        *(uint8_t*)dst -= *(const uint8_t*)src;
+        *(int8_t*)dst -= (int8_t)src;
     else if (size == 2)
-        *(uint16_t*)dst -= *(const uint16_t*)src;
+        *(int16_t*)dst -= (int16_t)src;
     else if (size == 4)
-        *(uint32_t*)dst -= *(const uint32_t*)src;
+        *(int32_t*)dst -= (int32_t)src;
     else if (size == 8)
-        *(uint64_t*)dst -= *(const uint64_t*)src;
+        *(int64_t*)dst -= (int64_t)(int32_t)src;
     else
     {
         const int sign_extension = sign_bit ? -1 : 0;
@@ -192,7 +234,7 @@ void cc_bigint_sub_32(size_t size, void* dst, const void* src, int sign_bit)
             uint8_t rhs = (uint8_t)sign_extension;
             if (i < sizeof(src))
                 rhs = cc_bigint_byte(sizeof(src), &src, i);
-            carry = cc__bigint_sub_u8_carry(cc_bigint_byteptr(size, dst, i), cc_bigint_byte(size, src, i), carry);
+            carry = cc__bigint_sub_u8_carry(cc_bigint_byteptr(size, dst, i), rhs, carry);
         }
     }
 }
@@ -241,6 +283,13 @@ static void cc__bigint_mul_byte(size_t size, void* dst, uint8_t lhs, size_t lhs_
 
 void cc_bigint_mul(size_t size, void* dst, void* src)
 {
+    // The low bits of a product are the same for signed and unsigned operands
+    if (cc__bigint_is_native(size))
+    {
+        cc_bigint_umul(size, dst, src);
+        return;
+    }
+
     int lhs_signbit = cc_bigint_sign(size, dst);
     int rhs_signbit = cc_bigint_sign(size, src);
 
@@ -337,6 +386,24 @@ void cc_bigint_umul_u32(size_t size, void* dst, uint32_t src)
 
 void cc_bigint_div(size_t size, void* num, void* denom, void* quotient, void* remainder)
 {
+    if (cc__bigint_is_native(size))
+    {
+        int64_t lhs = cc__bigint_read_sext(size, num);
+        int64_t rhs = cc__bigint_read_sext(size, denom);
+        // INT64_MIN / -1 overflows. The quotient wraps to INT64_MIN, like every other width.
+        if (rhs == -1)
+        {
+            cc__bigint_write(size, quotient, 0 - (uint64_t)lhs);
+            cc__bigint_write(size, remainder, 0);
+        }
+        else
+        {
+            cc__bigint_write(size, quotient, (uint64_t)(lhs / rhs));
+            cc__bigint_write(size, remainder, (uint64_t)(lhs % rhs));
+        }
+        return;
+    }
+
     int lhs_signbit = cc_bigint_sign(size, num);
     int rhs_signbit = cc_bigint_sign(size, denom);
 
@@ -345,14 +412,13 @@ void cc_bigint_div(size_t size, void* num, void* denom, void* quotient, void* re
     if (rhs_signbit)
         cc_bigint_neg(size, denom);
     
-    cc_bigint_umul(size, num, denom);
-    int final_signbit = lhs_signbit ^ rhs_signbit;
+    cc_bigint_udiv(size, num, denom, quotient, remainder);
 
-    if (final_signbit)
-    {
+    // The quotient is truncated toward zero, and the remainder takes the sign of the numerator
+    if (lhs_signbit ^ rhs_signbit)
         cc_bigint_neg(size, quotient);
+    if (lhs_signbit)
         cc_bigint_neg(size, remainder);
-    }
 }
 
 void cc_bigint_udiv(size_t size, const void* num, const void* denom, void* quotient, void* remainder)
@@ -360,7 +426,7 @@ void cc_bigint_udiv(size_t size, const void* num, const void* denom, void* quoti
     if (size == 1)
     {
         *(uint8_t*)quotient = *(const uint8_t*)num / *(const uint8_t*)denom;
-        *(uint8_t*)remainder = *(const uint8_t*)num - *(const uint8_t*) num * *(uint8_t*)quotient;
+        *(uint8_t*)remainder = *(const uint8_t*)num - *(const uint8_t*)denom * *(uint8_t*)quotient;
     }
     else if (size == 2)
     {
@@ -429,44 +495,66 @@ void cc_bigint_udiv(size_t size, const void* num, const void* denom, void* quoti
 
 void cc_bigint_neg(size_t size, void* dst)
 {
+    if (cc__bigint_is_native(size))
+    {
+        cc__bigint_write(size, dst, 0 - cc__bigint_read_zext(size, dst));
+        return;
+    }
     cc_bigint_not(size, dst);
     cc_bigint_add_u32(size, dst, 1);
 }
 
 void cc_bigint_not(size_t size, void* dst)
 {
+    if (cc__bigint_is_native(size))
+    {
+        cc__bigint_write(size, dst, ~cc__bigint_read_zext(size, dst));
+        return;
+    }
     for (size_t i = 0; i < size; ++i)
         *((uint8_t*)dst + i) = ~*((uint8_t*)dst + i);
 }
 
 void cc_bigint_and(size_t size, void* dst, const void* src)
 {
+    if (cc__bigint_is_native(size))
+    {
+        cc__bigint_write(size, dst, cc__bigint_read_zext(size, dst) & cc__bigint_read_zext(size, src));
+        return;
+    }
     for (size_t i = 0; i < size; ++i)
         *((uint8_t*)dst + i) &= *((uint8_t*)src + i);
 }
 
 void cc_bigint_or(size_t size, void* dst, const void* src)
 {
+    if (cc__bigint_is_native(size))
+    {
+        cc__bigint_write(size, dst, cc__bigint_read_zext(size, dst) | cc__bigint_read_zext(size, src));
+        return;
+    }
     for (size_t i = 0; i < size; ++i)
         *((uint8_t*)dst + i) |= *((uint8_t*)src + i);
 }
 
 void cc_bigint_xor(size_t size, void* dst, const void* src)
 {
+    if (cc__bigint_is_native(size))
+    {
+        cc__bigint_write(size, dst, cc__bigint_read_zext(size, dst) ^ cc__bigint_read_zext(size, src));
+        return;
+    }
     for (size_t i = 0; i < size; ++i)
         *((uint8_t*)dst + i) ^= *((uint8_t*)src + i);
 }
 
 void cc_bigint_lsh(size_t size, void* dst, const void* src)
 {
-    if (size == 1)
-        *(uint8_t*)dst <<= *(const uint8_t*)src;
-    else if (size == 2)
-        *(uint16_t*)dst <<= *(const uint16_t*)src;
-    else if (size == 4)
-        *(uint32_t*)dst <<= *(const uint32_t*)src;
-    else if (size == 8)
-        *(uint64_t*)dst <<= *(const uint64_t*)src;
+    if (cc__bigint_is_native(size))
+    {
+        uint64_t shift_bits = cc__bigint_read_zext(size, src);
+        cc_bigint_lsh_u32(size, dst, shift_bits > UINT32_MAX ? UINT32_MAX : (uint32_t)shift_bits);
+    }
     else
     {
         uint32_t shift_bits = 0;
@@ -478,7 +566,10 @@ void cc_bigint_lsh(size_t size, void* dst, const void* src)
 
 void cc_bigint_lsh_u32(size_t size, void* dst, uint32_t src)
 {
-    if (size == 1)
+    // Shifting by the integer's width or more will clear it
+    if (cc__bigint_is_native(size) && src >= size * 8)
+        cc__bigint_write(size, dst, 0);
+    else if (size == 1)
         *(uint8_t*)dst <<= src;
     else if (size == 2)
         *(uint16_t*)dst <<= src;
@@ -523,14 +614,11 @@ void cc_bigint_lsh_u32(size_t size, void* dst, uint32_t src)
 
 void cc_bigint_rsh(size_t size, void* dst, const void* src)
 {
-    if (size == 1)
-        *(uint8_t*)dst >>= *(const uint8_t*)src;
-    else if (size == 2)
-        *(uint16_t*)dst >>= *(const uint16_t*)src;
-    else if (size == 4)
-        *(uint32_t*)dst >>= *(const uint32_t*)src;
-    else if (size == 8)
-        *(uint64_t*)dst >>= *(const uint64_t*)src;
+    if (cc__bigint_is_native(size))
+    {
+        uint64_t shift_bits = cc__bigint_read_zext(size, src);
+        cc_bigint_rsh_u32(size, dst, shift_bits > UINT32_MAX ? UINT32_MAX : (uint32_t)shift_bits);
+    }
     else
     {
         uint32_t shift_bits = 0;
@@ -542,7 +630,10 @@ void cc_bigint_rsh(size_t size, void* dst, const void* src)
 
 void cc_bigint_rsh_u32(size_t size, void* dst, uint32_t src)
 {
-    if (size == 1)
+    // Shifting by the integer's width or more will clear it
+    if (cc__bigint_is_native(size) && src >= size * 8)
+        cc__bigint_write(size, dst, 0);
+    else if (size == 1)
         *(uint8_t*)dst >>= src;
     else if (size == 2)
         *(uint16_t*)dst >>= src;
@@ -592,6 +683,12 @@ int cc_bigint_sign(size_t size, const void* lhs) {
 
 int cc_bigint_cmp(size_t size, const void* lhs, const void* rhs)
 {
+    if (cc__bigint_is_native(size))
+    {
+        int64_t lhs_value = cc__bigint_read_sext(size, lhs);
+        int64_t rhs_value = cc__bigint_read_sext(size, rhs);
+        return (lhs_value > rhs_value) - (lhs_value < rhs_value);
+    }
     int diff = cc_bigint_sign(size, rhs) - cc_bigint_sign(size, lhs);
     if (diff)
         return diff;
@@ -600,6 +697,12 @@ int cc_bigint_cmp(size_t size, const void* lhs, const void* rhs)
 
 int cc_bigint_ucmp(size_t size, const void* lhs, const void* rhs)
 {
+    if (cc__bigint_is_native(size))
+    {
+        uint64_t lhs_value = cc__bigint_read_zext(size, lhs);
+        uint64_t rhs_value = cc__bigint_read_zext(size, rhs);
+        return (lhs_value > rhs_value) - (lhs_value < rhs_value);
+    }
     // Compare most-significant bytes first
     for (size_t i = 0; i < size; ++i)
     {
@@ -614,6 +717,12 @@ int cc_bigint_ucmp(size_t size, const void* lhs, const void* rhs)
 
 void cc_bigint_extend_sign(size_t dst_size, void* dst, size_t src_size, const void* src)
 {
+    if (cc__bigint_is_native(dst_size) && cc__bigint_is_native(src_size))
+    {
+        cc__bigint_write(dst_size, dst, (uint64_t)cc__bigint_read_sext(src_size, src));
+        return;
+    }
+
     if (dst_size <= src_size)
     {
         // Copy range: [0, dst_size)
@@ -639,6 +748,12 @@ void cc_bigint_extend_sign(size_t dst_size, void* dst, size_t src_size, const vo
 
 void cc_bigint_extend_zero(size_t dst_size, void* dst, size_t src_size, const void* src)
 {
+    if (cc__bigint_is_native(dst_size) && cc__bigint_is_native(src_size))
+    {
+        cc__bigint_write(dst_size, dst, cc__bigint_read_zext(src_size, src));
+        return;
+    }
+
     if (dst_size <= src_size)
     {
         // Copy range: [0, dst_size)
@@ -0,0 +1,326 @@
+#include <cc/cache.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <process.h>
+    #include <sys/utime.h>
+    #define CC__CACHE_SUPPORTED 1
+#elif defined(__unix__) || defined(__APPLE__)
+    #include <dirent.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #include <utime.h>
+    #define CC__CACHE_SUPPORTED 1
+#else
+    #define CC__CACHE_SUPPORTED 0
+#endif
+
+/// @brief Number of hex digits in an entry's name
+#define CC__CACHE_KEY_DIGITS 16
+
+/// @brief An entry found when evicting
+typedef struct cc__cache_entry
+{
+    char* path;
+    uint64_t size;
+    time_t last_used;
+} cc__cache_entry;
+
+/// @brief Check if a file name is an entry: the key's hex digits, then an extension
+static bool cc__cache_is_entry(const char* name)
+{
+    for (size_t i = 0; i < CC__CACHE_KEY_DIGITS; ++i)
+    {
+        if (!isxdigit((unsigned char)name[i]))
+            return false;
+    }
+    // Temporary files have a second extension
+    const char* ext = name + CC__CACHE_KEY_DIGITS;
+    return ext[0] == '.' && !strchr(ext + 1, '.');
+}
+static char* cc__cache_join(const char* dir, const char* name)
+{
+    size_t dir_len = strlen(dir), name_len = strlen(name);
+    char* path = (char*)malloc(dir_len + name_len + 2);
+    memcpy(path, dir, dir_len);
+    path[dir_len] = '/';
+    memcpy(path + dir_len + 1, name, name_len + 1);
+    return path;
+}
+/// @brief Find every entry in the directory
+static cc__cache_entry* cc__cache_list(const cc_cache* cache, size_t* out_num_entries)
+{
+    cc__cache_entry* entries = NULL;
+    size_t num_entries = 0;
+#ifdef _WIN32
+    char* pattern = cc__cache_join(cache->dir, "*");
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA(pattern, &data);
+    free(pattern);
+    if (find != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || !cc__cache_is_entry(data.cFileName))
+                continue;
+            ++num_entries;
+            cc__cache_entry* entry = (cc__cache_entry*)cc_vec_resize(entries, num_entries);
+            entry->path = cc__cache_join(cache->dir, data.cFileName);
+            entry->size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+            // FILETIME counts 100ns intervals, which only need to be ordered
+            entry->last_used = (time_t)((((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32)
+                | data.ftLastWriteTime.dwLowDateTime) / 10000000);
+        } while (FindNextFileA(find, &data));
+        FindClose(find);
+    }
+#elif CC__CACHE_SUPPORTED
+    DIR* dir = opendir(cache->dir);
+    if (dir)
+    {
+        struct dirent* dirent;
+        while ((dirent = readdir(dir)) != NULL)
+        {
+            if (!cc__cache_is_entry(dirent->d_name))
+                continue;
+            char* path = cc__cache_join(cache->dir, dirent->d_name);
+            struct stat file_stat;
+            if (stat(path, &file_stat) || !S_ISREG(file_stat.st_mode))
+            {
+                free(path);
+                continue;
+            }
+            ++num_entries;
+            cc__cache_entry* entry = (cc__cache_entry*)cc_vec_resize(entries, num_entries);
+            entry->path = path;
+            entry->size = (uint64_t)file_stat.st_size;
+            entry->last_used = file_stat.st_mtime;
+        }
+        closedir(dir);
+    }
+#endif
+    *out_num_entries = num_entries;
+    return entries;
+}
+static int cc__cache_entry_compare(const void* lhs, const void* rhs)
+{
+    const cc__cache_entry* a = (const cc__cache_entry*)lhs;
+    const cc__cache_entry* b = (const cc__cache_entry*)rhs;
+    if (a->last_used != b->last_used)
+        return a->last_used < b->last_used ? -1 : 1;
+    return strcmp(a->path, b->path);
+}
+/// @brief Mark an entry as recently used
+static void cc__cache_touch(const char* path)
+{
+#ifdef _WIN32
+    _utime(path, NULL);
+#elif CC__CACHE_SUPPORTED
+    utime(path, NULL);
+#else
+    (void)path;
+#endif
+}
+/// @brief Get the size of a file, in bytes
+/// @return `false` if the file is missing
+static bool cc__cache_file_size(const char* path, uint64_t* out_size)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &data))
+        return false;
+    *out_size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    return true;
+#elif CC__CACHE_SUPPORTED
+    struct stat file_stat;
+    if (stat(path, &file_stat))
+        return false;
+    *out_size = (uint64_t)file_stat.st_size;
+    return true;
+#else
+    (void)path;
+    (void)out_size;
+    return false;
+#endif
+}
+/// @brief Replace `path` with `temp_path`, atomically
+static bool cc__cache_rename(const char* temp_path, const char* path)
+{
+#ifdef _WIN32
+    return MoveFileExA(temp_path, path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(temp_path, path) == 0;
+#endif
+}
+
+bool cc_cache_create(cc_cache* cache, const char* dir, uint64_t max_size)
+{
+    memset(cache, 0, sizeof(*cache));
+#if CC__CACHE_SUPPORTED
+  #ifdef _WIN32
+    if (!CreateDirectoryA(dir, NULL) && GetLastError() != ERROR_ALREADY_EXISTS)
+        return false;
+  #else
+    struct stat dir_stat;
+    if (mkdir(dir, 0777) && (stat(dir, &dir_stat) || !S_ISDIR(dir_stat.st_mode)))
+        return false;
+  #endif
+    cache->dir = cc_strclone_char(dir, (size_t)-1, NULL);
+    if (!cache->dir)
+        return false;
+    cache->max_size = max_size;
+    cc_cache_evict(cache, NULL);
+    return true;
+#else
+    (void)dir;
+    (void)max_size;
+    return false;
+#endif
+}
+
+void cc_cache_destroy(cc_cache* cache)
+{
+    free(cache->dir);
+    memset(cache, 0, sizeof(*cache));
+}
+
+uint64_t cc_cache_key(const void* source, size_t source_size, const void* options, size_t options_size)
+{
+    // The source size separates the source from the options
+    uint64_t size = source_size;
+    uint64_t hash = cc_fnv1a_64(&size, sizeof(size));
+    hash = cc_fnv1a_64_append(hash, source, source_size);
+    return options ? cc_fnv1a_64_append(hash, options, options_size) : hash;
+}
+
+char* cc_cache_path(const cc_cache* cache, uint64_t key, const char* ext)
+{
+    char name[CC__CACHE_KEY_DIGITS + 32];
+    snprintf(name, sizeof(name), "%.16llx%s", (unsigned long long)key, ext);
+    return cc__cache_join(cache->dir, name);
+}
+
+bool cc_cache_load(cc_cache* cache, uint64_t key, const char* ext, cc_stream* stream)
+{
+    char* path = cc_cache_path(cache, key, ext);
+    FILE* file = fopen(path, "rb");
+    bool result = file != NULL;
+    if (file)
+    {
+        uint8_t buffer[4096];
+        size_t size;
+        while (result && (size = fread(buffer, 1, sizeof(buffer), file)) != 0)
+            result = cc_stream_write(stream, buffer, size) == size;
+        result = result && !ferror(file);
+        fclose(file);
+        if (result)
+            cc__cache_touch(path);
+    }
+    free(path);
+    return result;
+}
+
+bool cc_cache_store(cc_cache* cache, uint64_t key, const char* ext, const uint8_t* data, size_t size)
+{
+    char* path = cc_cache_path(cache, key, ext);
+    // Unique to this process, so concurrent stores of the same entry never share a temporary file
+    size_t temp_len = strlen(path) + 32;
+    char* temp_path = (char*)malloc(temp_len);
+#ifdef _WIN32
+    snprintf(temp_path, temp_len, "%s.%d.tmp", path, _getpid());
+#elif CC__CACHE_SUPPORTED
+    snprintf(temp_path, temp_len, "%s.%ld.tmp", path, (long)getpid());
+#else
+    snprintf(temp_path, temp_len, "%s.tmp", path);
+#endif
+
+    FILE* file = fopen(temp_path, "wb");
+    bool result = file != NULL;
+    uint64_t replaced_size = 0;
+    if (file)
+    {
+        result = fwrite(data, 1, size, file) == size;
+        result = fclose(file) == 0 && result;
+        // A replaced entry is no longer counted
+        if (result && !cc__cache_file_size(path, &replaced_size))
+            replaced_size = 0;
+        result = result && cc__cache_rename(temp_path, path);
+        if (!result)
+            remove(temp_path);
+    }
+    if (result)
+    {
+        cache->size -= replaced_size < cache->size ? replaced_size : cache->size;
+        cache->size += size;
+        if (cache->size > cache->max_size)
+            cc_cache_evict(cache, path);
+    }
+    free(temp_path);
+    free(path);
+    return result;
+}
+
+void cc_cache_evict(cc_cache* cache, const char* keep_path)
+{
+    size_t num_entries;
+    cc__cache_entry* entries = cc__cache_list(cache, &num_entries);
+    cache->size = 0;
+    for (size_t i = 0; i < num_entries; ++i)
+        cache->size += entries[i].size;
+
+    if (cache->size > cache->max_size)
+    {
+        // Delete the least recently used first
+        qsort(entries, num_entries, sizeof(entries[0]), &cc__cache_entry_compare);
+        for (size_t i = 0; i < num_entries && cache->size > cache->max_size; ++i)
+        {
+            if (keep_path && !strcmp(entries[i].path, keep_path))
+                continue;
+            // An entry which cannot be deleted is counted again at the next eviction
+            remove(entries[i].path);
+            cache->size -= entries[i].size;
+        }
+    }
+    for (size_t i = 0; i < num_entries; ++i)
+        free(entries[i].path);
+    free(entries);
+}
+
+bool cc_cache_load_ir(cc_cache* cache, uint64_t key, cc_ir_object* obj)
+{
+    cc_stream* stream = cc_stream_create_dynamic();
+    bool result = cc_cache_load(cache, key, CC_CACHE_EXT_IR, stream) && cc_ir_object_read(obj, stream);
+    cc_stream_destroy(stream);
+    return result;
+}
+
+bool cc_cache_store_ir(cc_cache* cache, uint64_t key, const cc_ir_object* obj)
+{
+    cc_stream* stream = cc_stream_create_dynamic();
+    cc_dynamicstream* data = (cc_dynamicstream*)stream;
+    bool result = cc_ir_object_write(obj, stream) && cc_cache_store(cache, key, CC_CACHE_EXT_IR, data->buffer, data->size);
+    cc_stream_destroy(stream);
+    return result;
+}
+
+bool cc_cache_load_program(cc_cache* cache, uint64_t key, cc_vmprogram* program)
+{
+    char* path = cc_cache_path(cache, key, CC_CACHE_EXT_IMAGE);
+    // A store renames a new file over the entry, so the mapped file never changes
+    bool result = cc_vmprogram_map(program, path);
+    if (result)
+        cc__cache_touch(path);
+    free(path);
+    return result;
+}
+
+bool cc_cache_store_program(cc_cache* cache, uint64_t key, const cc_vmprogram* program)
+{
+    cc_stream* stream = cc_stream_create_dynamic();
+    cc_dynamicstream* data = (cc_dynamicstream*)stream;
+    bool result = cc_vmprogram_write(program, stream) && cc_cache_store(cache, key, CC_CACHE_EXT_IMAGE, data->buffer, data->size);
+    cc_stream_destroy(stream);
+    return result;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "ir.h"
+#include "vm.h"
+#include "lib.h"
+
+/**
+ * @file
+ * @brief A compile cache, which stores IR objects and program images in a local directory
+ *
+ * Entries are addressed by a 64-bit key, which is a hash of the source and the compiler options ( @ref cc_cache_key ).
+ * Each entry is one file named after its key, with an extension for its kind ( @ref CC_CACHE_EXT_IR or @ref CC_CACHE_EXT_IMAGE ).
+ * So unrelated processes can share a directory.
+ *
+ * Writes are atomic: an entry is written to a temporary file, then renamed over the entry.
+ * A reader only ever sees a missing or a complete entry.
+ *
+ * The directory is bounded by `max_size` bytes. Each load touches the entry's modification time,
+ * and the least recently used entries are deleted when a store goes over the bound.
+ * The size of the directory is counted when the cache is created, then tracked by this process' stores,
+ * so entries stored by other processes are only counted at the next eviction.
+ *
+ * Keys are not checked against the source, so two inputs with the same 64-bit hash would share an entry.
+ */
+
+/// @brief Extension of IR objects written by @ref cc_ir_object_write
+#define CC_CACHE_EXT_IR ".ccir"
+/// @brief Extension of program images written by @ref cc_vmprogram_write
+#define CC_CACHE_EXT_IMAGE ".ccvm"
+
+typedef struct cc_cache
+{
+    /// @brief Path of the directory, without a trailing separator
+    char* dir;
+    /// @brief Bound on the size of every entry, in bytes
+    uint64_t max_size;
+    /// @brief Size of every entry, in bytes, as last counted
+    uint64_t size;
+} cc_cache;
+
+/**
+ * @brief Open a cache directory, creating it if it is missing
+ * @param max_size Bound on the size of every entry, in bytes
+ * @return `false` if the directory could not be created, or caching is unsupported on this platform
+ */
+bool cc_cache_create(cc_cache* cache, const char* dir, uint64_t max_size);
+void cc_cache_destroy(cc_cache* cache);
+/**
+ * @brief Hash source code and compiler options into a key
+ * @param options (optional) Bytes of every option that changes the output
+ */
+uint64_t cc_cache_key(const void* source, size_t source_size, const void* options, size_t options_size);
+/// @brief Get the path of an entry. Must be freed.
+char* cc_cache_path(const cc_cache* cache, uint64_t key, const char* ext);
+
+/// @brief Append an entry to `stream`, and mark it as recently used
+/// @return `false` if the entry is missing
+bool cc_cache_load(cc_cache* cache, uint64_t key, const char* ext, cc_stream* stream);
+/// @brief Atomically store an entry, then evict old entries if the cache is too large
+bool cc_cache_store(cc_cache* cache, uint64_t key, const char* ext, const uint8_t* data, size_t size);
+/// @brief Delete the least recently used entries until the cache is within its bound
+/// @param keep_path (optional) Path of an entry which is never deleted
+void cc_cache_evict(cc_cache* cache, const char* keep_path);
+
+/// @brief Read a cached IR object. It must be destroyed with @ref cc_ir_object_destroy.
+/// @return `false` if the object is missing or invalid
+bool cc_cache_load_ir(cc_cache* cache, uint64_t key, cc_ir_object* obj);
+bool cc_cache_store_ir(cc_cache* cache, uint64_t key, const cc_ir_object* obj);
+/// @brief Map a cached program image with @ref cc_vmprogram_map
+/// @return `false` if the image is missing or invalid
+bool cc_cache_load_program(cc_cache* cache, uint64_t key, cc_vmprogram* program);
+bool cc_cache_store_program(cc_cache* cache, uint64_t key, const cc_vmprogram* program);
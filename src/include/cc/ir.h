@@ -1,6 +1,8 @@
 #pragma once
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include "lib.h"
 
 /**
  * @file
@@ -33,6 +35,14 @@
  * - The size of a pointer depends on the host machine.
  * - Use opcode @ref CC_IR_OPCODE_SIZEP to load the size of a pointer.
  * - Use the size `0` in arithmetic instructions for pointer math.
+ *
+ * Serialization
+ * -------------
+ * @ref cc_ir_object_write saves an object to a @ref cc_stream, and @ref cc_ir_object_read loads it again.
+ * The format starts with "CCIR" and @ref CC_IR_OBJECT_VERSION. Every integer is an unsigned LEB128 varint,
+ * and signed constants are zigzag-encoded first. Symbol, local, and block names are stored once in a string table,
+ * and referenced by index. Index 0 is no name. Only the operands in an instruction's format are stored.
+ * Symbol, local, and block IDs are kept, so code needs no remapping.
  */
 
 #define CC_IR_MAX_OPERANDS 2
@@ -298,6 +308,9 @@ typedef struct cc_ir_func
     cc_ir_block* entry_block;
     /// @brief A reallocating array of locals
     cc_ir_local* locals;
+    /// @brief A reallocating array of every block, indexed by @ref cc_ir_blockid.
+    /// @details Blocks are never removed, so their IDs are dense. Use `entry_block` for the order of execution.
+    cc_ir_block** blocks;
     size_t num_blocks;
     size_t num_locals;
     /// @brief This function's corresponding symbol ID in the parent @ref cc_ir_object
@@ -375,6 +388,16 @@ cc_ir_symbolid cc_ir_object_import(cc_ir_object* obj, bool is_runtime, const cha
 /// @param name_len Name length. Use `(size_t)-1` for strlen.
 cc_ir_func* cc_ir_object_add_func(cc_ir_object* obj, const char* name, size_t name_len);
 
+/// @brief The current version of the format written by @ref cc_ir_object_write
+#define CC_IR_OBJECT_VERSION 1
+/// @brief Write an object in a compact binary format
+/// @return `false` if the stream ended
+bool cc_ir_object_write(const cc_ir_object* obj, cc_stream* stream);
+/// @brief Read an object written by @ref cc_ir_object_write
+/// @param obj An uninitialized object
+/// @return `false` if the data is invalid or the stream ended. Then `obj` is not created.
+bool cc_ir_object_read(cc_ir_object* obj, cc_stream* stream);
+
 /// @brief Create a symbol
 /// @param name Name for the symbol. String is copied.
 /// @param name_len Name length. Use `(size_t)-1` for strlen
@@ -396,7 +419,7 @@ static cc_ir_localid cc_ir_func_getlocalself(const cc_ir_func* func) {
 }
 /// @brief Get information about a function's local
 cc_ir_local* cc_ir_func_getlocal(const cc_ir_func* func, cc_ir_localid localid);
-/// @brief Get a block in the function
+/// @brief Get a block in the function, in O(1) time
 /// @return nullptr if the local is not a block.
 cc_ir_block* cc_ir_func_getblock(const cc_ir_func* func, cc_ir_blockid blockid);
 /**
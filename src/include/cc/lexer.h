@@ -11,6 +11,13 @@
  * 
  * To read one token at a time, you can call @ref cc_lexer_read and no allocations will be made.
  * This is ideal if you wish to count the tokens beforehand or store them elsewhere.
+ *
+ * Streaming
+ * ---------
+ * When the source arrives in chunks, use a @ref cc_streamlexer instead.
+ * Feed it chunks with @ref cc_streamlexer_feed or @ref cc_streamlexer_feed_stream, and read tokens as they become available.
+ * A token at the end of a chunk is held back until the next chunk shows where it ends, or the input is finished.
+ * Only the text of unread tokens is kept, and at most `ring_cap` tokens are lexed ahead, so memory stays flat.
  */
 
 enum cc_tokenid
@@ -110,6 +117,17 @@ int cc_lexer_read(cc_lexer* lex, cc_token* out_tk);
  * @return 1 if all text was read. 0 if invalid text was encountered.
  */
 int cc_lexer_readall(const cc_char* begin, const cc_char* end, cc_token** out_array, size_t* out_len);
+/**
+ * @brief Like @ref cc_lexer_readall, but append the tokens to an arena.
+ * Lexing many strings into one cleared arena reuses one allocation.
+ * @param begin A string with no null characters
+ * @param end (optional) End of the string. Use `nullptr` for a null-terminated string.
+ * @param arena Receives the tokens. It may be reallocated.
+ * @param out_array Receives a pointer to the first token, in the arena. Valid until the arena is reallocated.
+ * @param out_len Receives the array length
+ * @return 1 if all text was read. 0 if invalid text was encountered.
+ */
+int cc_lexer_readall_arena(const cc_char* begin, const cc_char* end, cc_arena** arena, cc_token** out_array, size_t* out_len);
 /** The string length of a token */
 static size_t cc_token_len(const cc_token* tk) { return (size_t)(tk->end - tk->begin) / sizeof(cc_char); }
 /**
@@ -132,4 +150,60 @@ int cc_token_strcmp(const cc_token* tk, const cc_char* string);
  * Compare two tokens by ID and string
  * @return 0 if the tokens are identical. <0 if tk1 has a greater value. >1 if tk2 has a greater value.
  */
-int cc_token_cmp(const cc_token* tk1, const cc_token* tk2);
\ No newline at end of file
+int cc_token_cmp(const cc_token* tk1, const cc_token* tk2);
+
+/// @brief A token in a @ref cc_streamlexer, by its offsets in the lexer's text
+typedef struct cc_streamtoken
+{
+    size_t begin;
+    size_t end;
+    int tokenid;
+} cc_streamtoken;
+
+/// @brief A lexer which is fed its source in chunks
+typedef struct cc_streamlexer
+{
+    /// @brief Text from the first unread token to the end of the last chunk
+    cc_char* text;
+    size_t text_len;
+    size_t text_cap;
+    /// @brief Index in `text` of the first char which was not lexed
+    size_t pos;
+    /// @brief A ring of tokens which were lexed but not read
+    cc_streamtoken* ring;
+    size_t ring_cap;
+    /// @brief Index in `ring` of the next token
+    size_t ring_first;
+    size_t num_ring;
+    /// @brief @ref cc_streamlexer_finish was called, so no more text will be fed
+    bool is_finished;
+    /// @brief Text which is not a token was found. Nothing after it is lexed.
+    bool is_invalid;
+} cc_streamlexer;
+
+/// @param ring_cap The maximum number of tokens to lex ahead, and the limit of @ref cc_streamlexer_peek
+void cc_streamlexer_create(cc_streamlexer* lex, size_t ring_cap);
+void cc_streamlexer_destroy(cc_streamlexer* lex);
+/**
+ * @brief Append a chunk of the source. Tokens which were already read or peeked become invalid.
+ * @param chunk Text with no null characters. It is copied, so it may be reused afterwards.
+ */
+void cc_streamlexer_feed(cc_streamlexer* lex, const cc_char* chunk, size_t len);
+/**
+ * @brief Read a chunk of up to `chunk_len` chars from a stream, and feed it. Finishes the input at the end of the stream.
+ * @return 0 if the stream has ended
+ */
+int cc_streamlexer_feed_stream(cc_streamlexer* lex, cc_stream* stream, size_t chunk_len);
+/// @brief Mark the end of the input, so a token at the end of the last chunk can be read
+void cc_streamlexer_finish(cc_streamlexer* lex);
+/**
+ * @brief Look ahead at a token without reading it. The token is valid until the next chunk is fed.
+ * @param n The number of tokens to skip, which must be less than `ring_cap`
+ * @return 0 if the token is not available yet. See @ref cc_streamlexer_read.
+ */
+int cc_streamlexer_peek(cc_streamlexer* lex, size_t n, cc_token* out_tk);
+/**
+ * @brief Read the next token. The token is valid until the next chunk is fed.
+ * @return 0 if no token is available. Then more input is needed, unless `is_finished` or `is_invalid` is set.
+ */
+int cc_streamlexer_read(cc_streamlexer* lex, cc_token* out_tk);
@@ -53,6 +53,7 @@ wchar_t* cc_strclone_wchar(const wchar_t* str, size_t str_len, size_t* new_len);
 typedef struct cc_arena
 {
     size_t size;
+    /// @brief Bytes of data which fit without reallocating. It grows geometrically.
     size_t capacity;
 } cc_arena;
 
@@ -60,6 +61,8 @@ cc_arena* cc_arena_create(void);
 static void cc_arena_destroy(cc_arena* a) { free(a); }
 static char* cc_arena_dataptr(cc_arena* a) { return (char*)(a + 1); }
 void cc_arena_resize(cc_arena** a, size_t size, int default_value);
+/// @brief Make room for at least `capacity` bytes of data, so growing up to it does not reallocate
+void cc_arena_reserve(cc_arena** a, size_t capacity);
 void* cc_arena_alloc_align(cc_arena** a, size_t size, size_t align);
 void* cc_arena_alloc(cc_arena** a, size_t size);
 
@@ -93,6 +96,10 @@ void cc_heaprecord_pop(cc_heaprecord* record, size_t n);
 uint32_t cc_fnv1a_32(const void* data, size_t size);
 uint32_t cc_fnv1a_u32(uint32_t i);
 static uint32_t cc_fnv1a_i32(int32_t i) { return cc_fnv1a_u32((uint32_t)i); }
+/// @brief Calculate the 64-bit FNV1-a hash
+uint64_t cc_fnv1a_64(const void* data, size_t size);
+/// @brief Continue a 64-bit FNV1-a hash with more data, as if it was appended to the hashed data
+uint64_t cc_fnv1a_64_append(uint64_t hash, const void* data, size_t size);
 
 /**
  * @brief A data stream with the ability to read/write integers.
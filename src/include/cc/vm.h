@@ -2,19 +2,97 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "ir.h"
+#include "lib.h"
 
 /**
  * @file
  * @brief A virtual machine based on the IR
  * 
  * Slight transformation is required to make the IR interpreter-friendly:
- * - Block IDs are replaced with a byte-offset to that block, relative to the next instruction
+ * - Block IDs are replaced with a signed 32-bit byte-offset to that block, relative to the next instruction
  * - Symbol IDs are converted to indexes into a globals array
  * - Locals logic is replaced with frame-pointer logic
+ * - Instructions on 1, 2, 4, or 8-byte integers are replaced with width-specialized opcodes ( @ref cc_vmopcode )
  * 
  * Use @ref cc_vmprogram_create and @ref cc_vmprogram_link to create an interpretable program.
+ *
+ * Relinking
+ * ---------
+ * Each linked object owns one chunk of the program, and a range of its symbol indexes.
+ * @ref cc_vmprogram_relink replaces one object, and @ref cc_vmprogram_unlink removes one.
+ * Resolved imports are kept with the symbol they resolved to, so only the code that references the object is patched.
+ * Relinking reuses the object's symbol indexes if the new object has no more symbols. Otherwise, the old indexes are left unused.
+ * No VM may be running the program while it is relinked, and pointers to the old object's code or data become invalid.
+ *
+ * Program images
+ * --------------
+ * @ref cc_vmprogram_write saves a linked program as an image, which @ref cc_vmprogram_map loads without compiling.
+ * An image holds every chunk's instructions and globals, the symbol table, and every import ( @ref cc_vmimage_header ).
+ * Instructions only reference symbols by index, and the tables store byte offsets into the image,
+ * so the instructions and globals are used in place. Only the symbol and import tables are rebuilt, in linear time.
+ * Native code and tiering IR are not saved, so a loaded program is interpreted.
+ * Images are only portable between hosts with the same byte order, pointer size, and image version.
+ * They are trusted like linked code: only load images written by @ref cc_vmprogram_write.
+ *
+ * Dispatch
+ * --------
+ * @ref cc_vm_run executes instructions in a loop until an exception is raised.
+ * By default, GCC and Clang builds use direct-threaded dispatch (computed goto).
+ * Other compilers use a portable `switch`.
+ * Define `CC_VM_THREADED_DISPATCH` as `0` or `1` when compiling vm.c to choose explicitly.
+ *
+ * Trusted programs
+ * ----------------
+ * Every function is verified when it is linked.
+ * The verifier proves that the operand stack has the same depth on every path into an instruction,
+ * never pops below the stack frame, and is empty at every return.
+ * Interrupts are assumed to leave the stack unchanged.
+ * If every function passes, @ref cc_vm_run_trusted skips the SP checks on most instructions.
+ * The SP is only checked at CALL, RET, and FRAME, where FRAME reserves the function's maximum stack depth.
+ *
+ * Superinstructions
+ * -----------------
+ * After verification, common sequences such as `ADDRL; STORE` are fused into one instruction.
+ * Only the first opcode is replaced. The rest of the sequence stays in place, so jumps into it still work.
+ * A superinstruction counts as one step per instruction it replaced.
+ * If fewer steps are allowed, only its first instruction is executed, so stepping is not affected.
+ * Use @ref cc_vm_run_profiled to find which sequences are worth fusing.
+ *
+ * With @ref CC_VMTARGET_REGISTER, statements on locals are also fused into three-address instructions,
+ * so `LOADL b; LOADL a; ADD; ADDRL c; STORE` is executed as one `ADD c, a, b`.
+ *
+ * Native code
+ * -----------
+ * When @ref cc_vmprogram.jit is set, functions are also compiled to x86-64 code with @ref x86gen_dump.
+ * A compiled function's FRAME instruction is replaced with @ref CC_VMOPCODE_NATIVE,
+ * which runs the whole function in one step and then returns.
+ * Functions that @ref x86gen_dump does not support are interpreted as usual.
+ *
+ * By default, compilation is tiered: a function is only compiled once it is hot.
+ * Every function entry and loop header begins with @ref CC_VMOPCODE_COUNT,
+ * and the function is compiled when its count reaches @ref cc_vmprogram.jit_threshold.
+ * Short programs never pay for compilation. There is no on-stack replacement,
+ * so an activation which is already running stays interpreted, and only later calls run natively.
+ * Counting modifies the program, so a program with a nonzero `jit_threshold` must not run on several threads at once,
+ * unless it is shared first ( @ref cc_vmprogram_share ).
+ * Native code is only available when `CC_VM_NATIVE` is 1, which is the default on x86-64 hosts with mmap or VirtualAlloc.
+ *
+ * Sharing a program
+ * -----------------
+ * @ref cc_vmprogram_share finishes every write the program would make to itself, so its code and symbols are never modified while it runs.
+ * Then any number of threads may each run their own @ref cc_vm on it.
+ * Sharing only covers code. Globals are not isolated yet: every VM addresses the program's own global chunks.
+ * A shared program cannot be linked, relinked, or unlinked. Those functions return `false` instead.
  */
 
+#ifndef CC_VM_NATIVE
+    #if (defined(__x86_64__) || defined(_M_X64)) && (defined(__unix__) || defined(__APPLE__) || defined(_WIN32))
+        #define CC_VM_NATIVE 1
+    #else
+        #define CC_VM_NATIVE 0
+    #endif
+#endif
+
 typedef struct cc_vmprogram cc_vmprogram;
 
 typedef enum cc_vmexception
@@ -32,8 +110,253 @@ typedef enum cc_vmexception
     CC_VMEXCEPTION_INVALID_SYMBOLID,
     /// @brief The next instruction could not be interpreted
     CC_VMEXCEPTION_INVALID_CODE,
+    /// @brief An integer was divided by zero
+    CC_VMEXCEPTION_DIVIDE_BY_ZERO,
 } cc_vmexception;
 
+/**
+ * @brief VM-private opcodes, which follow the IR opcodes.
+ * 
+ * They are only emitted by the VM compiler, which replaces an IR instruction
+ * when its `data_size` is a native integer width. The suffix is the width in bits.
+ * IR opcodes remain in the VM code for all other sizes.
+ */
+enum cc_vmopcode
+{
+    /// @brief Push a 1-byte integer (from @ref CC_IR_OPCODE_ICONST or @ref CC_IR_OPCODE_UCONST)
+    CC_VMOPCODE_CONST_I8 = CC_IR_OPCODE__COUNT,
+    CC_VMOPCODE_CONST_I16,
+    CC_VMOPCODE_CONST_I32,
+    /// @brief Push a sign-extended 8-byte integer
+    CC_VMOPCODE_ICONST_I64,
+    /// @brief Push a zero-extended 8-byte integer
+    CC_VMOPCODE_UCONST_I64,
+
+    /// @brief @ref CC_IR_OPCODE_LOADL, where `u32` is the frame pointer offset
+    CC_VMOPCODE_LOADL_I8,
+    CC_VMOPCODE_LOADL_I16,
+    CC_VMOPCODE_LOADL_I32,
+    CC_VMOPCODE_LOADL_I64,
+    CC_VMOPCODE_LOAD_I8,
+    CC_VMOPCODE_LOAD_I16,
+    CC_VMOPCODE_LOAD_I32,
+    CC_VMOPCODE_LOAD_I64,
+    CC_VMOPCODE_STORE_I8,
+    CC_VMOPCODE_STORE_I16,
+    CC_VMOPCODE_STORE_I32,
+    CC_VMOPCODE_STORE_I64,
+
+    CC_VMOPCODE_ADD_I8,
+    CC_VMOPCODE_ADD_I16,
+    CC_VMOPCODE_ADD_I32,
+    CC_VMOPCODE_ADD_I64,
+    CC_VMOPCODE_SUB_I8,
+    CC_VMOPCODE_SUB_I16,
+    CC_VMOPCODE_SUB_I32,
+    CC_VMOPCODE_SUB_I64,
+
+    /// @brief @ref CC_IR_OPCODE_MUL or @ref CC_IR_OPCODE_UMUL
+    CC_VMOPCODE_MUL_I8,
+    CC_VMOPCODE_MUL_I16,
+    CC_VMOPCODE_MUL_I32,
+    CC_VMOPCODE_MUL_I64,
+    /// @brief Raises @ref CC_VMEXCEPTION_DIVIDE_BY_ZERO when the divisor is zero
+    CC_VMOPCODE_DIV_I8,
+    CC_VMOPCODE_DIV_I16,
+    CC_VMOPCODE_DIV_I32,
+    CC_VMOPCODE_DIV_I64,
+    CC_VMOPCODE_UDIV_I8,
+    CC_VMOPCODE_UDIV_I16,
+    CC_VMOPCODE_UDIV_I32,
+    CC_VMOPCODE_UDIV_I64,
+    CC_VMOPCODE_MOD_I8,
+    CC_VMOPCODE_MOD_I16,
+    CC_VMOPCODE_MOD_I32,
+    CC_VMOPCODE_MOD_I64,
+    CC_VMOPCODE_UMOD_I8,
+    CC_VMOPCODE_UMOD_I16,
+    CC_VMOPCODE_UMOD_I32,
+    CC_VMOPCODE_UMOD_I64,
+
+    CC_VMOPCODE_NEG_I8,
+    CC_VMOPCODE_NEG_I16,
+    CC_VMOPCODE_NEG_I32,
+    CC_VMOPCODE_NEG_I64,
+    CC_VMOPCODE_NOT_I8,
+    CC_VMOPCODE_NOT_I16,
+    CC_VMOPCODE_NOT_I32,
+    CC_VMOPCODE_NOT_I64,
+
+    CC_VMOPCODE_AND_I8,
+    CC_VMOPCODE_AND_I16,
+    CC_VMOPCODE_AND_I32,
+    CC_VMOPCODE_AND_I64,
+    CC_VMOPCODE_OR_I8,
+    CC_VMOPCODE_OR_I16,
+    CC_VMOPCODE_OR_I32,
+    CC_VMOPCODE_OR_I64,
+    CC_VMOPCODE_XOR_I8,
+    CC_VMOPCODE_XOR_I16,
+    CC_VMOPCODE_XOR_I32,
+    CC_VMOPCODE_XOR_I64,
+    /// @brief Shifting by the integer's width or more results in zero
+    CC_VMOPCODE_LSH_I8,
+    CC_VMOPCODE_LSH_I16,
+    CC_VMOPCODE_LSH_I32,
+    CC_VMOPCODE_LSH_I64,
+    CC_VMOPCODE_RSH_I8,
+    CC_VMOPCODE_RSH_I16,
+    CC_VMOPCODE_RSH_I32,
+    CC_VMOPCODE_RSH_I64,
+    /// @brief Extend from a native width, where `extend_data_size` is also a native width
+    CC_VMOPCODE_ZEXT_I8,
+    CC_VMOPCODE_ZEXT_I16,
+    CC_VMOPCODE_ZEXT_I32,
+    CC_VMOPCODE_ZEXT_I64,
+    CC_VMOPCODE_SEXT_I8,
+    CC_VMOPCODE_SEXT_I16,
+    CC_VMOPCODE_SEXT_I32,
+    CC_VMOPCODE_SEXT_I64,
+
+    /// @brief @ref CC_IR_OPCODE_JZ, where `u32` is the signed byte-offset to the block
+    CC_VMOPCODE_JZ_I8,
+    CC_VMOPCODE_JZ_I16,
+    CC_VMOPCODE_JZ_I32,
+    CC_VMOPCODE_JZ_I64,
+    CC_VMOPCODE_JNZ_I8,
+    CC_VMOPCODE_JNZ_I16,
+    CC_VMOPCODE_JNZ_I32,
+    CC_VMOPCODE_JNZ_I64,
+
+    // Superinstructions, which replace the opcode of the first instruction in a sequence.
+    // The rest of the sequence is left in place and skipped, so it provides the other operands.
+
+    /// @brief `ADDRL; LOAD`, where `u32` is the frame pointer offset
+    CC_VMOPCODE_ADDRL_LOAD_I8,
+    CC_VMOPCODE_ADDRL_LOAD_I16,
+    CC_VMOPCODE_ADDRL_LOAD_I32,
+    CC_VMOPCODE_ADDRL_LOAD_I64,
+    /// @brief `ADDRL; STORE`, where `u32` is the frame pointer offset
+    CC_VMOPCODE_ADDRL_STORE_I8,
+    CC_VMOPCODE_ADDRL_STORE_I16,
+    CC_VMOPCODE_ADDRL_STORE_I32,
+    CC_VMOPCODE_ADDRL_STORE_I64,
+    /// @brief `DUPE; ADDRL; STORE`, which stores to a local and keeps the value on the stack
+    CC_VMOPCODE_DUPE_ADDRL_STORE_I8,
+    CC_VMOPCODE_DUPE_ADDRL_STORE_I16,
+    CC_VMOPCODE_DUPE_ADDRL_STORE_I32,
+    CC_VMOPCODE_DUPE_ADDRL_STORE_I64,
+    /// @brief `LOADL; CONST; ADD`, where `u32` is the frame pointer offset
+    CC_VMOPCODE_LOADL_CONST_ADD_I8,
+    CC_VMOPCODE_LOADL_CONST_ADD_I16,
+    CC_VMOPCODE_LOADL_CONST_ADD_I32,
+    CC_VMOPCODE_LOADL_CONST_ADD_I64,
+    /// @brief `CONST; JZ`, where `u32` is the constant
+    CC_VMOPCODE_CONST_JZ_I8,
+    CC_VMOPCODE_CONST_JZ_I16,
+    CC_VMOPCODE_CONST_JZ_I32,
+    CC_VMOPCODE_CONST_JZ_I64,
+    /// @brief `CONST; JNZ`, where `u32` is the constant
+    CC_VMOPCODE_CONST_JNZ_I8,
+    CC_VMOPCODE_CONST_JNZ_I16,
+    CC_VMOPCODE_CONST_JNZ_I32,
+    CC_VMOPCODE_CONST_JNZ_I64,
+
+    // Three-address instructions for @ref CC_VMTARGET_REGISTER, which read and write locals directly.
+    // They are superinstructions too, so operands are in the replaced instructions:
+    // - `_RR`: `c = a OP b` replaces `LOADL b; LOADL a; OP; ADDRL c; STORE`
+    // - `_RK`: `c = a OP k` replaces `CONST k; LOADL a; OP; ADDRL c; STORE`
+
+    CC_VMOPCODE_ADD_RR_I32,
+    CC_VMOPCODE_ADD_RR_I64,
+    CC_VMOPCODE_ADD_RK_I32,
+    CC_VMOPCODE_ADD_RK_I64,
+    CC_VMOPCODE_SUB_RR_I32,
+    CC_VMOPCODE_SUB_RR_I64,
+    CC_VMOPCODE_SUB_RK_I32,
+    CC_VMOPCODE_SUB_RK_I64,
+    CC_VMOPCODE_MUL_RR_I32,
+    CC_VMOPCODE_MUL_RR_I64,
+    CC_VMOPCODE_MUL_RK_I32,
+    CC_VMOPCODE_MUL_RK_I64,
+    CC_VMOPCODE_AND_RR_I32,
+    CC_VMOPCODE_AND_RR_I64,
+    CC_VMOPCODE_AND_RK_I32,
+    CC_VMOPCODE_AND_RK_I64,
+    CC_VMOPCODE_OR_RR_I32,
+    CC_VMOPCODE_OR_RR_I64,
+    CC_VMOPCODE_OR_RK_I32,
+    CC_VMOPCODE_OR_RK_I64,
+    CC_VMOPCODE_XOR_RR_I32,
+    CC_VMOPCODE_XOR_RR_I64,
+    CC_VMOPCODE_XOR_RK_I32,
+    CC_VMOPCODE_XOR_RK_I64,
+    /// @brief `c = a`, which replaces `LOADL a; ADDRL c; STORE`
+    CC_VMOPCODE_MOV_R_I8,
+    CC_VMOPCODE_MOV_R_I16,
+    CC_VMOPCODE_MOV_R_I32,
+    CC_VMOPCODE_MOV_R_I64,
+    /// @brief `c = k`, which replaces `CONST k; ADDRL c; STORE`
+    CC_VMOPCODE_MOV_K_I8,
+    CC_VMOPCODE_MOV_K_I16,
+    CC_VMOPCODE_MOV_K_I32,
+    CC_VMOPCODE_MOV_K_I64,
+    /// @brief Jump if local `a` is zero, which replaces `LOADL a; JZ`
+    CC_VMOPCODE_JZ_R_I32,
+    CC_VMOPCODE_JZ_R_I64,
+    /// @brief Jump if local `a` is not zero, which replaces `LOADL a; JNZ`
+    CC_VMOPCODE_JNZ_R_I32,
+    CC_VMOPCODE_JNZ_R_I64,
+
+    /// @brief Run a function compiled to native code, then return.
+    /// This replaces the function's FRAME instruction, and u32 is an index into @ref cc_vmprogram.natives.
+    CC_VMOPCODE_NATIVE,
+    /// @brief Count an entry to a function or loop, and compile the function to native code when it is hot.
+    /// u32 is an index into @ref cc_vmprogram.symbols and @ref cc_vmprogram.tiers.
+    CC_VMOPCODE_COUNT,
+
+    /// @brief The number of valid IR and VM opcodes
+    CC_VMOPCODE__COUNT,
+};
+
+/// @brief The instructions that IR is compiled to
+typedef enum cc_vmtarget
+{
+    /// @brief Stack machine instructions, with superinstructions for common sequences
+    CC_VMTARGET_STACK,
+    /// @brief Also use three-address instructions which operate on locals directly, like a register machine.
+    /// Anything else, including calls and interrupts, still uses the stack.
+    CC_VMTARGET_REGISTER,
+} cc_vmtarget;
+
+/// @brief The longest opcode sequence recorded by @ref cc_vmprofile
+#define CC_VM_MAX_NGRAM 3
+
+/// @brief A sequence of adjacent opcodes, and the number of times it was executed
+typedef struct cc_vmngram
+{
+    /// @brief Opcodes in execution order. Superinstructions are recorded as their first instruction.
+    uint8_t opcodes[CC_VM_MAX_NGRAM];
+    /// @brief Number of opcodes in the sequence (2 or more)
+    uint8_t length;
+    uint64_t count;
+} cc_vmngram;
+
+/**
+ * @brief Execution counts of opcode sequences, collected by @ref cc_vm_run_profiled.
+ * 
+ * This is meant for choosing superinstructions.
+ * Only sequences without a jump, call, or exception in between are counted.
+ */
+typedef struct cc_vmprofile
+{
+    /// @brief A reallocating array of every sequence that was executed
+    cc_vmngram* ngrams;
+    size_t num_ngrams;
+    /// @brief Maps a packed sequence to its index in `ngrams`
+    cc_hmap32 ngram_indices;
+} cc_vmprofile;
+
 /**
  * @brief The virtual machine state.
  * 
@@ -69,6 +392,12 @@ typedef struct cc_vmsymbol
     size_t name_len;
     /// @brief Pointer to the symbol's corresponding data
     void* ptr;
+    /// @brief @ref cc_fnv1a_32 of the name
+    uint32_t hash;
+    /// @brief Index of the next symbol in the program with the same hash, or `UINT32_MAX`
+    uint32_t next_hashed;
+    /// @brief Every import in the program that was resolved to this symbol, linked by @ref cc_vmimport.next_import
+    struct cc_vmimport* first_import;
 } cc_vmsymbol;
 
 /// @brief Unresolved code references to a symbol
@@ -79,9 +408,56 @@ typedef struct cc_vmimport
     /// @brief Pointers to the source of every referencing @ref cc_ir_symbolid in code
     cc_ir_symbolid** code_refs;
     size_t num_code_refs;
+    /// @brief @ref cc_fnv1a_32 of the name
+    uint32_t hash;
+    /// @brief Index of the symbol this import was resolved to in a program, or `UINT32_MAX`
+    uint32_t symbol_index;
+    /// @brief The next import in an object.
+    /// In a program, this is the next unresolved import with the same hash, or the next import resolved to the same symbol.
     struct cc_vmimport* next_import;
 } cc_vmimport;
 
+/// @brief The signature of a function compiled to native code
+typedef void (*cc_vmnative_func)(void* args_pointer);
+
+/// @brief A function compiled to native code
+typedef struct cc_vmnative
+{
+    /// @brief The entry point, at the start of executable memory
+    cc_vmnative_func entry;
+    /// @brief Size of the executable memory (in bytes)
+    size_t size;
+    /// @brief The FRAME instruction which was replaced with @ref CC_VMOPCODE_NATIVE
+    cc_ir_ins frame;
+} cc_vmnative;
+
+/// @brief The execution counter of a function which may be compiled to native code
+typedef struct cc_vmtier
+{
+    /// @brief A copy of the function's IR, or `nullptr` if it will never be compiled
+    cc_ir_func* func;
+    /// @brief The number of times the function or one of its loops was entered
+    uint32_t count;
+} cc_vmtier;
+
+/**
+ * @brief The layout of a function's locals in its stack frame
+ *
+ * Computed once per function by @ref cc__vmframe_create, so every local is found in O(1) time.
+ * Each local is aligned to its natural size, up to `_Alignof(max_align_t)`, relative to the frame pointer.
+ */
+typedef struct cc_vmframe
+{
+    /// @brief Byte offset from the frame pointer to each local, indexed by @ref cc_ir_localid.
+    /// @details `UINT32_MAX` if the local is not in the frame (such as blocks)
+    uint32_t* offsets;
+    /// @brief Size of each local (in bytes), indexed by @ref cc_ir_localid
+    uint32_t* sizes;
+    size_t num_locals;
+    /// @brief Total size of the frame, rounded up to the alignment of its most-aligned local
+    uint32_t size;
+} cc_vmframe;
+
 /// @brief A single IR object compiled for the VM
 typedef struct cc_vmobject
 {
@@ -97,8 +473,30 @@ typedef struct cc_vmobject
     /// @brief All code references to the symbols array are offset by this value
     size_t first_symbol_index;
     cc_vmimport* first_import;
+    /// @brief Every function passed @ref cc__vm_verify_func
+    bool is_verified;
+    /// @brief The instructions to compile to. This is @ref CC_VMTARGET_STACK by default.
+    cc_vmtarget target;
+    /// @brief Begin every function and loop with @ref CC_VMOPCODE_COUNT. This is false by default.
+    bool is_counted;
 } cc_vmobject;
 
+/// @brief The parts of a program which belong to one linked object
+typedef struct cc_vmchunk
+{
+    /// @brief The object's first symbol index in the program
+    size_t first_symbol_index;
+    /// @brief The number of symbols in the object
+    size_t num_symbols;
+    /// @brief The number of symbol indexes reserved for the object, starting at `first_symbol_index`
+    size_t max_symbols;
+    /// @brief Every import of the object, resolved or not
+    cc_vmimport** imports;
+    size_t num_imports;
+    /// @brief The object's functions passed @ref cc__vm_verify_func
+    bool is_verified;
+} cc_vmchunk;
+
 /**
  * @brief A program with specially-compiled IR for the VM.
  * 
@@ -113,20 +511,178 @@ typedef struct cc_vmprogram
     cc_ir_ins** ins_chunks;
     /// @brief The number of instructions in a chunk by index.
     size_t* ins_chunk_lengths;
+    /// @brief The symbols and imports of a chunk by index
+    cc_vmchunk* chunks;
     size_t num_ins_chunks;
     /// @brief Array of chunk pointers. Each chunk contains all globals for a linked object
     uint8_t** global_chunks;
+    /// @brief The size of globals in a chunk by index (in bytes)
+    size_t* global_chunk_sizes;
     size_t num_global_chunks;
     /// @brief A lookup table for the globals. Array index corresponds with `symbolid`.
     cc_vmsymbol* symbols;
     size_t num_symbols;
-    cc_vmimport* first_import;
+    /// @brief Map name hash -> index of the first symbol with that hash.
+    /// Symbols with the same hash are chained by @ref cc_vmsymbol.next_hashed.
+    cc_hmap32 symbol_map;
+    /// @brief Unresolved imports, grouped by name hash.
+    /// Each item is the first of a list linked by @ref cc_vmimport.next_import, or `nullptr` if every import was resolved.
+    cc_vmimport** imports;
+    size_t num_imports;
+    /// @brief Map name hash -> index into @ref imports
+    cc_hmap32 import_map;
+    /// @brief Every linked object was verified. The program may run with @ref cc_vm_run_trusted.
+    bool is_verified;
+    /// @brief The instructions that objects are compiled to when linked.
+    /// This is @ref CC_VMTARGET_STACK by default, and may be changed before linking.
+    cc_vmtarget target;
+    /// @brief Also compile functions to native code, if `CC_VM_NATIVE` is 1.
+    /// This is false by default, and may be changed before linking.
+    bool jit;
+    /// @brief The number of function or loop entries before a function is compiled to native code.
+    /// 0 compiles every function when it is linked. This is 1000 by default, and may be changed before linking.
+    uint32_t jit_threshold;
+    /// @brief Every function compiled to native code
+    cc_vmnative* natives;
+    size_t num_natives;
+    /// @brief Indexes of entries in `natives` whose code was freed by relinking or unlinking, which are reused first
+    uint32_t* free_natives;
+    size_t num_free_natives;
+    /// @brief The execution counter of every symbol. Array index corresponds with `symbolid`.
+    cc_vmtier* tiers;
+    /// @brief The image that chunks may point into, or `nullptr`. Chunks in the image are not freed.
+    uint8_t* image;
+    size_t image_size;
+    /// @brief The image was mapped by @ref cc_vmprogram_map, and is unmapped with the program
+    bool is_image_mapped;
+    /// @brief @ref cc_vmprogram_share was called. The program is not modified by running it, and cannot be linked.
+    bool is_shared;
 } cc_vmprogram;
 
+/// @brief The current version of @ref cc_vmimage_header
+#define CC_VMIMAGE_VERSION 1
+
+/**
+ * @brief The start of a program image
+ *
+ * Every offset is in bytes from the start of the image, and every table is 8-byte aligned.
+ * Integers use the byte order of the host which wrote the image.
+ */
+typedef struct cc_vmimage_header
+{
+    /// @brief "CCVM"
+    char magic[4];
+    /// @brief @ref CC_VMIMAGE_VERSION
+    uint32_t version;
+    /// @brief `0x01020304`, to detect the byte order
+    uint32_t byte_order;
+    /// @brief `sizeof(void*)`
+    uint16_t ptr_size;
+    /// @brief `sizeof(cc_ir_ins)`
+    uint16_t ins_size;
+    /// @brief Size of the whole image
+    uint64_t size;
+    /// @brief Offset of a @ref cc_vmimage_chunk array
+    uint64_t chunks_offset;
+    /// @brief Offset of a @ref cc_vmimage_symbol array
+    uint64_t symbols_offset;
+    /// @brief Offset of a @ref cc_vmimage_import array
+    uint64_t imports_offset;
+    uint32_t num_chunks;
+    uint32_t num_symbols;
+    uint32_t num_imports;
+    /// @brief A value from @ref cc_vmtarget
+    uint8_t target;
+    /// @brief Every chunk passed @ref cc__vm_verify_func when the image was written. Ignored when loading.
+    uint8_t is_verified;
+    uint8_t reserved[2];
+} cc_vmimage_header;
+
+/// @brief A chunk in a program image
+typedef struct cc_vmimage_chunk
+{
+    /// @brief Offset of the chunk's @ref cc_ir_ins array
+    uint64_t ins_offset;
+    uint64_t num_ins;
+    /// @brief Offset of the chunk's globals
+    uint64_t global_offset;
+    uint64_t global_size;
+    uint64_t first_symbol_index;
+    uint64_t num_symbols;
+    uint64_t max_symbols;
+    /// @brief Index of the chunk's first @ref cc_vmimage_import. The chunk's imports are consecutive.
+    uint64_t first_import;
+    uint64_t num_imports;
+    /// @brief The chunk passed @ref cc__vm_verify_func when the image was written. Ignored when loading.
+    uint64_t is_verified;
+} cc_vmimage_chunk;
+
+/// @brief A symbol in a program image
+typedef struct cc_vmimage_symbol
+{
+    /// @brief Offset of the name, which is not null-terminated
+    uint64_t name_offset;
+    uint64_t name_len;
+    /// @brief Offset of the symbol's code, or `UINT64_MAX` for an unused symbol index
+    uint64_t code_offset;
+    /// @brief @ref cc_vmsymbol.hash
+    uint32_t hash;
+    /// @brief @ref cc_vmsymbol.next_hashed
+    uint32_t next_hashed;
+    /// @brief The symbol is the first in its hash chain
+    uint32_t is_first_hashed;
+    uint32_t reserved;
+} cc_vmimage_symbol;
+
+/// @brief An import in a program image
+typedef struct cc_vmimage_import
+{
+    /// @brief Offset of the name, which is not null-terminated
+    uint64_t name_offset;
+    uint64_t name_len;
+    /// @brief Offset of a `uint64_t` array, which holds the offset of every referencing @ref cc_ir_symbolid
+    uint64_t code_refs_offset;
+    uint64_t num_code_refs;
+    /// @brief @ref cc_vmimport.hash
+    uint32_t hash;
+    /// @brief @ref cc_vmimport.symbol_index
+    uint32_t symbol_index;
+} cc_vmimage_import;
+
 void cc_vm_create(cc_vm* vm, size_t stack_size, const cc_vmprogram* program);
 void cc_vm_destroy(cc_vm* vm);
 /// @brief Execute at the IP and increment the IP
+/// @details Equivalent to `cc_vm_run(vm, 1)`
 void cc_vm_step(cc_vm* vm);
+/**
+ * @brief Execute instructions until an exception is raised or `max_steps` instructions have executed.
+ * 
+ * Interrupts stop execution with @ref CC_VMEXCEPTION_INTERRUPT, like any other exception.
+ * Nothing is executed until a previous exception is cleared.
+ * @param max_steps Maximum number of instructions to execute. Use `(size_t)-1` for no limit.
+ * @return The number of instructions executed
+ */
+size_t cc_vm_run(cc_vm* vm, size_t max_steps);
+/**
+ * @brief Like @ref cc_vm_run, but without checking the SP on every instruction.
+ * 
+ * Falls back to @ref cc_vm_run if the program is not verified.
+ * Interrupt handlers must leave the stack as they found it.
+ * @param max_steps Maximum number of instructions to execute. Use `(size_t)-1` for no limit.
+ * @return The number of instructions executed
+ */
+size_t cc_vm_run_trusted(cc_vm* vm, size_t max_steps);
+/**
+ * @brief Like @ref cc_vm_run, but count every executed sequence of opcodes in `profile`.
+ * 
+ * Instructions are executed one step at a time, so this is much slower than @ref cc_vm_run.
+ * @param max_steps Maximum number of instructions to execute. Use `(size_t)-1` for no limit.
+ * @return The number of instructions executed
+ */
+size_t cc_vm_run_profiled(cc_vm* vm, size_t max_steps, cc_vmprofile* profile);
+/// @brief Get the format of an IR or VM-private opcode
+/// @return `nullptr` if the opcode is invalid
+const cc_ir_ins_format* cc_vm_ins_format(uint8_t opcode);
 /// @brief Get the next instruction to be executed
 /// @return `nullptr` if the IP is invalid 
 const cc_ir_ins* cc_vm_next_ins(const cc_vm* vm);
@@ -139,14 +695,15 @@ uint8_t* cc__vm_pop(cc_vm* vm, uint32_t num_bytes);
 /// @brief Push `num_bytes` to stack
 /// @return Pointer to the pushed bytes, or `nullptr` if vmexception was written
 uint8_t* cc__vm_push(cc_vm* vm, uint32_t num_bytes);
-/// @brief The byte offset to a local in the locals stack
-/// @return `(size_t)-1` if the localid is invalid or not in locals stack (such as blocks)
-size_t cc__vm_local_stack_offset(const cc_ir_func* func, cc_ir_localid localid);
-/// @brief The total size of the locals stack for a function
-size_t cc__vm_local_stack_size(const cc_ir_func* func);
 /// @brief The size of a local, in bytes
 /// @return 0 if the local is not a type with a size (such as blocks)
 size_t cc__vm_local_size(const cc_ir_local* local);
+/// @brief The alignment of a local, in bytes. This is the largest power of two that divides its size, up to `_Alignof(max_align_t)`.
+/// @return 0 if the local is not a type with a size (such as blocks)
+size_t cc__vm_local_align(const cc_ir_local* local);
+/// @brief Lay out every local of `func` in its stack frame
+void cc__vmframe_create(cc_vmframe* frame, const cc_ir_func* func);
+void cc__vmframe_destroy(cc_vmframe* frame);
 /// @brief Set IP to the function and assign registers before executing a function.
 /// @details Nothing is stored or restored. That is the job of call/return.
 /// @return `false` if vmexception was written
@@ -159,14 +716,102 @@ bool cc__vm_leave_func(cc_vm* vm, const cc_ir_func* func);
 void cc_vmprogram_create(cc_vmprogram* program);
 void cc_vmprogram_destroy(cc_vmprogram* program);
 cc_vmsymbol* cc_vmprogram_get_symbol(const cc_vmprogram* program, const char* name, size_t name_len);
+/// @brief Compile and link an object into the program
+/// @details The object's chunk index is `program->num_ins_chunks - 1` afterwards, which identifies it to @ref cc_vmprogram_relink.
+/// @return `false` if `obj` failed to compile, or the program is shared
 bool cc_vmprogram_link(cc_vmprogram* program, const cc_ir_object* obj);
-bool cc__vmprogram_resolve(cc_vmprogram* program, const cc_vmimport* import);
+/**
+ * @brief Compile objects on several threads, then link them in order
+ *
+ * Objects are compiled independently, then merged and their imports resolved in one serial pass.
+ * The program is the same as linking each object in order with @ref cc_vmprogram_link.
+ * @param num_threads Number of threads to compile with, including the calling thread. `0` or `1` compiles on the calling thread.
+ * @return `false` if any object failed to compile, or the program is shared. Then no object is linked.
+ */
+bool cc_vmprogram_link_many(cc_vmprogram* program, const cc_ir_object* const* objs, size_t num_objs, size_t num_threads);
+/**
+ * @brief Replace a linked object with `obj`
+ *
+ * Takes time proportional to the size of both objects, and the number of imports which reference them.
+ * @param chunk The chunk index of the object. It may have been unlinked.
+ * @return `false` if `obj` failed to compile, or the program is shared. Then the old object stays linked.
+ */
+bool cc_vmprogram_relink(cc_vmprogram* program, size_t chunk, const cc_ir_object* obj);
+/// @brief Remove a linked object. Code which imports its symbols is linked to another symbol with the same name, or unresolved.
+/// @param chunk The chunk index of the object
+/// @return `false` if the program is shared. Then the object stays linked.
+bool cc_vmprogram_unlink(cc_vmprogram* program, size_t chunk);
+/**
+ * @brief Prepare a program to run on several threads at once, each with its own VM
+ *
+ * Functions which are waiting to be compiled to native code are compiled now, instead of when they are hot.
+ * Afterwards, running the program never modifies it.
+ */
+void cc_vmprogram_share(cc_vmprogram* program);
+/// @brief Write a linked program as an image, which can be loaded with @ref cc_vmprogram_map or @ref cc_vmprogram_load
+/// @return `false` if the stream ended
+bool cc_vmprogram_write(const cc_vmprogram* program, cc_stream* stream);
+/**
+ * @brief Create a program from an image, and use its instructions and globals in place
+ * The image's tables are checked, but not its code, so the program is never verified and @ref cc_vm_run_trusted runs it with checks.
+ * @param image A writable image, aligned to 8 bytes. It must outlive the program, which may modify it.
+ * @return `false` if the image is invalid or was written by an incompatible host. Then the program is not created.
+ */
+bool cc_vmprogram_load(cc_vmprogram* program, uint8_t* image, size_t size);
+/**
+ * @brief Create a program from an image file, which is mapped copy-on-write
+ * @return `false` if the file cannot be mapped, or the image is invalid. Then the program is not created.
+ */
+bool cc_vmprogram_map(cc_vmprogram* program, const char* path);
+/// @brief Unmap the image mapped by @ref cc_vmprogram_map
+void cc__vmprogram_unmap(cc_vmprogram* program);
+/// @brief Find the first symbol named `name`, in O(1) time
+/// @return The index of the symbol, or `UINT32_MAX` if there is none
+uint32_t cc__vmprogram_find_symbol(const cc_vmprogram* program, const char* name, size_t name_len, uint32_t hash);
+/// @brief Change all code references of an import to the symbol with its name, if one exists,
+/// and add the import to that symbol's @ref cc_vmsymbol.first_import
+/// @return `false` if no symbol exists
+bool cc__vmprogram_resolve(cc_vmprogram* program, cc_vmimport* import);
+/// @brief Change all code references of an import to an invalid symbol, and add it to the program's unresolved imports
+void cc__vmprogram_unresolve(cc_vmprogram* program, cc_vmimport* import);
+/**
+ * @brief Compile a function to native code, and replace its FRAME instruction with @ref CC_VMOPCODE_NATIVE
+ * @param entry The function's first instruction in the program
+ * @return False if the function or host is not supported. Then the function is unchanged.
+ */
+bool cc__vmprogram_compile_native(cc_vmprogram* program, const cc_ir_func* func, cc_ir_ins* entry);
+/// @brief Compile a hot function to native code, which is only tried once
+/// @details Called by @ref CC_VMOPCODE_COUNT when a function reaches @ref cc_vmprogram.jit_threshold
+void cc__vmprogram_tier_up(cc_vmprogram* program, size_t symbol_index);
+void cc_vmprofile_create(cc_vmprofile* profile);
+void cc_vmprofile_destroy(cc_vmprofile* profile);
+/// @brief Sort the sequences from most to least executed
+void cc_vmprofile_sort(cc_vmprofile* profile);
 void cc_vmobject_create(cc_vmobject* vmobj);
 void cc_vmobject_destroy(cc_vmobject* vmobj);
 bool cc_vmobject_compile(cc_vmobject* vmobject, const cc_ir_object* irobject, size_t first_symbol_index);
 /// @brief Flatten `func` into one array of instructions and append to `vmobject`
 /// @details Every blockid is replaced with a byte offset to that block (relative to the next instruction)
 bool cc__vmobject_flatten(cc_vmobject* vmobject, const cc_ir_func* func);
+/**
+ * @brief Verify the operand stack of one flattened function
+ * 
+ * On success, the function's maximum operand stack depth (in bytes) is written to
+ * the `data_size` of its first instruction, which is FRAME.
+ * @return `false` if the stack is not provably balanced and in-bounds
+ */
+bool cc__vm_verify_func(cc_ir_ins* ins, size_t num_ins);
+/// @brief Replace a flattened instruction's opcode with a width-specialized @ref cc_vmopcode, if one exists
+void cc__vm_specialize(cc_ir_ins* ins);
+/**
+ * @brief Replace common sequences in one flattened function with superinstructions
+ * 
+ * This must run after @ref cc__vm_verify_func, which does not understand superinstructions.
+ */
+void cc__vm_fuse(cc_ir_ins* ins, size_t num_ins, cc_vmtarget target);
+/// @brief Get the opcode that a superinstruction replaced, and its number of instructions
+/// @param length (optional) Stores the number of instructions. This is 1 if `opcode` is not a superinstruction.
+uint8_t cc__vm_unfuse(uint8_t opcode, size_t* length);
 void cc_vmsymbol_create(cc_vmsymbol* vmsymbol, const char* name, size_t name_len);
 void cc_vmsymbol_destroy(cc_vmsymbol* vmsymbol);
 void cc_vmsymbol_move(cc_vmsymbol* dst, cc_vmsymbol* src);
@@ -296,9 +296,35 @@ void x86func_idiv(x86func* func, uint8_t opsize, x86operand src);
 /// @brief Emit: `div src`
 /// @param src Register or memory
 void x86func_div(x86func* func, uint8_t opsize, x86operand src);
+/// @brief Emit: `and dst, src`
+void x86func_and(x86func* func, uint8_t opsize, x86operand dst, x86operand src);
+/// @brief Emit: `or dst, src`
+void x86func_or(x86func* func, uint8_t opsize, x86operand dst, x86operand src);
+/// @brief Emit: `xor dst, src`
+void x86func_xor(x86func* func, uint8_t opsize, x86operand dst, x86operand src);
+/// @brief Emit: `neg dst`
+/// @param dst Register or memory
+void x86func_neg(x86func* func, uint8_t opsize, x86operand dst);
+/// @brief Emit: `not dst`
+/// @param dst Register or memory
+void x86func_not(x86func* func, uint8_t opsize, x86operand dst);
+/// @brief Emit: `shl dst, count`
+/// @param count A constant, or the register @ref X86_REG_C to shift by `cl`
+void x86func_shl(x86func* func, uint8_t opsize, x86operand dst, x86operand count);
+/// @brief Emit: `shr dst, count`
+/// @param count A constant, or the register @ref X86_REG_C to shift by `cl`
+void x86func_shr(x86func* func, uint8_t opsize, x86operand dst, x86operand count);
+/// @brief Emit: `sar dst, count`
+/// @param count A constant, or the register @ref X86_REG_C to shift by `cl`
+void x86func_sar(x86func* func, uint8_t opsize, x86operand dst, x86operand count);
 /// @brief Emit: `mov dst, src`
 /// @param opsize A value from @ref x86_opsize
 void x86func_mov(x86func* func, uint8_t opsize, x86operand dst, x86operand src);
+/// @brief Emit: `lea dst, src`
+/// @param opsize All values except @ref X86_OPSIZE_BYTE are supported
+/// @param dst A value from @ref x86_reg_enum
+/// @param src A memory operand
+void x86func_lea(x86func* func, uint8_t opsize, uint8_t dst, x86operand src);
 /// @brief Emit: `cmp lhs, rhs`, where `lhs` is always a non-const operand
 void x86func_cmp(x86func* func, uint8_t opsize, x86operand lhs, x86operand rhs);
 void x86func_jmp(x86func* func, x86label label);
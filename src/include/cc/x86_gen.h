@@ -10,6 +10,29 @@
  * Default calling conventions are provided:
  * - @ref X86_CONV_WIN64_FASTCALL
  * - @ref X86_CONV_SYSV64_CDECL
+ * 
+ * Template code
+ * -----------------
+ * @ref x86gen_dump translates each IR instruction to a fixed sequence of 64-bit code.
+ * Each value on the operand stack has one 8-byte location, which is a register or a slot in the frame.
+ * A location's upper bytes may be garbage, so only instructions that depend on them (such as jumps and extensions) use the value's size.
+ * 
+ * The compiled function has the signature `void func(void* args_pointer)`, where @ref CC_IR_OPCODE_ARGP pushes `args_pointer`.
+ * Only leaf functions with values of 1, 2, 4, or 8 bytes are supported, and the operand stack must be empty between blocks.
+ * Calls, interrupts, globals, division, and shifts are not supported yet.
+ * 
+ * Register allocation
+ * -----------------
+ * The bottom of the operand stack always lives in registers. Deeper values are spilled to the frame.
+ * 
+ * Integer and pointer locals live in registers too, unless their address is taken.
+ * `ADDRL x; STORE` is a store to `x`, and does not take its address.
+ * Each local has a live interval, from its first to its last use in block order.
+ * An interval that overlaps a loop, from a block to a jump back to it, is extended to cover the whole loop.
+ * The intervals are assigned registers by linear scan. Under pressure, the interval which ends last is spilled to the frame.
+ * 
+ * Registers are taken from @ref x86conv.volatiles first. Other registers are saved in the prologue and restored in the epilogue.
+ * A and C are reserved for templates, and B holds the args pointer.
  */
 
 /// @brief A calling convention. This also defines the ABI.
@@ -27,6 +50,10 @@ typedef struct x86conv
     uint32_t stack_postargs;
     /// @brief If true, the function will not return
     bool noreturn;
+    /// @brief Registers for the first integer arguments, in order. Each is a value from @ref x86_reg_enum.
+    uint8_t int_args[6];
+    /// @brief The number of items in @ref int_args
+    uint8_t num_int_args;
 } x86conv;
 
 typedef struct x86gen
@@ -41,11 +68,24 @@ typedef struct x86gen
      * This function has been transformed to meet special requirements for x86.
      * @see x86gen_simplify
      */
-    cc_ir_func irfunc;
+    cc_ir_func* irfunc;
     /// @brief The current output for x86 code
     x86func* func;
-    /// @brief Map (a block's) localid -> x86label
+    /// @brief Map blockid -> x86label
     cc_hmap32 map_blocks;
+    /// @brief Map localid -> offset from the frame pointer (as an `int32_t`), for locals in memory
+    cc_hmap32 map_locals;
+    /// @brief Map localid -> register from @ref x86_reg_enum, for locals in registers
+    cc_hmap32 map_registers;
+    /// @brief Registers for the bottom of the operand stack, in order. Each is a value from @ref x86_reg_enum.
+    uint8_t value_registers[X86_NUM_REGISTERS];
+    uint8_t num_value_registers;
+    /// @brief Offset from the frame pointer to the first operand stack value which is not in a register.
+    /// Deeper values are at lower addresses.
+    int32_t values_offset;
+    /// @brief Offset from the frame pointer where each register is saved, or 0 if it is not saved.
+    /// Index with a value from @ref x86_reg_enum.
+    int32_t save_offsets[X86_NUM_REGISTERS];
     /// @brief Offset from initial SP value
     int32_t stack_offset;
 } x86gen;
@@ -71,5 +111,6 @@ void x86gen_simplify(const x86gen* gen, const cc_ir_func* input, cc_ir_func* out
 /**
  * @brief Dump the IR straight to x86 code.
  * @param func An uninitialized struct to store the result
+ * @return False if the function uses something that is not supported. Then `func` is already destroyed.
  */
-void x86gen_dump(x86gen* gen, x86func* func);
\ No newline at end of file
+bool x86gen_dump(x86gen* gen, x86func* func);
\ No newline at end of file
@@ -157,7 +157,9 @@ void cc_ir_func_clone(const cc_ir_func* func, cc_ir_func* clone)
     memset(clone, 0, sizeof(*clone));
     clone->num_blocks = func->num_blocks;
     clone->num_locals = func->num_locals;
+    clone->symbolid = func->symbolid;
     clone->_next_localid = func->_next_localid;
+    clone->_next_blockid = func->_next_blockid;
 
     // Clone the locals array and the names of all locals
     clone->locals = (cc_ir_local*)malloc(clone->num_locals * sizeof(clone->locals[0]));
@@ -173,6 +175,7 @@ void cc_ir_func_clone(const cc_ir_func* func, cc_ir_func* clone)
     }
 
     // Clone the linked list of blocks
+    clone->blocks = (cc_ir_block**)malloc(clone->num_blocks * sizeof(clone->blocks[0]));
     cc_ir_block** link = &clone->entry_block;
     for (const cc_ir_block* block = func->entry_block; block; block = block->next_block)
     {
@@ -180,12 +183,19 @@ void cc_ir_func_clone(const cc_ir_func* func, cc_ir_func* clone)
         memcpy(clone_block, block, sizeof(*clone_block));
         *link = clone_block;
         link = &clone_block->next_block;
+        clone->blocks[clone_block->blockid] = clone_block;
         
         if (clone_block->ins)
         {
             clone_block->ins = (cc_ir_ins*)malloc(clone_block->num_ins * sizeof(clone_block->ins[0]));
             memcpy(clone_block->ins, block->ins, clone_block->num_ins * sizeof(clone_block->ins[0]));
         }
+        if (clone_block->name)
+        {
+            size_t size = strlen(block->name) + 1;
+            clone_block->name = (char*)malloc(size);
+            memcpy(clone_block->name, block->name, size);
+        }
     }
 }
 
@@ -199,6 +209,7 @@ void cc_ir_func_destroy(cc_ir_func* func)
         cc_ir_block_destroy(block);
         block = next_block;
     }
+    free(func->blocks);
     
     // Free all locals
     for (size_t i = 0; i < func->num_locals; ++i)
@@ -214,12 +225,9 @@ cc_ir_local* cc_ir_func_getlocal(const cc_ir_func* func, cc_ir_localid localid)
 }
 cc_ir_block* cc_ir_func_getblock(const cc_ir_func* func, cc_ir_blockid blockid)
 {
-    for (cc_ir_block* block = func->entry_block; block; block = block->next_block)
-    {
-        if (block->blockid == blockid)
-            return block;
-    }
-    return NULL;
+    if (blockid >= func->num_blocks)
+        return NULL;
+    return func->blocks[blockid];
 }
 
 cc_ir_block* cc_ir_func_insert(cc_ir_func* func, cc_ir_block* prev, const char* name, size_t name_len)
@@ -229,6 +237,8 @@ cc_ir_block* cc_ir_func_insert(cc_ir_func* func, cc_ir_block* prev, const char*
     ++func->_next_blockid;
     
     cc_ir_block* current = cc_ir_block_create(blockid, name, name_len);
+    cc_ir_block** entry = (cc_ir_block**)cc_vec_resize(func->blocks, func->num_blocks);
+    *entry = current;
     
     if (prev)
     {
@@ -288,28 +298,32 @@ static cc_ir_ins* cc__ir_block_append_noop(cc_ir_block* block, uint8_t opcode)
 {
     cc_ir_ins ins = {0};
     ins.opcode = opcode;
-    return &block->ins[cc_ir_block_append(block, &ins)];
+    size_t index = cc_ir_block_append(block, &ins);
+    return &block->ins[index];
 }
 static cc_ir_ins* cc__ir_block_append_localop(cc_ir_block* block, uint8_t opcode, cc_ir_localid localid)
 {
     cc_ir_ins ins = {0};
     ins.opcode = opcode;
     ins.operand.local = localid;
-    return &block->ins[cc_ir_block_append(block, &ins)];
+    size_t index = cc_ir_block_append(block, &ins);
+    return &block->ins[index];
 }
 static cc_ir_ins* cc__ir_block_append_u32op(cc_ir_block* block, uint8_t opcode, uint32_t u32)
 {
     cc_ir_ins ins = {0};
     ins.opcode = opcode;
     ins.operand.u32 = u32;
-    return &block->ins[cc_ir_block_append(block, &ins)];
+    size_t index = cc_ir_block_append(block, &ins);
+    return &block->ins[index];
 }
 static cc_ir_ins* cc__ir_block_append_sizeop(cc_ir_block* block, uint8_t opcode, cc_ir_datasize data_size)
 {
     cc_ir_ins ins = {0};
     ins.opcode = opcode;
     ins.data_size = data_size;
-    return &block->ins[cc_ir_block_append(block, &ins)];
+    size_t index = cc_ir_block_append(block, &ins);
+    return &block->ins[index];
 }
 
 void cc_ir_block_argp(cc_ir_block* block)                           { cc__ir_block_append_noop(block, CC_IR_OPCODE_ARGP); }
@@ -360,3 +374,416 @@ void cc_ir_block_jnz(cc_ir_block* block, cc_ir_datasize data_size, const cc_ir_b
 }
 void cc_ir_block_ret(cc_ir_block* block) { cc__ir_block_append_noop(block, CC_IR_OPCODE_RET); }
 void cc_ir_block_int(cc_ir_block* block, uint32_t interrupt_code) { cc__ir_block_append_u32op(block, CC_IR_OPCODE_INT, interrupt_code); }
+
+/// @brief A growing buffer for @ref cc_ir_object_write
+typedef struct cc__ir_writer
+{
+    uint8_t* data;
+    size_t size;
+    size_t cap;
+} cc__ir_writer;
+
+/// @brief Names for @ref cc_ir_object_write. Index 0 is no name.
+typedef struct cc__ir_strtab
+{
+    const char** strings;
+    size_t* lengths;
+    size_t num_strings;
+    /// @brief Map name hash -> index of the first string with that hash
+    cc_hmap32 map;
+} cc__ir_strtab;
+
+/// @brief The data read by @ref cc_ir_object_read. Reading past the end clears `is_ok`.
+typedef struct cc__ir_reader
+{
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+    bool is_ok;
+} cc__ir_reader;
+
+static void cc__ir_write_bytes(cc__ir_writer* writer, const void* data, size_t size)
+{
+    if (writer->size + size > writer->cap)
+    {
+        writer->cap = writer->cap * 2 > writer->size + size ? writer->cap * 2 : writer->size + size;
+        writer->data = (uint8_t*)realloc(writer->data, writer->cap);
+    }
+    memcpy(writer->data + writer->size, data, size);
+    writer->size += size;
+}
+static void cc__ir_write_varint(cc__ir_writer* writer, uint64_t value)
+{
+    uint8_t bytes[10];
+    size_t size = 0;
+    do
+    {
+        bytes[size] = (uint8_t)(value & 0x7F);
+        value >>= 7;
+        bytes[size++] |= value ? 0x80 : 0;
+    } while (value);
+    cc__ir_write_bytes(writer, bytes, size);
+}
+static void cc__ir_write_byte(cc__ir_writer* writer, uint8_t value) {
+    cc__ir_write_bytes(writer, &value, 1);
+}
+/// @brief Add a name to the string table
+/// @return The name's index. Equal names usually share an index.
+static uint32_t cc__ir_strtab_add(cc__ir_strtab* strtab, const char* name, size_t name_len)
+{
+    if (!name || !name_len)
+        return 0;
+    uint32_t hash = cc_fnv1a_32(name, name_len);
+    uint32_t index;
+    bool is_hashed = cc_hmap32_get(&strtab->map, hash, &index);
+    if (is_hashed && strtab->lengths[index] == name_len && !memcmp(strtab->strings[index], name, name_len))
+        return index;
+
+    // A new name, or a name whose hash collides, which is stored again
+    index = (uint32_t)strtab->num_strings++;
+    cc_vec_resize(strtab->strings, strtab->num_strings);
+    cc_vec_resize(strtab->lengths, strtab->num_strings);
+    strtab->strings[index] = name;
+    strtab->lengths[index] = name_len;
+    if (!is_hashed)
+        cc_hmap32_put(&strtab->map, hash, index);
+    return index;
+}
+/// @brief Write an instruction's opcode, and only the operands in its format
+static void cc__ir_write_ins(cc__ir_writer* writer, const cc_ir_ins* ins)
+{
+    const cc_ir_ins_format* fmt = &cc_ir_ins_formats[ins->opcode];
+    cc__ir_write_byte(writer, ins->opcode);
+    for (size_t i = 0; i < CC_IR_MAX_OPERANDS; ++i)
+    {
+        switch (fmt->operand[i])
+        {
+        case CC_IR_OPERAND_DATASIZE:        cc__ir_write_varint(writer, ins->data_size); break;
+        case CC_IR_OPERAND_LOCAL:           cc__ir_write_varint(writer, ins->operand.local); break;
+        case CC_IR_OPERAND_SYMBOLID:        cc__ir_write_varint(writer, ins->operand.symbolid); break;
+        case CC_IR_OPERAND_BLOCKID:         cc__ir_write_varint(writer, ins->operand.blockid); break;
+        case CC_IR_OPERAND_EXTEND_DATASIZE: cc__ir_write_varint(writer, ins->operand.extend_data_size); break;
+        case CC_IR_OPERAND_U32:
+            if (ins->opcode == CC_IR_OPCODE_ICONST) // Zigzag, so small negative constants are small
+                cc__ir_write_varint(writer, ((uint32_t)ins->operand.u32 << 1) ^ (uint32_t)((int32_t)ins->operand.u32 >> 31));
+            else
+                cc__ir_write_varint(writer, ins->operand.u32);
+            break;
+        }
+    }
+}
+
+bool cc_ir_object_write(const cc_ir_object* obj, cc_stream* stream)
+{
+    cc__ir_strtab strtab;
+    memset(&strtab, 0, sizeof(strtab));
+    cc_hmap32_create(&strtab.map);
+    strtab.num_strings = 1;
+    cc_vec_resize(strtab.strings, 1);
+    cc_vec_resize(strtab.lengths, 1);
+    strtab.strings[0] = NULL;
+    strtab.lengths[0] = 0;
+
+    // Collect every name, in the order they are written.
+    // Their indexes are kept, because a name with a colliding hash would be added twice.
+    uint32_t* name_indexes = NULL;
+    size_t num_names = 0;
+#define CC__IR_ADD_NAME(name, name_len) do { \
+        ++num_names; \
+        uint32_t* entry = (uint32_t*)cc_vec_resize(name_indexes, num_names); \
+        *entry = cc__ir_strtab_add(&strtab, (name), (name_len)); \
+    } while (0)
+    for (size_t i = 0; i < obj->num_symbols; ++i)
+    {
+        const cc_ir_symbol* symbol = &obj->symbols[i];
+        CC__IR_ADD_NAME(symbol->name, symbol->name_len);
+        if (symbol->symbol_flags & CC_IR_SYMBOLFLAG_EXTERNAL)
+            continue;
+        const cc_ir_func* func = symbol->ptr.func;
+        for (size_t j = 1; j < func->num_locals; ++j)
+            CC__IR_ADD_NAME(func->locals[j].name, func->locals[j].name ? strlen(func->locals[j].name) : 0);
+        for (size_t j = 0; j < func->num_blocks; ++j)
+            CC__IR_ADD_NAME(func->blocks[j]->name, func->blocks[j]->name ? strlen(func->blocks[j]->name) : 0);
+    }
+#undef CC__IR_ADD_NAME
+
+    cc__ir_writer writer;
+    memset(&writer, 0, sizeof(writer));
+    cc__ir_write_varint(&writer, strtab.num_strings - 1);
+    for (size_t i = 1; i < strtab.num_strings; ++i)
+    {
+        cc__ir_write_varint(&writer, strtab.lengths[i]);
+        cc__ir_write_bytes(&writer, strtab.strings[i], strtab.lengths[i]);
+    }
+
+    size_t name_index = 0;
+    cc__ir_write_varint(&writer, obj->_next_symbolid);
+    cc__ir_write_varint(&writer, obj->num_symbols);
+    for (size_t i = 0; i < obj->num_symbols; ++i)
+    {
+        const cc_ir_symbol* symbol = &obj->symbols[i];
+        cc__ir_write_varint(&writer, symbol->symbolid);
+        cc__ir_write_byte(&writer, symbol->symbol_flags);
+        cc__ir_write_varint(&writer, name_indexes[name_index++]);
+        if (symbol->symbol_flags & CC_IR_SYMBOLFLAG_EXTERNAL)
+            continue;
+
+        // Local 0 is the function itself, which every function starts with
+        const cc_ir_func* func = symbol->ptr.func;
+        cc__ir_write_varint(&writer, func->num_locals);
+        for (size_t j = 1; j < func->num_locals; ++j)
+        {
+            cc__ir_write_varint(&writer, name_indexes[name_index++]);
+            cc__ir_write_varint(&writer, func->locals[j].typeid);
+            cc__ir_write_varint(&writer, func->locals[j].data_size);
+        }
+        // Blocks are written by ID, then their order
+        cc__ir_write_varint(&writer, func->num_blocks);
+        for (size_t j = 0; j < func->num_blocks; ++j)
+        {
+            const cc_ir_block* block = func->blocks[j];
+            cc__ir_write_varint(&writer, name_indexes[name_index++]);
+            cc__ir_write_varint(&writer, block->num_ins);
+            for (size_t k = 0; k < block->num_ins; ++k)
+                cc__ir_write_ins(&writer, &block->ins[k]);
+        }
+        for (const cc_ir_block* block = func->entry_block; block; block = block->next_block)
+            cc__ir_write_varint(&writer, block->blockid);
+    }
+
+    // The header has the size of everything else, so a reader can read it at once
+    cc__ir_writer header;
+    memset(&header, 0, sizeof(header));
+    cc__ir_write_bytes(&header, "CCIR", 4);
+    cc__ir_write_varint(&header, CC_IR_OBJECT_VERSION);
+    cc__ir_write_varint(&header, writer.size);
+    bool result = cc_stream_write(stream, header.data, header.size) == header.size
+        && (!writer.size || cc_stream_write(stream, writer.data, writer.size) == writer.size);
+
+    free(header.data);
+    free(writer.data);
+    free(name_indexes);
+    free(strtab.strings);
+    free(strtab.lengths);
+    cc_hmap32_destroy(&strtab.map);
+    return result;
+}
+
+static uint64_t cc__ir_read_varint(cc__ir_reader* reader)
+{
+    uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7)
+    {
+        if (reader->pos >= reader->size)
+            break;
+        uint8_t byte = reader->data[reader->pos++];
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return value;
+    }
+    reader->is_ok = false;
+    return 0;
+}
+static uint8_t cc__ir_read_byte(cc__ir_reader* reader)
+{
+    if (reader->pos >= reader->size)
+    {
+        reader->is_ok = false;
+        return 0;
+    }
+    return reader->data[reader->pos++];
+}
+/// @brief Read a count of items which are each at least one byte, so a corrupt count cannot cause a huge allocation
+static size_t cc__ir_read_count(cc__ir_reader* reader)
+{
+    uint64_t count = cc__ir_read_varint(reader);
+    if (count > reader->size - reader->pos)
+    {
+        reader->is_ok = false;
+        return 0;
+    }
+    return (size_t)count;
+}
+/// @brief Read a varint from a stream, one byte at a time, so nothing after it is consumed
+static bool cc__ir_read_stream_varint(cc_stream* stream, uint64_t* out_value)
+{
+    *out_value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7)
+    {
+        uint8_t byte;
+        if (cc_stream_read(stream, &byte, 1) != 1)
+            return false;
+        *out_value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+static void cc__ir_read_ins(cc__ir_reader* reader, cc_ir_ins* ins)
+{
+    memset(ins, 0, sizeof(*ins));
+    ins->opcode = cc__ir_read_byte(reader);
+    if (ins->opcode >= CC_IR_OPCODE__COUNT)
+    {
+        reader->is_ok = false;
+        return;
+    }
+    const cc_ir_ins_format* fmt = &cc_ir_ins_formats[ins->opcode];
+    for (size_t i = 0; i < CC_IR_MAX_OPERANDS; ++i)
+    {
+        switch (fmt->operand[i])
+        {
+        case CC_IR_OPERAND_DATASIZE:        ins->data_size = (cc_ir_datasize)cc__ir_read_varint(reader); break;
+        case CC_IR_OPERAND_LOCAL:           ins->operand.local = (cc_ir_localid)cc__ir_read_varint(reader); break;
+        case CC_IR_OPERAND_SYMBOLID:        ins->operand.symbolid = (cc_ir_symbolid)cc__ir_read_varint(reader); break;
+        case CC_IR_OPERAND_BLOCKID:         ins->operand.blockid = (cc_ir_blockid)cc__ir_read_varint(reader); break;
+        case CC_IR_OPERAND_EXTEND_DATASIZE: ins->operand.extend_data_size = (cc_ir_datasize)cc__ir_read_varint(reader); break;
+        case CC_IR_OPERAND_U32:
+        {
+            uint32_t value = (uint32_t)cc__ir_read_varint(reader);
+            ins->operand.u32 = ins->opcode == CC_IR_OPCODE_ICONST ? (value >> 1) ^ (0u - (value & 1)) : value;
+            break;
+        }
+        }
+    }
+}
+/// @brief Read a function into `func`, which already has its first local and block
+static void cc__ir_read_func(cc__ir_reader* reader, cc_ir_func* func, const char* const* strings, const size_t* lengths, size_t num_strings)
+{
+    size_t num_locals = cc__ir_read_count(reader);
+    if (!num_locals)
+        reader->is_ok = false;
+    for (size_t i = 1; i < num_locals && reader->is_ok; ++i)
+    {
+        uint64_t name = cc__ir_read_varint(reader);
+        uint16_t typeid = (uint16_t)cc__ir_read_varint(reader);
+        uint32_t data_size = (uint32_t)cc__ir_read_varint(reader);
+        if (name >= num_strings)
+            reader->is_ok = false;
+        if (!reader->is_ok)
+            break;
+        cc_ir_localid localid = cc_ir_func_local(func, NULL, data_size, typeid);
+        func->locals[localid].name = cc_strclone_char(strings[name], lengths[name], NULL);
+    }
+
+    size_t num_blocks = cc__ir_read_count(reader);
+    if (!num_blocks)
+        reader->is_ok = false;
+    cc_ir_block* prev = NULL;
+    for (size_t i = 0; i < num_blocks && reader->is_ok; ++i)
+    {
+        uint64_t name = cc__ir_read_varint(reader);
+        if (name >= num_strings)
+            reader->is_ok = false;
+        if (!reader->is_ok)
+            break;
+        cc_ir_block* block;
+        if (i == 0)
+        {
+            block = func->entry_block;
+            block->name = cc_strclone_char(strings[name], lengths[name], NULL);
+        }
+        else
+            block = cc_ir_func_insert(func, prev, strings[name], lengths[name]);
+        prev = block;
+
+        size_t num_ins = cc__ir_read_count(reader);
+        cc_vec_resize(block->ins, num_ins);
+        block->num_ins = num_ins;
+        for (size_t j = 0; j < num_ins; ++j)
+            cc__ir_read_ins(reader, &block->ins[j]);
+    }
+    if (!reader->is_ok)
+        return;
+
+    // Link the blocks in their original order, which must include every block once
+    bool* is_linked = (bool*)calloc(num_blocks, sizeof(*is_linked));
+    cc_ir_block** link = &func->entry_block;
+    for (size_t i = 0; i < num_blocks && reader->is_ok; ++i)
+    {
+        uint64_t blockid = cc__ir_read_varint(reader);
+        if (blockid >= num_blocks || is_linked[blockid])
+        {
+            reader->is_ok = false;
+            break;
+        }
+        is_linked[blockid] = true;
+        *link = func->blocks[blockid];
+        link = &func->blocks[blockid]->next_block;
+    }
+    if (reader->is_ok)
+        *link = NULL;
+    else
+    {
+        // Keep every block in the list, so they are freed with the function
+        func->entry_block = func->blocks[0];
+        for (size_t i = 0; i < num_blocks; ++i)
+            func->blocks[i]->next_block = i + 1 < num_blocks ? func->blocks[i + 1] : NULL;
+    }
+    free(is_linked);
+}
+
+bool cc_ir_object_read(cc_ir_object* obj, cc_stream* stream)
+{
+    uint8_t magic[4];
+    uint64_t version, size;
+    if (cc_stream_read(stream, magic, sizeof(magic)) != sizeof(magic) || memcmp(magic, "CCIR", sizeof(magic))
+        || !cc__ir_read_stream_varint(stream, &version) || version != CC_IR_OBJECT_VERSION
+        || !cc__ir_read_stream_varint(stream, &size) || size > SIZE_MAX)
+        return false;
+
+    uint8_t* data = (uint8_t*)malloc(size ? (size_t)size : 1);
+    if (!data)
+        return false;
+    if (cc_stream_read(stream, data, (size_t)size) != size)
+    {
+        free(data);
+        return false;
+    }
+
+    cc__ir_reader reader = { data, (size_t)size, 0, true };
+    cc_ir_object_create(obj);
+
+    // Names point into the data, until they are copied
+    size_t num_strings = cc__ir_read_count(&reader) + 1;
+    const char** strings = (const char**)malloc(num_strings * sizeof(strings[0]));
+    size_t* lengths = (size_t*)malloc(num_strings * sizeof(lengths[0]));
+    strings[0] = NULL;
+    lengths[0] = 0;
+    for (size_t i = 1; i < num_strings && reader.is_ok; ++i)
+    {
+        lengths[i] = cc__ir_read_count(&reader);
+        strings[i] = (const char*)reader.data + reader.pos;
+        reader.pos += lengths[i];
+    }
+
+    obj->_next_symbolid = (cc_ir_symbolid)cc__ir_read_varint(&reader);
+    size_t num_symbols = cc__ir_read_count(&reader);
+    for (size_t i = 0; i < num_symbols && reader.is_ok; ++i)
+    {
+        cc_ir_symbolid symbolid = (cc_ir_symbolid)cc__ir_read_varint(&reader);
+        uint8_t symbol_flags = cc__ir_read_byte(&reader);
+        uint64_t name = cc__ir_read_varint(&reader);
+        if (name >= num_strings)
+            reader.is_ok = false;
+        if (!reader.is_ok)
+            break;
+
+        ++obj->num_symbols;
+        cc_ir_symbol* symbol = (cc_ir_symbol*)cc_vec_resize(obj->symbols, obj->num_symbols);
+        cc_ir_symbol_create(symbol, symbolid, strings[name], lengths[name]);
+        symbol->symbol_flags = symbol_flags;
+        if (symbol_flags & CC_IR_SYMBOLFLAG_EXTERNAL)
+            continue;
+        symbol->ptr.func = cc_ir_func_create(symbolid);
+        cc__ir_read_func(&reader, symbol->ptr.func, strings, lengths, num_strings);
+    }
+
+    bool result = reader.is_ok && reader.pos == reader.size;
+    if (!result)
+        cc_ir_object_destroy(obj);
+    free(strings);
+    free(lengths);
+    free(data);
+    return result;
+}
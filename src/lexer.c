@@ -1,70 +1,206 @@
 #include <cc/lexer.h>
 
+// SSE2 is always available on x86-64. Other hosts scan one char at a time.
+#if !defined(CC_LEXER_SIMD)
+    #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        #define CC_LEXER_SIMD 1
+    #else
+        #define CC_LEXER_SIMD 0
+    #endif
+#endif
+#if CC_LEXER_SIMD
+    #include <emmintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #endif
+#endif
+
 typedef struct cc_keyword
 {
     const cc_char* str;
     int tokenid;
 } cc_keyword;
 
-static cc_keyword cc_keyword_list[] =
-{
-    {"int", CC_TOKENID_INT},
-    {"char", CC_TOKENID_CHAR},
-    {"void", CC_TOKENID_VOID},
-    {"const", CC_TOKENID_CONST},
-    {"short", CC_TOKENID_SHORT},
-    {"long", CC_TOKENID_LONG},
-    {"signed", CC_TOKENID_SIGNED},
-    {"unsigned", CC_TOKENID_UNSIGNED},
-    {"volatile", CC_TOKENID_VOLATILE},
-    {"static", CC_TOKENID_STATIC},
-    {"if", CC_TOKENID_IF},
-    {"else", CC_TOKENID_ELSE},
-    {"while", CC_TOKENID_WHILE},
-    {"goto", CC_TOKENID_GOTO},
-    {"return", CC_TOKENID_RETURN},
-    {"break", CC_TOKENID_BREAK},
-    {"continue", CC_TOKENID_CONTINUE},
-    {NULL, 0} // Null terminator. Do not remove.
+/// @brief Size of @ref cc_keyword_table. Must be a power of 2.
+#define CC__KEYWORD_TABLE_SIZE 64
+/**
+ * @brief Hash an identifier by its length, first char, and last char
+ * @details No two keywords have the same hash, so a lookup compares at most one string.
+ * If a new keyword collides with another, change the multipliers until none do.
+ */
+#define CC__KEYWORD_HASH(len, first, last) \
+    (((size_t)(len) + (size_t)(first) + (size_t)(last) * 4) & (CC__KEYWORD_TABLE_SIZE - 1))
+#define CC__KEYWORD(str, first, last, tokenid) \
+    [CC__KEYWORD_HASH(sizeof(str) / sizeof(cc_char) - 1, first, last)] = { str, tokenid }
+
+// Every keyword, in the slot of its hash. Empty slots have a null string.
+static const cc_keyword cc_keyword_table[CC__KEYWORD_TABLE_SIZE] =
+{
+    CC__KEYWORD("int", 'i', 't', CC_TOKENID_INT),
+    CC__KEYWORD("char", 'c', 'r', CC_TOKENID_CHAR),
+    CC__KEYWORD("void", 'v', 'd', CC_TOKENID_VOID),
+    CC__KEYWORD("const", 'c', 't', CC_TOKENID_CONST),
+    CC__KEYWORD("short", 's', 't', CC_TOKENID_SHORT),
+    CC__KEYWORD("long", 'l', 'g', CC_TOKENID_LONG),
+    CC__KEYWORD("signed", 's', 'd', CC_TOKENID_SIGNED),
+    CC__KEYWORD("unsigned", 'u', 'd', CC_TOKENID_UNSIGNED),
+    CC__KEYWORD("volatile", 'v', 'e', CC_TOKENID_VOLATILE),
+    CC__KEYWORD("static", 's', 'c', CC_TOKENID_STATIC),
+    CC__KEYWORD("if", 'i', 'f', CC_TOKENID_IF),
+    CC__KEYWORD("else", 'e', 'e', CC_TOKENID_ELSE),
+    CC__KEYWORD("while", 'w', 'e', CC_TOKENID_WHILE),
+    CC__KEYWORD("goto", 'g', 'o', CC_TOKENID_GOTO),
+    CC__KEYWORD("return", 'r', 'n', CC_TOKENID_RETURN),
+    CC__KEYWORD("break", 'b', 'k', CC_TOKENID_BREAK),
+    CC__KEYWORD("continue", 'c', 'e', CC_TOKENID_CONTINUE),
+};
+
+/// @brief Flags of @ref cc_char_classes
+enum
+{
+    CC__CHAR_SPACE = 1 << 0,
+    CC__CHAR_DIGIT = 1 << 1,
+    /// @brief A letter or underscore, which may begin an identifier
+    CC__CHAR_IDENT_BEGIN = 1 << 2,
+    /// @brief A letter, digit, or underscore, which may continue an identifier
+    CC__CHAR_IDENT = 1 << 3,
+    /// @brief The first char of a punctuation token in @ref cc_punctuation_table
+    CC__CHAR_PUNCT = 1 << 4,
 };
 
-// Order all overlapping tokens (like "++" and "+") with the longer one first
-static cc_keyword cc_punctuation_list[] =
-{
-    {"++", CC_TOKENID_PLUSPLUS},
-    {"+", CC_TOKENID_PLUS},
-    {"-", CC_TOKENID_MINUS},
-    {"--", CC_TOKENID_MINUSMINUS},
-    {"/", CC_TOKENID_SLASH},
-    {"%", CC_TOKENID_PERCENT},
-    {"*", CC_TOKENID_ASTERISK},
-    {"&&", CC_TOKENID_AMPAMP},
-    {"&", CC_TOKENID_AMP},
-    {"||", CC_TOKENID_PIPEPIPE},
-    {"|", CC_TOKENID_PIPE},
-    {"^", CC_TOKENID_CARET},
-    {"==", CC_TOKENID_EQUALEQUAL},
-    {"=", CC_TOKENID_EQUAL},
-    {",", CC_TOKENID_COMMA},
-    {".", CC_TOKENID_DOT},
-    {":", CC_TOKENID_COLON},
-    {";", CC_TOKENID_SEMICOLON},
-    {"!=", CC_TOKENID_EXCLAMATIONEQUAL},
-    {"!", CC_TOKENID_EXCLAMATION},
-    {"?", CC_TOKENID_QUESTION},
-    {"->", CC_TOKENID_ARROW},
-    {"~", CC_TOKENID_TILDE},
-    {"{", CC_TOKENID_LEFT_CURLY},
-    {"}", CC_TOKENID_RIGHT_CURLY},
-    {"(", CC_TOKENID_LEFT_ROUND},
-    {")", CC_TOKENID_RIGHT_ROUND},
-    {"[", CC_TOKENID_LEFT_SQUARE},
-    {"]", CC_TOKENID_RIGHT_SQUARE},
-    {"<=", CC_TOKENID_LEFT_ANGLEEQUAL},
-    {"<", CC_TOKENID_LEFT_ANGLE},
-    {">=", CC_TOKENID_RIGHT_ANGLEEQUAL},
-    {">", CC_TOKENID_RIGHT_ANGLE},
-    {NULL, 0} // Null terminator. Do not remove.
+#define CC__CHAR_LETTER (CC__CHAR_IDENT_BEGIN | CC__CHAR_IDENT)
+#define CC__CHAR_LETTERS(c) \
+    [c] = CC__CHAR_LETTER, [c + 1] = CC__CHAR_LETTER, [c + 2] = CC__CHAR_LETTER, [c + 3] = CC__CHAR_LETTER, \
+    [c + 4] = CC__CHAR_LETTER, [c + 5] = CC__CHAR_LETTER, [c + 6] = CC__CHAR_LETTER, [c + 7] = CC__CHAR_LETTER
+
+// The class of every byte, as in the "C" locale. Chars past the table have no class.
+static const uint8_t cc_char_classes[256] =
+{
+    [' '] = CC__CHAR_SPACE, ['\t'] = CC__CHAR_SPACE, ['\n'] = CC__CHAR_SPACE,
+    ['\v'] = CC__CHAR_SPACE, ['\f'] = CC__CHAR_SPACE, ['\r'] = CC__CHAR_SPACE,
+    ['0'] = CC__CHAR_DIGIT | CC__CHAR_IDENT, ['1'] = CC__CHAR_DIGIT | CC__CHAR_IDENT,
+    ['2'] = CC__CHAR_DIGIT | CC__CHAR_IDENT, ['3'] = CC__CHAR_DIGIT | CC__CHAR_IDENT,
+    ['4'] = CC__CHAR_DIGIT | CC__CHAR_IDENT, ['5'] = CC__CHAR_DIGIT | CC__CHAR_IDENT,
+    ['6'] = CC__CHAR_DIGIT | CC__CHAR_IDENT, ['7'] = CC__CHAR_DIGIT | CC__CHAR_IDENT,
+    ['8'] = CC__CHAR_DIGIT | CC__CHAR_IDENT, ['9'] = CC__CHAR_DIGIT | CC__CHAR_IDENT,
+    CC__CHAR_LETTERS('a'), CC__CHAR_LETTERS('i'), CC__CHAR_LETTERS('q'), ['y'] = CC__CHAR_LETTER, ['z'] = CC__CHAR_LETTER,
+    CC__CHAR_LETTERS('A'), CC__CHAR_LETTERS('I'), CC__CHAR_LETTERS('Q'), ['Y'] = CC__CHAR_LETTER, ['Z'] = CC__CHAR_LETTER,
+    ['_'] = CC__CHAR_LETTER,
+    ['+'] = CC__CHAR_PUNCT, ['-'] = CC__CHAR_PUNCT, ['/'] = CC__CHAR_PUNCT, ['%'] = CC__CHAR_PUNCT,
+    ['*'] = CC__CHAR_PUNCT, ['&'] = CC__CHAR_PUNCT, ['|'] = CC__CHAR_PUNCT, ['^'] = CC__CHAR_PUNCT,
+    ['='] = CC__CHAR_PUNCT, [','] = CC__CHAR_PUNCT, ['.'] = CC__CHAR_PUNCT, [':'] = CC__CHAR_PUNCT,
+    [';'] = CC__CHAR_PUNCT, ['!'] = CC__CHAR_PUNCT, ['?'] = CC__CHAR_PUNCT, ['~'] = CC__CHAR_PUNCT,
+    ['{'] = CC__CHAR_PUNCT, ['}'] = CC__CHAR_PUNCT, ['('] = CC__CHAR_PUNCT, [')'] = CC__CHAR_PUNCT,
+    ['['] = CC__CHAR_PUNCT, [']'] = CC__CHAR_PUNCT, ['<'] = CC__CHAR_PUNCT, ['>'] = CC__CHAR_PUNCT,
+};
+
+/// @brief Check if a char is in any of the classes in `flags`
+static int cc_char_is(cc_char c, int flags) {
+    return (size_t)c < sizeof(cc_char_classes) && (cc_char_classes[(size_t)c] & flags);
+}
+
+#if CC_LEXER_SIMD
+/// @brief Get a mask of the bytes in `[lo, hi]`. Bytes from 128 are negative, so they are never in an ASCII range.
+static __m128i cc__lexer_simd_range(__m128i bytes, char lo, char hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8((char)(lo - 1))), _mm_cmplt_epi8(bytes, _mm_set1_epi8((char)(hi + 1))));
+}
+/// @brief Get a mask of the bytes in any of the classes in `flags`, which must be one of the flags that are scanned
+static __m128i cc__lexer_simd_classify(__m128i bytes, int flags)
+{
+    if (flags == CC__CHAR_SPACE) // ' ', or '\t' to '\r'
+        return _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')), cc__lexer_simd_range(bytes, '\t', '\r'));
+    __m128i digits = cc__lexer_simd_range(bytes, '0', '9');
+    if (flags == CC__CHAR_DIGIT)
+        return digits;
+    // Setting 0x20 makes capital letters lowercase, and leaves other letters the same
+    __m128i letters = cc__lexer_simd_range(_mm_or_si128(bytes, _mm_set1_epi8(0x20)), 'a', 'z');
+    __m128i underscores = _mm_cmpeq_epi8(bytes, _mm_set1_epi8('_'));
+    return _mm_or_si128(_mm_or_si128(letters, underscores), digits);
+}
+static unsigned cc__lexer_ctz(unsigned mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctz(mask);
+#endif
+}
+#endif
+
+/**
+ * @brief Find the end of a run of chars in any of the classes in `flags`
+ * @param flags @ref CC__CHAR_SPACE, @ref CC__CHAR_DIGIT, or @ref CC__CHAR_IDENT
+ * @return The first char which is not in the classes, or `end`
+ */
+static const cc_char* cc_lexer_scan(const cc_char* str, const cc_char* end, int flags)
+{
+#if CC_LEXER_SIMD
+    // Most runs are short, so the first chars are checked one at a time
+    for (const cc_char* short_end = end - str > 8 ? str + 8 : end; str < short_end; ++str)
+    {
+        if (!cc_char_is(*str, flags))
+            return str;
+    }
+    // Classify 16 chars at once, and find the first char outside the run
+    if (sizeof(cc_char) == 1)
+    {
+        while (end - str >= 16)
+        {
+            __m128i bytes = _mm_loadu_si128((const __m128i*)str);
+            unsigned outside = ~(unsigned)_mm_movemask_epi8(cc__lexer_simd_classify(bytes, flags)) & 0xFFFF;
+            if (outside)
+                return str + cc__lexer_ctz(outside);
+            str += 16;
+        }
+    }
+#endif
+    while (str < end && cc_char_is(*str, flags))
+        ++str;
+    return str;
+}
+
+/// @brief The maximum number of longer tokens that begin with the same char
+#define CC__PUNCT_MAX_NEXT 2
+
+/// @brief The punctuation tokens that begin with one char
+typedef struct cc_punctuation
+{
+    /// @brief Token of the char alone, or 0 if it is only the beginning of longer tokens
+    int tokenid;
+    /// @brief Second chars of longer tokens. Unused entries are 0.
+    cc_char next[CC__PUNCT_MAX_NEXT];
+    int next_tokenid[CC__PUNCT_MAX_NEXT];
+} cc_punctuation;
+
+// Every punctuation token, by its first char. The longest match is read.
+static const cc_punctuation cc_punctuation_table[256] =
+{
+    ['+'] = { CC_TOKENID_PLUS, { '+' }, { CC_TOKENID_PLUSPLUS } },
+    ['-'] = { CC_TOKENID_MINUS, { '-', '>' }, { CC_TOKENID_MINUSMINUS, CC_TOKENID_ARROW } },
+    ['/'] = { CC_TOKENID_SLASH },
+    ['%'] = { CC_TOKENID_PERCENT },
+    ['*'] = { CC_TOKENID_ASTERISK },
+    ['&'] = { CC_TOKENID_AMP, { '&' }, { CC_TOKENID_AMPAMP } },
+    ['|'] = { CC_TOKENID_PIPE, { '|' }, { CC_TOKENID_PIPEPIPE } },
+    ['^'] = { CC_TOKENID_CARET },
+    ['='] = { CC_TOKENID_EQUAL, { '=' }, { CC_TOKENID_EQUALEQUAL } },
+    [','] = { CC_TOKENID_COMMA },
+    ['.'] = { CC_TOKENID_DOT },
+    [':'] = { CC_TOKENID_COLON },
+    [';'] = { CC_TOKENID_SEMICOLON },
+    ['!'] = { CC_TOKENID_EXCLAMATION, { '=' }, { CC_TOKENID_EXCLAMATIONEQUAL } },
+    ['?'] = { CC_TOKENID_QUESTION },
+    ['~'] = { CC_TOKENID_TILDE },
+    ['{'] = { CC_TOKENID_LEFT_CURLY },
+    ['}'] = { CC_TOKENID_RIGHT_CURLY },
+    ['('] = { CC_TOKENID_LEFT_ROUND },
+    [')'] = { CC_TOKENID_RIGHT_ROUND },
+    ['['] = { CC_TOKENID_LEFT_SQUARE },
+    [']'] = { CC_TOKENID_RIGHT_SQUARE },
+    ['<'] = { CC_TOKENID_LEFT_ANGLE, { '=' }, { CC_TOKENID_LEFT_ANGLEEQUAL } },
+    ['>'] = { CC_TOKENID_RIGHT_ANGLE, { '=' }, { CC_TOKENID_RIGHT_ANGLEEQUAL } },
 };
 
 static int cc_lexer_peek(const cc_lexer* lex, cc_char* out_char)
@@ -85,22 +221,16 @@ static int cc_lexer_match(cc_lexer* lex, cc_char value)
 
 static void cc_lexer_skipwhitespace(cc_lexer* lex)
 {
-    while (lex->str < lex->end)
-    {
-        if (!cc_isspace(*lex->str))
-            break;
-        ++lex->str;
-    }
+    lex->str = cc_lexer_scan(lex->str, lex->end, CC__CHAR_SPACE);
 }
 
 static int cc_lexer_read_identifier(const cc_lexer* lex, cc_token* out_tk)
 {
     const cc_char* next = lex->str;
-    if (next < lex->end && cc_isdigit(*next))
+    if (next >= lex->end || !cc_char_is(*next, CC__CHAR_IDENT_BEGIN))
         return 0;
     
-    while (next < lex->end && (cc_isalnum(*next) || *next == '_'))
-        ++next;
+    next = cc_lexer_scan(next, lex->end, CC__CHAR_IDENT);
     
     if (next == lex->str) // If we haven't moved
         return 0;
@@ -113,9 +243,7 @@ static int cc_lexer_read_identifier(const cc_lexer* lex, cc_token* out_tk)
 
 static int cc_lexer_read_intconst(const cc_lexer* lex, cc_token* out_tk)
 {
-    const cc_char* next = lex->str;
-    while (next < lex->end && cc_isdigit(*next))
-        ++next;
+    const cc_char* next = cc_lexer_scan(lex->str, lex->end, CC__CHAR_DIGIT);
     if (next == lex->str)
         return 0;
     out_tk->begin = lex->str;
@@ -126,23 +254,26 @@ static int cc_lexer_read_intconst(const cc_lexer* lex, cc_token* out_tk)
 
 static int cc_lexer_read_punctuation(const cc_lexer* lex, cc_token* out_tk)
 {
-    size_t remaining = lex->end - lex->str;
-    if (remaining == 0)
+    if (lex->str >= lex->end || !cc_char_is(*lex->str, CC__CHAR_PUNCT))
         return 0;
     
-    for (const cc_keyword* kw = &cc_punctuation_list[0]; kw->str; ++kw)
+    const cc_punctuation* punct = &cc_punctuation_table[(size_t)*lex->str];
+    out_tk->begin = lex->str;
+    out_tk->end = lex->str + 1;
+    out_tk->tokenid = punct->tokenid;
+    if (lex->str + 1 < lex->end)
     {
-        size_t kw_len = cc_strlen(kw->str);
-        if (kw_len <= remaining && !cc_strncmp(lex->str, kw->str, kw_len))
+        for (size_t i = 0; i < CC__PUNCT_MAX_NEXT && punct->next[i]; ++i)
         {
-            out_tk->begin = lex->str;
-            out_tk->end = lex->str + kw_len;
-            out_tk->tokenid = kw->tokenid;
-            return 1;
+            if (lex->str[1] == punct->next[i])
+            {
+                out_tk->end = lex->str + 2;
+                out_tk->tokenid = punct->next_tokenid[i];
+                break;
+            }
         }
     }
-
-    return 0;
+    return out_tk->tokenid != 0;
 }
 
 void cc_lexer_init(cc_lexer* lex, const cc_char* begin, const cc_char* end)
@@ -160,16 +291,11 @@ int cc_lexer_read(cc_lexer* lex, cc_token* out_tk)
     int found = 1;
     if (cc_lexer_read_identifier(lex, out_tk))
     {
-        // An identifier may be a keyword. Do a lookup to find out.
-        for (const cc_keyword* kw = &cc_keyword_list[0]; kw->str; ++kw)
-        {
-            if (cc_strlen(kw->str) == cc_token_len(out_tk)
-                && !cc_strncmp(out_tk->begin, kw->str, cc_token_len(out_tk)))
-            {
-                out_tk->tokenid = kw->tokenid;
-                break;
-            }
-        }
+        // An identifier may be a keyword. Only the keyword with the same hash can match.
+        size_t len = cc_token_len(out_tk);
+        const cc_keyword* kw = &cc_keyword_table[CC__KEYWORD_HASH(len, out_tk->begin[0], out_tk->end[-1])];
+        if (kw->str && !cc_strncmp(out_tk->begin, kw->str, len) && !kw->str[len])
+            out_tk->tokenid = kw->tokenid;
     } else if (cc_lexer_read_intconst(lex, out_tk)) {
     } else if (cc_lexer_read_punctuation(lex, out_tk)) {
     } else {
@@ -182,27 +308,182 @@ int cc_lexer_read(cc_lexer* lex, cc_token* out_tk)
     return found;
 }
 
+/// @brief Guess how many tokens are in `len` chars. Most tokens and the whitespace between them are longer than 4 chars.
+static size_t cc_lexer_estimate_tokens(size_t len) {
+    return len / 4 + 16;
+}
+
 int cc_lexer_readall(const cc_char* begin, const cc_char* end, cc_token** out_array, size_t* out_len)
 {
     cc_lexer lex;
     cc_token next;
-    cc_token* tokens = NULL;
+    cc_lexer_init(&lex, begin, end);
+    size_t cap_tokens = cc_lexer_estimate_tokens((size_t)(lex.end - lex.str));
+    cc_token* tokens = (cc_token*)malloc(cap_tokens * sizeof(tokens[0]));
     size_t num_tokens = 0;
 
+    while (cc_lexer_read(&lex, &next))
+    {
+        if (num_tokens == cap_tokens)
+        {
+            cap_tokens *= 2;
+            tokens = (cc_token*)realloc(tokens, cap_tokens * sizeof(tokens[0]));
+        }
+        tokens[num_tokens++] = next;
+    }
+
+    // Return the unused estimate. An empty array is `nullptr`, as before.
+    if (!num_tokens)
+    {
+        free(tokens);
+        tokens = NULL;
+    }
+    else if (num_tokens < cap_tokens)
+        tokens = (cc_token*)realloc(tokens, num_tokens * sizeof(tokens[0]));
+
+    *out_array = tokens;
+    *out_len = num_tokens;
+
+    return lex.str == lex.end;
+}
+
+int cc_lexer_readall_arena(const cc_char* begin, const cc_char* end, cc_arena** arena, cc_token** out_array, size_t* out_len)
+{
+    cc_lexer lex;
+    cc_token next;
     cc_lexer_init(&lex, begin, end);
+
+    // Align the array, then reserve the estimate so most strings never grow the arena
+    cc_arena_alloc_align(arena, 0, _Alignof(cc_token));
+    size_t offset = (*arena)->size;
+    cc_arena_reserve(arena, offset + cc_lexer_estimate_tokens((size_t)(lex.end - lex.str)) * sizeof(cc_token));
+    size_t num_tokens = 0;
+
     while (cc_lexer_read(&lex, &next))
     {
+        cc_token* token = (cc_token*)cc_arena_alloc_align(arena, sizeof(next), _Alignof(cc_token));
+        *token = next;
         ++num_tokens;
-        tokens = (cc_token*)realloc(tokens, num_tokens * sizeof(tokens[0]));
-        tokens[num_tokens - 1] = next;
     }
 
-    *out_array = tokens;
+    *out_array = (cc_token*)(cc_arena_dataptr(*arena) + offset);
     *out_len = num_tokens;
 
     return lex.str == lex.end;
 }
 
+void cc_streamlexer_create(cc_streamlexer* lex, size_t ring_cap)
+{
+    memset(lex, 0, sizeof(*lex));
+    lex->ring_cap = ring_cap ? ring_cap : 1;
+    lex->ring = (cc_streamtoken*)malloc(lex->ring_cap * sizeof(lex->ring[0]));
+}
+
+void cc_streamlexer_destroy(cc_streamlexer* lex)
+{
+    free(lex->text);
+    free(lex->ring);
+    memset(lex, 0, sizeof(*lex));
+}
+
+/// @brief Drop the text before the first unread token, and make room for `len` more chars
+static void cc_streamlexer_reserve(cc_streamlexer* lex, size_t len)
+{
+    size_t keep = lex->num_ring ? lex->ring[lex->ring_first].begin : lex->pos;
+    if (keep)
+    {
+        memmove(lex->text, lex->text + keep, (lex->text_len - keep) * sizeof(cc_char));
+        lex->text_len -= keep;
+        lex->pos -= keep;
+        for (size_t i = 0; i < lex->num_ring; ++i)
+        {
+            cc_streamtoken* tk = &lex->ring[(lex->ring_first + i) % lex->ring_cap];
+            tk->begin -= keep;
+            tk->end -= keep;
+        }
+    }
+    if (lex->text_len + len > lex->text_cap)
+    {
+        lex->text_cap = lex->text_cap * 2 > lex->text_len + len ? lex->text_cap * 2 : lex->text_len + len;
+        lex->text = (cc_char*)realloc(lex->text, lex->text_cap * sizeof(cc_char));
+    }
+}
+
+void cc_streamlexer_feed(cc_streamlexer* lex, const cc_char* chunk, size_t len)
+{
+    cc_streamlexer_reserve(lex, len);
+    memcpy(lex->text + lex->text_len, chunk, len * sizeof(cc_char));
+    lex->text_len += len;
+}
+
+int cc_streamlexer_feed_stream(cc_streamlexer* lex, cc_stream* stream, size_t chunk_len)
+{
+    // Read straight into the text, instead of copying a chunk
+    cc_streamlexer_reserve(lex, chunk_len);
+    size_t len = cc_stream_read(stream, (uint8_t*)(lex->text + lex->text_len), chunk_len * sizeof(cc_char)) / sizeof(cc_char);
+    lex->text_len += len;
+    if (!len)
+        cc_streamlexer_finish(lex);
+    return len != 0;
+}
+
+void cc_streamlexer_finish(cc_streamlexer* lex) {
+    lex->is_finished = true;
+}
+
+/// @brief Lex tokens from the text until the ring is full, or the rest of the text may be part of a longer token
+static void cc_streamlexer_fill(cc_streamlexer* lex)
+{
+    while (lex->num_ring < lex->ring_cap && !lex->is_invalid)
+    {
+        cc_lexer sub;
+        cc_token tk;
+        cc_lexer_init(&sub, lex->text + lex->pos, lex->text + lex->text_len);
+        if (!cc_lexer_read(&sub, &tk))
+        {
+            // The whitespace was skipped. Anything after it is not a token, whatever follows it.
+            lex->pos = (size_t)(sub.str - lex->text);
+            lex->is_invalid = sub.str < sub.end;
+            return;
+        }
+        // A token which reaches the end of the text may continue in the next chunk
+        if (tk.end == sub.end && !lex->is_finished)
+        {
+            lex->pos = (size_t)(tk.begin - lex->text);
+            return;
+        }
+
+        cc_streamtoken* entry = &lex->ring[(lex->ring_first + lex->num_ring) % lex->ring_cap];
+        entry->begin = (size_t)(tk.begin - lex->text);
+        entry->end = (size_t)(tk.end - lex->text);
+        entry->tokenid = tk.tokenid;
+        ++lex->num_ring;
+        lex->pos = entry->end;
+    }
+}
+
+int cc_streamlexer_peek(cc_streamlexer* lex, size_t n, cc_token* out_tk)
+{
+    if (n >= lex->num_ring)
+        cc_streamlexer_fill(lex);
+    if (n >= lex->num_ring)
+        return 0;
+    const cc_streamtoken* tk = &lex->ring[(lex->ring_first + n) % lex->ring_cap];
+    out_tk->begin = lex->text + tk->begin;
+    out_tk->end = lex->text + tk->end;
+    out_tk->tokenid = tk->tokenid;
+    return 1;
+}
+
+int cc_streamlexer_read(cc_streamlexer* lex, cc_token* out_tk)
+{
+    if (!cc_streamlexer_peek(lex, 0, out_tk))
+        return 0;
+    lex->ring_first = (lex->ring_first + 1) % lex->ring_cap;
+    --lex->num_ring;
+    return 1;
+}
+
 int cc_token_strcmp(const cc_token* tk, const cc_char* string)
 {
     size_t tk_len = cc_token_len(tk);
@@ -1,4 +1,5 @@
 #include <cc/lib.h>
+#include <wchar.h>
 
 char* cc_strclone_char(const char* str, size_t str_len, size_t* new_len)
 {
@@ -48,11 +49,8 @@ cc_arena* cc_arena_create(void)
 void cc_arena_resize(cc_arena** arena, size_t size, int default_value)
 {
     cc_arena* a = *arena;
-    if (size > a->capacity) {
-        size_t new_cap = sizeof(*a) + size;
-        a = realloc(a, new_cap);
-        a->capacity = new_cap;
-    }
+    if (size > a->capacity)
+        cc_arena_reserve(&a, size > a->capacity * 2 ? size : a->capacity * 2);
 
     size_t old_size = a->size;
     if (size > old_size)
@@ -62,6 +60,16 @@ void cc_arena_resize(cc_arena** arena, size_t size, int default_value)
     *arena = a;
 }
 
+void cc_arena_reserve(cc_arena** arena, size_t capacity)
+{
+    cc_arena* a = *arena;
+    if (capacity > a->capacity) {
+        a = (cc_arena*)realloc(a, sizeof(*a) + capacity);
+        a->capacity = capacity;
+    }
+    *arena = a;
+}
+
 void* cc_arena_alloc_align(cc_arena** arena, size_t size, size_t align)
 {
     cc_arena* a = *arena;
@@ -151,6 +159,19 @@ uint32_t cc_fnv1a_u32(uint32_t i) {
     bytes[0] = (i >> 24) & 0xFF;
     return cc_fnv1a_32(&i, sizeof(i));
 }
+uint64_t cc_fnv1a_64(const void* data, size_t size) {
+    return cc_fnv1a_64_append(0xcbf29ce484222325, data, size);
+}
+uint64_t cc_fnv1a_64_append(uint64_t hash, const void* data, size_t size)
+{
+    const uint64_t FNV_PRIME = 0x100000001b3;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= ((const uint8_t*)data)[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
 
 cc_staticstream* cc_staticstream_create(uint8_t* buffer, size_t size);
 void cc_staticstream_destroy(cc_stream* stream);
@@ -205,6 +226,7 @@ size_t cc_staticstream_write(cc_stream* self, const uint8_t* data, size_t size)
 cc_dynamicstream* cc_dynamicstream_create(void)
 {
     cc_dynamicstream* stream = (cc_dynamicstream*)malloc(sizeof(*stream));
+    memset(stream, 0, sizeof(*stream));
     stream->base.destroy = &cc_dynamicstream_destroy;
     stream->base.read = &cc_dynamicstream_read;
     stream->base.write = &cc_dynamicstream_write;
@@ -232,10 +254,11 @@ size_t cc_dynamicstream_write(cc_stream* self, const uint8_t* data, size_t size)
     size_t limit = s->size - s->writepos;
     if (size > limit)
     {
-        s->size += size;
+        s->size = s->writepos + size;
         if (s->size > s->cap)
         {
-            s->cap = s->size;
+            // Grow geometrically, so many small writes take linear time
+            s->cap = s->cap * 2 > s->size ? s->cap * 2 : s->size;
             s->buffer = (uint8_t*)realloc(s->buffer, s->cap);
         }
     }
@@ -324,7 +347,8 @@ void cc_hmap32_destroy(cc_hmap32* map)
 void cc_hmap32_clear(cc_hmap32* map)
 {
     uint8_t* flags = cc_hmap32_flags(map);
-    memset(flags, 0, map->cap_bucket * sizeof(flags[0]));
+    if (map->cap_bucket) // A new map has no buckets yet
+        memset(flags, 0, map->cap_bucket * sizeof(flags[0]));
     map->num_entries = 0;
 }
 
@@ -1,9 +1,41 @@
 #include <cc/lib.h>
 #include <cc/vm.h>
 #include <cc/bigint.h>
+#include <stddef.h>
 #include <string.h>
 #include <malloc.h>
 
+#if CC_VM_NATIVE
+    #include <cc/x86_gen.h>
+    #ifdef _WIN32
+        #include <windows.h>
+        #define CC__VM_NATIVE_CONV (&X86_CONV_WIN64_FASTCALL)
+    #else
+        #include <sys/mman.h>
+        #define CC__VM_NATIVE_CONV (&X86_CONV_SYSV64_CDECL)
+    #endif
+#endif
+
+// Threads for cc_vmprogram_link_many. Without them, objects are compiled one at a time.
+#ifdef _WIN32
+    #include <windows.h>
+    #define CC__VM_THREADS 1
+#elif defined(__unix__) || defined(__APPLE__)
+    #include <pthread.h>
+    #define CC__VM_THREADS 1
+#else
+    #define CC__VM_THREADS 0
+#endif
+
+#ifndef CC_VM_THREADED_DISPATCH
+    // "Labels as values" is a GCC extension, also supported by Clang
+    #if defined(__GNUC__) || defined(__clang__)
+        #define CC_VM_THREADED_DISPATCH 1
+    #else
+        #define CC_VM_THREADED_DISPATCH 0
+    #endif
+#endif
+
 void cc_vm_create(cc_vm* vm, size_t stack_size, const cc_vmprogram* program)
 {
     memset(vm, 0, sizeof(*vm));
@@ -17,357 +49,699 @@ void cc_vm_destroy(cc_vm* vm)
 {
     free(vm->stack);
     free(vm->scratch);
-    memset(vm, 0, sizeof(vm));
+    memset(vm, 0, sizeof(*vm));
 }
 
-void cc_vm_step(cc_vm* vm)
+/// @brief Array of every VM-private instruction's format, ordered by opcode
+static const cc_ir_ins_format cc_vm_ins_formats[CC_VMOPCODE__COUNT - CC_IR_OPCODE__COUNT] =
 {
-    if (!vm->ip)
-    {
-        vm->vmexception = CC_VMEXCEPTION_INVALID_IP;
-        return;
+//   mnemonic,      operands
+    {"const.i8",    {CC_IR_OPERAND_U32}},
+    {"const.i16",   {CC_IR_OPERAND_U32}},
+    {"const.i32",   {CC_IR_OPERAND_U32}},
+    {"iconst.i64",  {CC_IR_OPERAND_U32}},
+    {"uconst.i64",  {CC_IR_OPERAND_U32}},
+
+    {"loadl.i8",    {CC_IR_OPERAND_U32}},
+    {"loadl.i16",   {CC_IR_OPERAND_U32}},
+    {"loadl.i32",   {CC_IR_OPERAND_U32}},
+    {"loadl.i64",   {CC_IR_OPERAND_U32}},
+    {"load.i8",     {0}},
+    {"load.i16",    {0}},
+    {"load.i32",    {0}},
+    {"load.i64",    {0}},
+    {"store.i8",    {0}},
+    {"store.i16",   {0}},
+    {"store.i32",   {0}},
+    {"store.i64",   {0}},
+
+    {"add.i8",      {0}},
+    {"add.i16",     {0}},
+    {"add.i32",     {0}},
+    {"add.i64",     {0}},
+    {"sub.i8",      {0}},
+    {"sub.i16",     {0}},
+    {"sub.i32",     {0}},
+    {"sub.i64",     {0}},
+
+    {"mul.i8",      {0}},
+    {"mul.i16",     {0}},
+    {"mul.i32",     {0}},
+    {"mul.i64",     {0}},
+    {"div.i8",      {0}},
+    {"div.i16",     {0}},
+    {"div.i32",     {0}},
+    {"div.i64",     {0}},
+    {"udiv.i8",     {0}},
+    {"udiv.i16",    {0}},
+    {"udiv.i32",    {0}},
+    {"udiv.i64",    {0}},
+    {"mod.i8",      {0}},
+    {"mod.i16",     {0}},
+    {"mod.i32",     {0}},
+    {"mod.i64",     {0}},
+    {"umod.i8",     {0}},
+    {"umod.i16",    {0}},
+    {"umod.i32",    {0}},
+    {"umod.i64",    {0}},
+    {"neg.i8",      {0}},
+    {"neg.i16",     {0}},
+    {"neg.i32",     {0}},
+    {"neg.i64",     {0}},
+    {"not.i8",      {0}},
+    {"not.i16",     {0}},
+    {"not.i32",     {0}},
+    {"not.i64",     {0}},
+    {"and.i8",      {0}},
+    {"and.i16",     {0}},
+    {"and.i32",     {0}},
+    {"and.i64",     {0}},
+    {"or.i8",       {0}},
+    {"or.i16",      {0}},
+    {"or.i32",      {0}},
+    {"or.i64",      {0}},
+    {"xor.i8",      {0}},
+    {"xor.i16",     {0}},
+    {"xor.i32",     {0}},
+    {"xor.i64",     {0}},
+    {"lsh.i8",      {0}},
+    {"lsh.i16",     {0}},
+    {"lsh.i32",     {0}},
+    {"lsh.i64",     {0}},
+    {"rsh.i8",      {0}},
+    {"rsh.i16",     {0}},
+    {"rsh.i32",     {0}},
+    {"rsh.i64",     {0}},
+    {"zext.i8",     {0}},
+    {"zext.i16",    {0}},
+    {"zext.i32",    {0}},
+    {"zext.i64",    {0}},
+    {"sext.i8",     {0}},
+    {"sext.i16",    {0}},
+    {"sext.i32",    {0}},
+    {"sext.i64",    {0}},
+
+    {"jz.i8",       {CC_IR_OPERAND_U32}},
+    {"jz.i16",      {CC_IR_OPERAND_U32}},
+    {"jz.i32",      {CC_IR_OPERAND_U32}},
+    {"jz.i64",      {CC_IR_OPERAND_U32}},
+    {"jnz.i8",      {CC_IR_OPERAND_U32}},
+    {"jnz.i16",     {CC_IR_OPERAND_U32}},
+    {"jnz.i32",     {CC_IR_OPERAND_U32}},
+    {"jnz.i64",     {CC_IR_OPERAND_U32}},
+
+    {"addrl_load.i8",       {CC_IR_OPERAND_U32}},
+    {"addrl_load.i16",      {CC_IR_OPERAND_U32}},
+    {"addrl_load.i32",      {CC_IR_OPERAND_U32}},
+    {"addrl_load.i64",      {CC_IR_OPERAND_U32}},
+    {"addrl_store.i8",      {CC_IR_OPERAND_U32}},
+    {"addrl_store.i16",     {CC_IR_OPERAND_U32}},
+    {"addrl_store.i32",     {CC_IR_OPERAND_U32}},
+    {"addrl_store.i64",     {CC_IR_OPERAND_U32}},
+    {"dupe_addrl_store.i8", {0}},
+    {"dupe_addrl_store.i16",{0}},
+    {"dupe_addrl_store.i32",{0}},
+    {"dupe_addrl_store.i64",{0}},
+    {"loadl_const_add.i8",  {CC_IR_OPERAND_U32}},
+    {"loadl_const_add.i16", {CC_IR_OPERAND_U32}},
+    {"loadl_const_add.i32", {CC_IR_OPERAND_U32}},
+    {"loadl_const_add.i64", {CC_IR_OPERAND_U32}},
+    {"const_jz.i8",         {CC_IR_OPERAND_U32}},
+    {"const_jz.i16",        {CC_IR_OPERAND_U32}},
+    {"const_jz.i32",        {CC_IR_OPERAND_U32}},
+    {"const_jz.i64",        {CC_IR_OPERAND_U32}},
+    {"const_jnz.i8",        {CC_IR_OPERAND_U32}},
+    {"const_jnz.i16",       {CC_IR_OPERAND_U32}},
+    {"const_jnz.i32",       {CC_IR_OPERAND_U32}},
+    {"const_jnz.i64",       {CC_IR_OPERAND_U32}},
+
+    {"add_rr.i32",          {CC_IR_OPERAND_U32}},
+    {"add_rr.i64",          {CC_IR_OPERAND_U32}},
+    {"add_rk.i32",          {CC_IR_OPERAND_U32}},
+    {"add_rk.i64",          {CC_IR_OPERAND_U32}},
+    {"sub_rr.i32",          {CC_IR_OPERAND_U32}},
+    {"sub_rr.i64",          {CC_IR_OPERAND_U32}},
+    {"sub_rk.i32",          {CC_IR_OPERAND_U32}},
+    {"sub_rk.i64",          {CC_IR_OPERAND_U32}},
+    {"mul_rr.i32",          {CC_IR_OPERAND_U32}},
+    {"mul_rr.i64",          {CC_IR_OPERAND_U32}},
+    {"mul_rk.i32",          {CC_IR_OPERAND_U32}},
+    {"mul_rk.i64",          {CC_IR_OPERAND_U32}},
+    {"and_rr.i32",          {CC_IR_OPERAND_U32}},
+    {"and_rr.i64",          {CC_IR_OPERAND_U32}},
+    {"and_rk.i32",          {CC_IR_OPERAND_U32}},
+    {"and_rk.i64",          {CC_IR_OPERAND_U32}},
+    {"or_rr.i32",           {CC_IR_OPERAND_U32}},
+    {"or_rr.i64",           {CC_IR_OPERAND_U32}},
+    {"or_rk.i32",           {CC_IR_OPERAND_U32}},
+    {"or_rk.i64",           {CC_IR_OPERAND_U32}},
+    {"xor_rr.i32",          {CC_IR_OPERAND_U32}},
+    {"xor_rr.i64",          {CC_IR_OPERAND_U32}},
+    {"xor_rk.i32",          {CC_IR_OPERAND_U32}},
+    {"xor_rk.i64",          {CC_IR_OPERAND_U32}},
+    {"mov_r.i8",            {CC_IR_OPERAND_U32}},
+    {"mov_r.i16",           {CC_IR_OPERAND_U32}},
+    {"mov_r.i32",           {CC_IR_OPERAND_U32}},
+    {"mov_r.i64",           {CC_IR_OPERAND_U32}},
+    {"mov_k.i8",            {CC_IR_OPERAND_U32}},
+    {"mov_k.i16",           {CC_IR_OPERAND_U32}},
+    {"mov_k.i32",           {CC_IR_OPERAND_U32}},
+    {"mov_k.i64",           {CC_IR_OPERAND_U32}},
+    {"jz_r.i32",            {CC_IR_OPERAND_U32}},
+    {"jz_r.i64",            {CC_IR_OPERAND_U32}},
+    {"jnz_r.i32",           {CC_IR_OPERAND_U32}},
+    {"jnz_r.i64",           {CC_IR_OPERAND_U32}},
+    {"native",              {CC_IR_OPERAND_U32}},
+    {"count",               {CC_IR_OPERAND_U32}},
+};
+
+const cc_ir_ins_format* cc_vm_ins_format(uint8_t opcode)
+{
+    if (opcode < CC_IR_OPCODE__COUNT)
+        return &cc_ir_ins_formats[opcode];
+    if (opcode < CC_VMOPCODE__COUNT)
+        return &cc_vm_ins_formats[opcode - CC_IR_OPCODE__COUNT];
+    return NULL;
+}
+
+/*
+ * The interpreter loop is written once, using the CC__VM_* macros below.
+ *
+ * With CC_VM_THREADED_DISPATCH, every handler jumps directly to the next handler through a table of label addresses.
+ * Otherwise, every handler is a case in a portable switch statement.
+ */
+#if CC_VM_THREADED_DISPATCH
+    #define CC__VM_CASE(opcode) op_##opcode
+    #define CC__VM_VMCASE(opcode) op_VM_##opcode
+    #define CC__VM_INVALID op_invalid
+    #define CC__VM_NEXT() do {                                  \
+        if (steps == max_steps)                                 \
+            goto end;                                           \
+        ++steps;                                                \
+        ins = (const cc_ir_ins*)ip;                         \
+        ip += sizeof(*ins);                                 \
+        if (CC__VM_CHECKED && ins->opcode >= CC_VMOPCODE__COUNT) \
+            goto op_invalid;                                    \
+        goto *dispatch_table[ins->opcode];                      \
+    } while (0)
+    /// @brief Execute `ins` without decoding it from the IP
+    #define CC__VM_DISPATCH() goto *dispatch_table[ins->opcode]
+#else
+    #define CC__VM_CASE(opcode) case CC_IR_OPCODE_##opcode
+    #define CC__VM_VMCASE(opcode) case CC_VMOPCODE_##opcode
+    #define CC__VM_INVALID default
+    #define CC__VM_NEXT() continue
+    #define CC__VM_DISPATCH() goto dispatch
+#endif
+/// @brief Stop execution. The exception (if any) must already be written.
+#define CC__VM_STOP() goto end
+/// @brief Write an exception and stop execution
+#define CC__VM_RAISE(exception) do { vm->vmexception = (exception); goto end; } while (0)
+/// @brief Push `num_bytes` and assign the new SP to `dst`
+#define CC__VM_PUSH(dst, num_bytes) do {                        \
+        if (CC__VM_CHECKED && (size_t)(sp - stack_begin) < (num_bytes)) \
+            CC__VM_RAISE(CC_VMEXCEPTION_INVALID_SP);            \
+        (dst) = (void*)(sp -= (num_bytes));                     \
+    } while (0)
+/// @brief Pop `num_bytes` and assign the old SP to `dst`
+#define CC__VM_POP(dst, num_bytes) do {                         \
+        if (CC__VM_CHECKED && (size_t)(stack_end - sp) < (num_bytes)) \
+            CC__VM_RAISE(CC_VMEXCEPTION_INVALID_SP);            \
+        (dst) = (void*)sp;                                      \
+        sp += (num_bytes);                                      \
+    } while (0)
+/// @brief Require `num_bytes` on the stack, to be modified in-place
+#define CC__VM_PEEK(num_bytes) do {                             \
+        if (CC__VM_CHECKED && (size_t)(stack_end - sp) < (num_bytes)) \
+            CC__VM_RAISE(CC_VMEXCEPTION_INVALID_SP);            \
+    } while (0)
+
+/// @brief Pop `var` from the stack
+#define CC__VM_POP_VALUE(var) do {                              \
+        const uint8_t* _src;                                    \
+        CC__VM_POP(_src, sizeof(var));                          \
+        memcpy(&(var), _src, sizeof(var));                      \
+    } while (0)
+/// @brief Push `var` to the stack
+#define CC__VM_PUSH_VALUE(var) do {                             \
+        uint8_t* _dst;                                          \
+        CC__VM_PUSH(_dst, sizeof(var));                         \
+        memcpy(_dst, &(var), sizeof(var));                      \
+    } while (0)
+
+// Handlers for width-specialized opcodes.
+// Operands are copied with a constant-size `memcpy`, because the stack has no alignment.
+// `TYPE` is the unsigned integer type of the operation, and `STYPE` is the signed type.
+
+/// @brief Emit `MACRO` for the 1, 2, 4, and 8-byte variants of a VM opcode
+#define CC__VM_WIDTHS(MACRO, NAME)          \
+    MACRO(NAME##_I8, uint8_t, int8_t)       \
+    MACRO(NAME##_I16, uint16_t, int16_t)    \
+    MACRO(NAME##_I32, uint32_t, int32_t)    \
+    MACRO(NAME##_I64, uint64_t, int64_t)
+/// @brief Push `u32`, converted to `TYPE` through `CONVERT_TYPE`
+#define CC__VM_CONST(NAME, TYPE, CONVERT_TYPE)                  \
+    CC__VM_VMCASE(NAME):                                        \
+    {                                                           \
+        TYPE value = (TYPE)(CONVERT_TYPE)ins->operand.u32;      \
+        CC__VM_PUSH_VALUE(value);                               \
+        CC__VM_NEXT();                                          \
     }
-    
-    if (vm->sp < vm->stack || vm->sp > vm->stack + vm->stack_size)
-    {
-        vm->vmexception = CC_VMEXCEPTION_INVALID_SP;
-        return;
+#define CC__VM_LOADL(NAME, TYPE, STYPE)                         \
+    CC__VM_VMCASE(NAME):                                        \
+    {                                                           \
+        TYPE value;                                             \
+        memcpy(&value, vm->frame_pointer + ins->operand.u32, sizeof(value)); \
+        CC__VM_PUSH_VALUE(value);                               \
+        CC__VM_NEXT();                                          \
     }
-
-    // Decode instruction
-    const cc_ir_ins* ins = (const cc_ir_ins*)vm->ip;
-    // Increment IP
-    vm->ip += sizeof(*ins);
-    
-    // Execute...
-    switch (ins->opcode)
-    {
-    case CC_IR_OPCODE_ARGP:
-    {
-        void** dst = (void**)cc__vm_push(vm, sizeof(void*));
-        if (!dst)
-            return;
-        *dst = vm->args_pointer;
-        break;
+#define CC__VM_LOAD(NAME, TYPE, STYPE)                          \
+    CC__VM_VMCASE(NAME):                                        \
+    {                                                           \
+        const void* src;                                        \
+        TYPE value;                                             \
+        CC__VM_POP_VALUE(src);                                  \
+        memcpy(&value, src, sizeof(value));                     \
+        CC__VM_PUSH_VALUE(value);                               \
+        CC__VM_NEXT();                                          \
     }
-    // Special VM format: u32 is the frame pointer offset
-    case CC_IR_OPCODE_ADDRL:
-    {
-        // Push local's address
-        void** ptr_on_stack = (void*)cc__vm_push(vm, sizeof(*ptr_on_stack));
-        if (!ptr_on_stack)
-            return;
-
-        *ptr_on_stack = vm->frame_pointer + ins->operand.u32;
-        break;
+#define CC__VM_STORE(NAME, TYPE, STYPE)                         \
+    CC__VM_VMCASE(NAME):                                        \
+    {                                                           \
+        void* dst;                                              \
+        TYPE value;                                             \
+        CC__VM_POP_VALUE(dst);                                  \
+        CC__VM_POP_VALUE(value);                                \
+        memcpy(dst, &value, sizeof(value));                     \
+        CC__VM_NEXT();                                          \
     }
-    // This is replaced with UCONST at compile-time
-    //case CC_IR_OPCODE_SIZEL:
-    //    break;
-    // Special VM format: u32 is the frame pointer offset, data_size is the size
-    case CC_IR_OPCODE_LOADL:
-    {
-        const void* src = vm->frame_pointer + ins->operand.u32;
-        void* dst = cc__vm_push(vm, ins->data_size);
-        if (!dst)
-            return;
-        memcpy(dst, src, ins->data_size);
-        break;
+/// @brief Pop `value`, then push `EXPR(value)`
+#define CC__VM_UNARY(NAME, TYPE, EXPR)                          \
+    CC__VM_VMCASE(NAME):                                        \
+    {                                                           \
+        TYPE value;                                             \
+        CC__VM_POP_VALUE(value);                                \
+        value = (TYPE)(EXPR);                                   \
+        CC__VM_PUSH_VALUE(value);                               \
+        CC__VM_NEXT();                                          \
     }
-    case CC_IR_OPCODE_ADDRG:
-    {
-        if (ins->operand.symbolid >= vm->vmprogram->num_symbols)
-        {
-            vm->vmexception = CC_VMEXCEPTION_INVALID_SYMBOLID;
-            return;
-        }
-
-        void* address_of_symbol = vm->vmprogram->symbols[ins->operand.symbolid].ptr;
-        void** ptr_on_stack = (void**)cc__vm_push(vm, sizeof(*ptr_on_stack));
-        if (!ptr_on_stack)
-            return;
-        *ptr_on_stack = address_of_symbol;
-        break;
+/// @brief Pop `lhs` and `rhs`, then push `EXPR(lhs, rhs)`
+#define CC__VM_BINARY(NAME, TYPE, EXPR)                         \
+    CC__VM_VMCASE(NAME):                                        \
+    {                                                           \
+        TYPE lhs, rhs;                                          \
+        CC__VM_POP_VALUE(lhs);                                  \
+        CC__VM_POP_VALUE(rhs);                                  \
+        lhs = (TYPE)(EXPR);                                     \
+        CC__VM_PUSH_VALUE(lhs);                                 \
+        CC__VM_NEXT();                                          \
     }
-    case CC_IR_OPCODE_SIZEP:
-    {
-        void* dst = cc__vm_push(vm, ins->data_size);
-        if (!dst)
-            return;
-        cc_bigint_u32(ins->data_size, dst, sizeof(void*));
-        break;
+/// @brief Pop `lhs` and `rhs`, then push the `lhs` computed by `STATEMENT` unless `rhs` is zero
+#define CC__VM_DIVIDE_BY(NAME, TYPE, STATEMENT)                 \
+    CC__VM_VMCASE(NAME):                                        \
+    {                                                           \
+        TYPE lhs, rhs;                                          \
+        CC__VM_POP_VALUE(lhs);                                  \
+        CC__VM_POP_VALUE(rhs);                                  \
+        if (rhs == 0)                                           \
+        {                                                       \
+            /* Restore the operands. `rhs` is still in memory. */ \
+            sp -= sizeof(lhs) * 2;                          \
+            memcpy(sp, &lhs, sizeof(lhs));                  \
+            CC__VM_RAISE(CC_VMEXCEPTION_DIVIDE_BY_ZERO);        \
+        }                                                       \
+        STATEMENT;                                              \
+        CC__VM_PUSH_VALUE(lhs);                                 \
+        CC__VM_NEXT();                                          \
     }
-    case CC_IR_OPCODE_ICONST:
-    case CC_IR_OPCODE_UCONST:
-    {   
-        uint8_t* write_ptr = cc__vm_push(vm, ins->data_size);
-        if (!write_ptr)
-            return;
-
-        if (ins->opcode == CC_IR_OPCODE_ICONST)
-            cc_bigint_i32(ins->data_size, write_ptr, (int32_t)ins->operand.u32);
-        else
-            cc_bigint_u32(ins->data_size, write_ptr, ins->operand.u32);
-        break;
+/// @brief Pop unsigned `lhs` and `rhs`, then push `EXPR(lhs, rhs)` unless `rhs` is zero
+#define CC__VM_DIVIDE(NAME, TYPE, EXPR) CC__VM_DIVIDE_BY(NAME, TYPE, lhs = (TYPE)(EXPR))
+/**
+ * @brief Pop signed `lhs` and `rhs`, then push `EXPR(lhs, rhs)` unless `rhs` is zero
+ * 
+ * Division of the minimum signed value by `-1` would trap on some hosts,
+ * so `OVERFLOW_EXPR(lhs)` is pushed instead.
+ */
+#define CC__VM_SDIVIDE(NAME, TYPE, EXPR, OVERFLOW_EXPR) \
+    CC__VM_DIVIDE_BY(NAME, TYPE, lhs = rhs == (TYPE)-1 ? (TYPE)(OVERFLOW_EXPR) : (TYPE)(EXPR))
+#define CC__VM_ADD(NAME, TYPE, STYPE) CC__VM_BINARY(NAME, TYPE, lhs + rhs)
+#define CC__VM_SUB(NAME, TYPE, STYPE) CC__VM_BINARY(NAME, TYPE, lhs - rhs)
+// The low bits of a product are the same for signed and unsigned multiplication
+#define CC__VM_MUL(NAME, TYPE, STYPE) CC__VM_BINARY(NAME, TYPE, lhs * rhs)
+#define CC__VM_DIV(NAME, TYPE, STYPE) CC__VM_SDIVIDE(NAME, STYPE, lhs / rhs, (TYPE)0 - (TYPE)lhs)
+#define CC__VM_UDIV(NAME, TYPE, STYPE) CC__VM_DIVIDE(NAME, TYPE, lhs / rhs)
+#define CC__VM_MOD(NAME, TYPE, STYPE) CC__VM_SDIVIDE(NAME, STYPE, lhs % rhs, 0)
+#define CC__VM_UMOD(NAME, TYPE, STYPE) CC__VM_DIVIDE(NAME, TYPE, lhs % rhs)
+#define CC__VM_NEG(NAME, TYPE, STYPE) CC__VM_UNARY(NAME, TYPE, (TYPE)0 - value)
+#define CC__VM_NOT(NAME, TYPE, STYPE) CC__VM_UNARY(NAME, TYPE, ~value)
+#define CC__VM_AND(NAME, TYPE, STYPE) CC__VM_BINARY(NAME, TYPE, lhs & rhs)
+#define CC__VM_OR(NAME, TYPE, STYPE) CC__VM_BINARY(NAME, TYPE, lhs | rhs)
+#define CC__VM_XOR(NAME, TYPE, STYPE) CC__VM_BINARY(NAME, TYPE, lhs ^ rhs)
+// Shifting by the operand's width or more will clear all bits, like the bigint implementation
+#define CC__VM_LSH(NAME, TYPE, STYPE) CC__VM_BINARY(NAME, TYPE, rhs < sizeof(TYPE) * 8 ? lhs << rhs : 0)
+#define CC__VM_RSH(NAME, TYPE, STYPE) CC__VM_BINARY(NAME, TYPE, rhs < sizeof(TYPE) * 8 ? lhs >> rhs : 0)
+/// @brief Pop a value, then push it extended (or truncated) to a 1, 2, 4, or 8-byte `extend_data_size`
+#define CC__VM_EXTEND(NAME, TYPE, EXTEND_TYPE)                  \
+    CC__VM_VMCASE(NAME):                                        \
+    {                                                           \
+        TYPE value;                                             \
+        uint8_t* dst;                                           \
+        CC__VM_POP_VALUE(value);                                \
+        CC__VM_PUSH(dst, ins->operand.extend_data_size);        \
+        cc__vm_write_native(dst, ins->operand.extend_data_size, (uint64_t)(EXTEND_TYPE)value); \
+        CC__VM_NEXT();                                          \
     }
-    case CC_IR_OPCODE_LOAD:
-    {
-        // Pop the source pointer
-        void** src_ptr_on_stack = (void**)cc__vm_pop(vm, sizeof(void*));
-        if (!src_ptr_on_stack)
-            return;
-        const void* src_ptr = *src_ptr_on_stack;
-
-        // Push the source data onto the stack
-        void* dst_ptr = cc__vm_push(vm, ins->data_size);
-        if (!dst_ptr)
-            return;
-        
-        memcpy(dst_ptr, src_ptr, ins->data_size);
-        break;
+#define CC__VM_ZEXT(NAME, TYPE, STYPE) CC__VM_EXTEND(NAME, TYPE, uint64_t)
+#define CC__VM_SEXT(NAME, TYPE, STYPE) CC__VM_EXTEND(NAME, STYPE, int64_t)
+/// @brief Pop a value, then jump if `(value == 0) == IS_ZERO`
+#define CC__VM_JUMP(NAME, TYPE, IS_ZERO)                        \
+    CC__VM_VMCASE(NAME):                                        \
+    {                                                           \
+        TYPE value;                                             \
+        CC__VM_POP_VALUE(value);                                \
+        if ((value == 0) == IS_ZERO)                            \
+            ip += (int32_t)ins->operand.u32;                \
+        CC__VM_NEXT();                                          \
     }
-    case CC_IR_OPCODE_STORE:
-    {
-        // Pop the destination pointer
-        void** dst_ptr_on_stack = (void**)cc__vm_pop(vm, sizeof(void*));
-        if (!dst_ptr_on_stack)
-            return;
-        void* dst_ptr = *dst_ptr_on_stack;
-
-        // Pop value
-        const void* src_ptr = cc__vm_pop(vm, ins->data_size);
-        if (!src_ptr)
-            return;
-
-        // Store the popped data at the destination
-        memcpy(dst_ptr, src_ptr, ins->data_size);
-        break;
+#define CC__VM_JZ(NAME, TYPE, STYPE) CC__VM_JUMP(NAME, TYPE, true)
+#define CC__VM_JNZ(NAME, TYPE, STYPE) CC__VM_JUMP(NAME, TYPE, false)
+
+// Handlers for superinstructions.
+// The instructions after the first are skipped, and `next` points at the second one.
+
+/**
+ * @brief Skip the rest of a superinstruction of `LENGTH` instructions, counting one step for each.
+ * 
+ * If the steps would exceed `max_steps`, only the first instruction is executed.
+ */
+#define CC__VM_FUSED(LENGTH)                                    \
+    if (max_steps - steps < (LENGTH) - 1)                       \
+    {                                                           \
+        unfused = *ins;                                         \
+        unfused.opcode = cc__vm_unfuse(ins->opcode, NULL);      \
+        ins = &unfused;                                         \
+        CC__VM_DISPATCH();                                      \
+    }                                                           \
+    const cc_ir_ins* next = (const cc_ir_ins*)ip;               \
+    (void)next;                                                 \
+    steps += (LENGTH) - 1;                                      \
+    ip += ((LENGTH) - 1) * sizeof(*ins)
+#define CC__VM_ADDRL_LOAD(NAME, TYPE, STYPE)                    \
+    CC__VM_VMCASE(NAME):                                        \
+    {                                                           \
+        CC__VM_FUSED(2);                                        \
+        TYPE value;                                             \
+        memcpy(&value, vm->frame_pointer + ins->operand.u32, sizeof(value)); \
+        CC__VM_PUSH_VALUE(value);                               \
+        CC__VM_NEXT();                                          \
     }
-    case CC_IR_OPCODE_DUPE:
-    {
-        const void* src = cc__vm_pop(vm, ins->data_size);
-        if (!src)
-            return;
-            
-        cc__vm_push(vm, ins->data_size);
-        void* dst = cc__vm_push(vm, ins->data_size);
-        if (!dst)
-            return;
-
-        memcpy(dst, src, ins->data_size);
-        break;
+#define CC__VM_ADDRL_STORE(NAME, TYPE, STYPE)                   \
+    CC__VM_VMCASE(NAME):                                        \
+    {                                                           \
+        CC__VM_FUSED(2);                                        \
+        TYPE value;                                             \
+        CC__VM_POP_VALUE(value);                                \
+        memcpy(vm->frame_pointer + ins->operand.u32, &value, sizeof(value)); \
+        CC__VM_NEXT();                                          \
     }
-    case CC_IR_OPCODE_FREE:
-    {
-        if (!cc__vm_pop(vm, ins->data_size))
-            return;
-        break;
+#define CC__VM_DUPE_ADDRL_STORE(NAME, TYPE, STYPE)              \
+    CC__VM_VMCASE(NAME):                                        \
+    {                                                           \
+        CC__VM_FUSED(3);                                        \
+        CC__VM_PEEK(sizeof(TYPE));                              \
+        memcpy(vm->frame_pointer + next->operand.u32, sp, sizeof(TYPE)); \
+        CC__VM_NEXT();                                          \
     }
-
-    // === Unary operations ===
-
-    case CC_IR_OPCODE_NEG:
-    case CC_IR_OPCODE_NOT:
-    {
-        uint8_t* lhs = cc__vm_pop(vm, ins->data_size);
-        if (!lhs)
-            return;
-        switch (ins->opcode)
-        {
-        case CC_IR_OPCODE_NEG: cc_bigint_neg(ins->data_size, lhs); break;
-        case CC_IR_OPCODE_NOT: cc_bigint_not(ins->data_size, lhs); break;
-        }
-        cc__vm_push(vm, ins->data_size);
-        break;
+#define CC__VM_LOADL_CONST_ADD(NAME, TYPE, STYPE)               \
+    CC__VM_VMCASE(NAME):                                        \
+    {                                                           \
+        CC__VM_FUSED(3);                                        \
+        TYPE value;                                             \
+        memcpy(&value, vm->frame_pointer + ins->operand.u32, sizeof(value)); \
+        value = (TYPE)(value + (TYPE)next->operand.u32);        \
+        CC__VM_PUSH_VALUE(value);                               \
+        CC__VM_NEXT();                                          \
     }
-    case CC_IR_OPCODE_ZEXT:
-    case CC_IR_OPCODE_SEXT:
-    {
-        uint8_t* src = cc__vm_pop(vm, ins->data_size);
-        if (!src)
-            return;
-        uint8_t* dst = cc__vm_push(vm, ins->operand.extend_data_size);
-        if (!dst)
-            return;
-
-        if (ins->opcode == CC_IR_OPCODE_ZEXT)
-            cc_bigint_extend_zero(ins->operand.extend_data_size, dst, ins->data_size, src);
-        else
-            cc_bigint_extend_sign(ins->operand.extend_data_size, dst, ins->data_size, src);
-        break;
+/// @brief Jump by the second instruction's offset if `(u32 == 0) == IS_ZERO`
+#define CC__VM_CONST_JUMP(NAME, TYPE, IS_ZERO)                  \
+    CC__VM_VMCASE(NAME):                                        \
+    {                                                           \
+        CC__VM_FUSED(2);                                        \
+        if (((TYPE)ins->operand.u32 == 0) == IS_ZERO)           \
+            ip += (int32_t)next->operand.u32;                   \
+        CC__VM_NEXT();                                          \
     }
+#define CC__VM_CONST_JZ(NAME, TYPE, STYPE) CC__VM_CONST_JUMP(NAME, TYPE, true)
+#define CC__VM_CONST_JNZ(NAME, TYPE, STYPE) CC__VM_CONST_JUMP(NAME, TYPE, false)
+
+// Handlers for three-address instructions.
+// Locals are frame pointer offsets in the `u32` of the replaced LOADL and ADDRL instructions.
+
+/// @brief Emit `MACRO` for the 4 and 8-byte variants of a VM opcode
+#define CC__VM_WIDE_WIDTHS(MACRO, NAME)     \
+    MACRO(NAME##_I32, uint32_t, int32_t)    \
+    MACRO(NAME##_I64, uint64_t, int64_t)
+/// @brief `LOADL b; LOADL a; OP; ADDRL c; STORE`, where `OP` is `EXPR(lhs, rhs)`
+#define CC__VM_BINARY_RR(NAME, TYPE, EXPR)                      \
+    CC__VM_VMCASE(NAME):                                        \
+    {                                                           \
+        CC__VM_FUSED(5);                                        \
+        TYPE lhs, rhs;                                          \
+        memcpy(&rhs, vm->frame_pointer + ins->operand.u32, sizeof(rhs)); \
+        memcpy(&lhs, vm->frame_pointer + next[0].operand.u32, sizeof(lhs)); \
+        lhs = (TYPE)(EXPR);                                     \
+        memcpy(vm->frame_pointer + next[2].operand.u32, &lhs, sizeof(lhs)); \
+        CC__VM_NEXT();                                          \
+    }
+/// @brief `CONST k; LOADL a; OP; ADDRL c; STORE`, where `OP` is `EXPR(lhs, rhs)`
+#define CC__VM_BINARY_RK(NAME, TYPE, EXPR)                      \
+    CC__VM_VMCASE(NAME):                                        \
+    {                                                           \
+        CC__VM_FUSED(5);                                        \
+        TYPE lhs, rhs = (TYPE)ins->operand.u32;                 \
+        memcpy(&lhs, vm->frame_pointer + next[0].operand.u32, sizeof(lhs)); \
+        lhs = (TYPE)(EXPR);                                     \
+        memcpy(vm->frame_pointer + next[2].operand.u32, &lhs, sizeof(lhs)); \
+        CC__VM_NEXT();                                          \
+    }
+#define CC__VM_ADD_RR(NAME, TYPE, STYPE) CC__VM_BINARY_RR(NAME, TYPE, lhs + rhs)
+#define CC__VM_ADD_RK(NAME, TYPE, STYPE) CC__VM_BINARY_RK(NAME, TYPE, lhs + rhs)
+#define CC__VM_SUB_RR(NAME, TYPE, STYPE) CC__VM_BINARY_RR(NAME, TYPE, lhs - rhs)
+#define CC__VM_SUB_RK(NAME, TYPE, STYPE) CC__VM_BINARY_RK(NAME, TYPE, lhs - rhs)
+#define CC__VM_MUL_RR(NAME, TYPE, STYPE) CC__VM_BINARY_RR(NAME, TYPE, lhs * rhs)
+#define CC__VM_MUL_RK(NAME, TYPE, STYPE) CC__VM_BINARY_RK(NAME, TYPE, lhs * rhs)
+#define CC__VM_AND_RR(NAME, TYPE, STYPE) CC__VM_BINARY_RR(NAME, TYPE, lhs & rhs)
+#define CC__VM_AND_RK(NAME, TYPE, STYPE) CC__VM_BINARY_RK(NAME, TYPE, lhs & rhs)
+#define CC__VM_OR_RR(NAME, TYPE, STYPE) CC__VM_BINARY_RR(NAME, TYPE, lhs | rhs)
+#define CC__VM_OR_RK(NAME, TYPE, STYPE) CC__VM_BINARY_RK(NAME, TYPE, lhs | rhs)
+#define CC__VM_XOR_RR(NAME, TYPE, STYPE) CC__VM_BINARY_RR(NAME, TYPE, lhs ^ rhs)
+#define CC__VM_XOR_RK(NAME, TYPE, STYPE) CC__VM_BINARY_RK(NAME, TYPE, lhs ^ rhs)
+/// @brief `LOADL a; ADDRL c; STORE`
+#define CC__VM_MOV_R(NAME, TYPE, STYPE)                         \
+    CC__VM_VMCASE(NAME):                                        \
+    {                                                           \
+        CC__VM_FUSED(3);                                        \
+        TYPE value;                                             \
+        memcpy(&value, vm->frame_pointer + ins->operand.u32, sizeof(value)); \
+        memcpy(vm->frame_pointer + next[0].operand.u32, &value, sizeof(value)); \
+        CC__VM_NEXT();                                          \
+    }
+/// @brief `CONST k; ADDRL c; STORE`
+#define CC__VM_MOV_K(NAME, TYPE, STYPE)                         \
+    CC__VM_VMCASE(NAME):                                        \
+    {                                                           \
+        CC__VM_FUSED(3);                                        \
+        TYPE value = (TYPE)ins->operand.u32;                    \
+        memcpy(vm->frame_pointer + next[0].operand.u32, &value, sizeof(value)); \
+        CC__VM_NEXT();                                          \
+    }
+/// @brief `LOADL a; JZ` or `LOADL a; JNZ`
+#define CC__VM_JUMP_R(NAME, TYPE, IS_ZERO)                      \
+    CC__VM_VMCASE(NAME):                                        \
+    {                                                           \
+        CC__VM_FUSED(2);                                        \
+        TYPE value;                                             \
+        memcpy(&value, vm->frame_pointer + ins->operand.u32, sizeof(value)); \
+        if ((value == 0) == IS_ZERO)                            \
+            ip += (int32_t)next->operand.u32;                   \
+        CC__VM_NEXT();                                          \
+    }
+#define CC__VM_JZ_R(NAME, TYPE, STYPE) CC__VM_JUMP_R(NAME, TYPE, true)
+#define CC__VM_JNZ_R(NAME, TYPE, STYPE) CC__VM_JUMP_R(NAME, TYPE, false)
 
-
-    // === Binary operations ===
-
-    case CC_IR_OPCODE_ADD:
-    case CC_IR_OPCODE_SUB:
-    case CC_IR_OPCODE_UMUL:
-    case CC_IR_OPCODE_UDIV:
-    case CC_IR_OPCODE_UMOD:
-    case CC_IR_OPCODE_AND:
-    case CC_IR_OPCODE_OR:
-    case CC_IR_OPCODE_XOR:
-    case CC_IR_OPCODE_LSH:
-    case CC_IR_OPCODE_RSH:
+/// @brief Write the low bytes of `value` as a native integer of `size` bytes
+static inline void cc__vm_write_native(uint8_t* dst, size_t size, uint64_t value)
+{
+    switch (size)
     {
-        uint32_t* lhs = (uint32_t*)cc__vm_pop(vm, ins->data_size);
-        uint32_t* rhs = (uint32_t*)cc__vm_pop(vm, ins->data_size);
-        if (!lhs || !rhs)
-            return;
-
-        const void* result_ptr = lhs;
-        
-        switch (ins->opcode)
-        {
-        case CC_IR_OPCODE_ADD: cc_bigint_add(ins->data_size, lhs, rhs); break;
-        case CC_IR_OPCODE_SUB: cc_bigint_sub(ins->data_size, lhs, rhs); break;
-        case CC_IR_OPCODE_MUL: cc_bigint_mul(ins->data_size, lhs, rhs); break;
-        case CC_IR_OPCODE_UMUL: cc_bigint_umul(ins->data_size, lhs, rhs); break;
-        case CC_IR_OPCODE_DIV:
-        case CC_IR_OPCODE_UDIV:
-        case CC_IR_OPCODE_MOD:
-        case CC_IR_OPCODE_UMOD:
-        {
-            uint8_t _stack_quotient[8], _stack_remainder[8];
-            void* quotient = _stack_quotient, * remainder = _stack_remainder;
-
-            // Allocate scratch space for the quotient and remainder if required
-            if (ins->data_size > sizeof(_stack_quotient))
-            {
-                size_t required_scratch = ins->data_size * 2;
-                if (required_scratch > vm->scratch_size)
-                {
-                    vm->scratch_size = required_scratch;
-                    vm->scratch = (uint8_t*)realloc(vm->scratch, required_scratch);
-                }
-                quotient = vm->scratch;
-                remainder = vm->scratch + ins->data_size;
-            }
-
-            // Signed operation
-            if (ins->opcode == CC_IR_OPCODE_DIV || ins->opcode == CC_IR_OPCODE_MOD)
-                cc_bigint_div(ins->data_size, lhs, rhs, quotient, remainder);
-            else // Unsigned operation
-                cc_bigint_udiv(ins->data_size, lhs, rhs, quotient, remainder);
-
-            // Point the result to our quotient or remainder
-            result_ptr = quotient;
-            if (ins->opcode == CC_IR_OPCODE_UMOD)
-                result_ptr = remainder;
-            break;
-        }
-
-        case CC_IR_OPCODE_AND:  cc_bigint_and(ins->data_size, lhs, rhs); break;
-        case CC_IR_OPCODE_OR:   cc_bigint_or(ins->data_size, lhs, rhs); break;
-        case CC_IR_OPCODE_XOR:  cc_bigint_xor(ins->data_size, lhs, rhs); break;
-        case CC_IR_OPCODE_LSH:  cc_bigint_lsh(ins->data_size, lhs, rhs); break;
-        case CC_IR_OPCODE_RSH:  cc_bigint_rsh(ins->data_size, lhs, rhs); break;
-        }
-
-        void* dst = cc__vm_push(vm, ins->data_size);
-        if (!dst)
-            return;
-        memcpy(dst, result_ptr, ins->data_size);
-        break;
+    case 1: { uint8_t v = (uint8_t)value; memcpy(dst, &v, sizeof(v)); break; }
+    case 2: { uint16_t v = (uint16_t)value; memcpy(dst, &v, sizeof(v)); break; }
+    case 4: { uint32_t v = (uint32_t)value; memcpy(dst, &v, sizeof(v)); break; }
+    case 8: memcpy(dst, &value, sizeof(value)); break;
     }
+}
 
-    // TODO: Implement
-    //case CC_IR_OPCODE_JMP:
-    //{
-    //    break;
-    //}
-    // Special VM format: blockid is the signed byte-offset to the block
-    case CC_IR_OPCODE_JZ:
-    case CC_IR_OPCODE_JNZ:
+/// @brief Check if every byte of an integer is zero
+static inline bool cc__vm_is_zero(size_t size, const void* src)
+{
+    for (size_t i = 0; i < size; ++i)
     {
-        // Check condition
-        bool condition = true;
-        if (ins->opcode == CC_IR_OPCODE_JZ || ins->opcode == CC_IR_OPCODE_JNZ)
-        {
-            uint8_t* popped = cc__vm_pop(vm, ins->data_size);
-            if (!popped)
-                return;
-
-            bool is_zero = true;
-            for (cc_ir_datasize i = 0; i < ins->data_size; ++i)
-            {
-                if (popped[i])
-                {
-                    is_zero = false;
-                    break;
-                }
-            }
-            
-            condition = is_zero == (ins->opcode == CC_IR_OPCODE_JZ);
-        }
-        
-        if (condition)
-            vm->ip += (int16_t)ins->operand.blockid;
-        break;
+        if (((const uint8_t*)src)[i])
+            return false;
     }
-    case CC_IR_OPCODE_CALL:
-    {
-        uint8_t** target_on_stack = (uint8_t**)cc__vm_pop(vm, sizeof(void*));
-        if (!target_on_stack)
-            return;
-        
-        uint8_t* new_ip = *target_on_stack;
-        uint8_t* new_args_pointer = vm->sp;
+    return true;
+}
 
-        uint8_t** old_ip;
-        uint8_t** old_fp;
-        uint8_t** old_ap;
-        
-        if (   !(old_ip = (uint8_t**)cc__vm_push(vm, sizeof(*old_ip)))
-            || !(old_fp = (uint8_t**)cc__vm_push(vm, sizeof(*old_fp)))
-            || !(old_ap = (uint8_t**)cc__vm_push(vm, sizeof(*old_ap)))
-        ) {
-            return;
-        }
+// Instantiate the interpreter: Once with SP checks on every push and pop, and once for verified programs
+#define CC__VM_RUN cc_vm_run
+#define CC__VM_CHECKED 1
+#include "vm_run.h"
+/// @brief Execute a verified program. SP checks are only done at CALL, RET, and FRAME.
+static size_t cc__vm_run_unchecked(cc_vm* vm, size_t max_steps);
+#define CC__VM_RUN cc__vm_run_unchecked
+#define CC__VM_CHECKED 0
+#include "vm_run.h"
+
+size_t cc_vm_run_trusted(cc_vm* vm, size_t max_steps)
+{
+    if (!vm->vmprogram->is_verified)
+        return cc_vm_run(vm, max_steps);
+    return cc__vm_run_unchecked(vm, max_steps);
+}
 
-        *old_ip = vm->ip;
-        *old_fp = vm->frame_pointer;
-        *old_ap = vm->args_pointer;
+#undef CC__VM_CASE
+#undef CC__VM_VMCASE
+#undef CC__VM_INVALID
+#undef CC__VM_NEXT
+#undef CC__VM_DISPATCH
+#undef CC__VM_STOP
+#undef CC__VM_RAISE
+#undef CC__VM_PUSH
+#undef CC__VM_POP
+#undef CC__VM_PEEK
+#undef CC__VM_POP_VALUE
+#undef CC__VM_PUSH_VALUE
+#undef CC__VM_WIDTHS
+#undef CC__VM_CONST
+#undef CC__VM_LOADL
+#undef CC__VM_LOAD
+#undef CC__VM_STORE
+#undef CC__VM_UNARY
+#undef CC__VM_BINARY
+#undef CC__VM_DIVIDE_BY
+#undef CC__VM_DIVIDE
+#undef CC__VM_SDIVIDE
+#undef CC__VM_ADD
+#undef CC__VM_SUB
+#undef CC__VM_MUL
+#undef CC__VM_DIV
+#undef CC__VM_UDIV
+#undef CC__VM_MOD
+#undef CC__VM_UMOD
+#undef CC__VM_NEG
+#undef CC__VM_NOT
+#undef CC__VM_AND
+#undef CC__VM_OR
+#undef CC__VM_XOR
+#undef CC__VM_LSH
+#undef CC__VM_RSH
+#undef CC__VM_ZEXT
+#undef CC__VM_SEXT
+#undef CC__VM_EXTEND
+#undef CC__VM_JUMP
+#undef CC__VM_JZ
+#undef CC__VM_JNZ
+#undef CC__VM_FUSED
+#undef CC__VM_ADDRL_LOAD
+#undef CC__VM_ADDRL_STORE
+#undef CC__VM_DUPE_ADDRL_STORE
+#undef CC__VM_LOADL_CONST_ADD
+#undef CC__VM_CONST_JUMP
+#undef CC__VM_CONST_JZ
+#undef CC__VM_CONST_JNZ
+#undef CC__VM_WIDE_WIDTHS
+#undef CC__VM_BINARY_RR
+#undef CC__VM_BINARY_RK
+#undef CC__VM_ADD_RR
+#undef CC__VM_ADD_RK
+#undef CC__VM_SUB_RR
+#undef CC__VM_SUB_RK
+#undef CC__VM_MUL_RR
+#undef CC__VM_MUL_RK
+#undef CC__VM_AND_RR
+#undef CC__VM_AND_RK
+#undef CC__VM_OR_RR
+#undef CC__VM_OR_RK
+#undef CC__VM_XOR_RR
+#undef CC__VM_XOR_RK
+#undef CC__VM_MOV_R
+#undef CC__VM_MOV_K
+#undef CC__VM_JUMP_R
+#undef CC__VM_JZ_R
+#undef CC__VM_JNZ_R
+
+void cc_vm_step(cc_vm* vm) {
+    cc_vm_run(vm, 1);
+}
 
-        vm->ip = new_ip;
-        vm->frame_pointer = vm->sp;
-        vm->args_pointer = new_args_pointer;
-        break;
+/// @brief Pack a sequence of opcodes and its length into a map key
+static uint32_t cc__vmngram_key(const uint8_t* opcodes, size_t length)
+{
+    _Static_assert(CC_VM_MAX_NGRAM <= 3, "The opcodes and length must fit in 32 bits");
+    uint32_t key = (uint32_t)length << 24;
+    for (size_t i = 0; i < length; ++i)
+        key |= (uint32_t)opcodes[i] << (i * 8);
+    return key;
+}
+/// @brief Increment the count of a sequence, and add it if it is new
+static void cc__vmprofile_count(cc_vmprofile* profile, const uint8_t* opcodes, size_t length)
+{
+    uint32_t key = cc__vmngram_key(opcodes, length);
+    uint32_t index;
+    if (!cc_hmap32_get(&profile->ngram_indices, key, &index))
+    {
+        index = (uint32_t)profile->num_ngrams;
+        ++profile->num_ngrams;
+        cc_vmngram* ngram = (cc_vmngram*)cc_vec_resize(profile->ngrams, profile->num_ngrams);
+        memset(ngram, 0, sizeof(*ngram));
+        memcpy(ngram->opcodes, opcodes, length);
+        ngram->length = (uint8_t)length;
+        cc_hmap32_put(&profile->ngram_indices, key, index);
     }
-    case CC_IR_OPCODE_RET:
+    ++profile->ngrams[index].count;
+}
+size_t cc_vm_run_profiled(cc_vm* vm, size_t max_steps, cc_vmprofile* profile)
+{
+    // The last opcodes executed in a straight line, from oldest to newest
+    uint8_t window[CC_VM_MAX_NGRAM];
+    size_t window_length = 0;
+    size_t steps = 0;
+
+    while (steps < max_steps)
     {
-        uint8_t** old_ip;
-        uint8_t** old_fp;
-        uint8_t** old_ap;
+        const uint8_t* ip = vm->ip;
+        // A superinstruction only executes its first instruction when stepping
+        uint8_t opcode = ip ? cc__vm_unfuse(((const cc_ir_ins*)ip)->opcode, NULL) : 0;
+        if (!cc_vm_run(vm, 1))
+            break;
+        ++steps;
 
-        if (   !(old_ap = (uint8_t**)cc__vm_pop(vm, sizeof(*old_ap)))
-            || !(old_fp = (uint8_t**)cc__vm_pop(vm, sizeof(*old_fp)))
-            || !(old_ip = (uint8_t**)cc__vm_pop(vm, sizeof(*old_ip)))
-        ) {
-            return;
+        if (window_length == CC_VM_MAX_NGRAM)
+        {
+            memmove(window, window + 1, CC_VM_MAX_NGRAM - 1);
+            --window_length;
         }
-        
-        vm->ip = *old_ip;
-        vm->frame_pointer = *old_fp;
-        vm->args_pointer = *old_ap;
-        break;
-    }
-    case CC_IR_OPCODE_INT:
-        vm->vmexception = CC_VMEXCEPTION_INTERRUPT;
-        vm->interrupt = ins->operand.u32;
-        break;
-    case CC_IR_OPCODE_FRAME:
-    {
-        uint8_t* new_fp = cc__vm_push(vm, ins->operand.u32);
-        if (!new_fp)
-            return;
-        vm->frame_pointer = new_fp;
-        break;
-    }
-    default:
-        vm->vmexception = CC_VMEXCEPTION_INVALID_CODE;
+        window[window_length++] = opcode;
+        for (size_t length = 2; length <= window_length; ++length)
+            cc__vmprofile_count(profile, window + window_length - length, length);
+
+        if (vm->vmexception != CC_VMEXCEPTION_NONE)
+            break;
+        // Sequences are only counted if they can be fused, so control flow must not change
+        if (vm->ip != ip + sizeof(cc_ir_ins))
+            window_length = 0;
     }
+    return steps;
 }
 
 bool cc__vm_offset_stack(cc_vm* vm, int32_t offset)
@@ -400,64 +774,140 @@ uint8_t* cc__vm_pop(cc_vm* vm, uint32_t num_bytes)
     return previous_sp;
 }
 
-size_t cc__vm_local_stack_offset(const cc_ir_func* func, cc_ir_localid localid)
+size_t cc__vm_local_size(const cc_ir_local* local)
+{
+    switch (local->typeid)
+    {
+    case CC_IR_TYPEID_INT:
+    case CC_IR_TYPEID_FLOAT:
+    case CC_IR_TYPEID_DATA:
+        return local->data_size;
+    case CC_IR_TYPEID_PTR:  return sizeof(void*);
+    default:                return 0;
+    }
+}
+
+size_t cc__vm_local_align(const cc_ir_local* local)
 {
+    size_t size = cc__vm_local_size(local);
+    size_t align = size & (~size + 1); // Lowest set bit
+    return align < _Alignof(max_align_t) ? align : _Alignof(max_align_t);
+}
+
+void cc__vmframe_create(cc_vmframe* frame, const cc_ir_func* func)
+{
+    // Local IDs are indexes into `func->locals`
+    frame->num_locals = func->num_locals;
+    frame->offsets = (uint32_t*)malloc(func->num_locals * sizeof(frame->offsets[0]));
+    frame->sizes = (uint32_t*)malloc(func->num_locals * sizeof(frame->sizes[0]));
+
     size_t offset = 0;
+    size_t max_align = 1;
     for (size_t i = 0; i < func->num_locals; ++i)
     {
         const cc_ir_local* local = &func->locals[i];
-        size_t local_size = cc__vm_local_size(local);
-        if (local->localid == localid)
-            return local_size ? offset : (size_t)-1;
-        offset += local_size;
+        size_t size = cc__vm_local_size(local);
+        size_t align = cc__vm_local_align(local);
+        frame->sizes[i] = (uint32_t)size;
+        if (!size)
+        {
+            frame->offsets[i] = UINT32_MAX;
+            continue;
+        }
+        offset = (offset + align - 1) & ~(align - 1);
+        frame->offsets[i] = (uint32_t)offset;
+        offset += size;
+        if (align > max_align)
+            max_align = align;
     }
+    frame->size = (uint32_t)((offset + max_align - 1) & ~(max_align - 1));
+}
 
-    return (size_t)-1;
+void cc__vmframe_destroy(cc_vmframe* frame)
+{
+    free(frame->offsets);
+    free(frame->sizes);
 }
 
-size_t cc__vm_local_stack_size(const cc_ir_func* func)
+#if CC_VM_NATIVE
+/// @brief Free a function's native code. Its entry point becomes `nullptr`.
+static void cc__vmnative_destroy(cc_vmnative* native)
 {
-    size_t offset = 0;
-    for (size_t i = 0; i < func->num_locals; ++i)
-        offset += cc__vm_local_size(&func->locals[i]);
-    return offset;
+    if (!native->entry)
+        return;
+#ifdef _WIN32
+    VirtualFree((void*)native->entry, 0, MEM_RELEASE);
+#else
+    munmap((void*)native->entry, native->size);
+#endif
+    native->entry = NULL;
+    native->size = 0;
+}
+/// @brief Free a function's native code, and reuse its entry for the next function compiled
+static void cc__vmprogram_free_native(cc_vmprogram* program, uint32_t index)
+{
+    if (!program->natives[index].entry)
+        return;
+    cc__vmnative_destroy(&program->natives[index]);
+    ++program->num_free_natives;
+    cc_vec_resize(program->free_natives, program->num_free_natives);
+    program->free_natives[program->num_free_natives - 1] = index;
 }
+#endif
 
-size_t cc__vm_local_size(const cc_ir_local* local)
+/// @brief Free a chunk's instructions or globals, unless they are in the program's image
+static void cc__vmprogram_free_chunk(const cc_vmprogram* program, void* chunk)
 {
-    switch (local->typeid)
-    {
-    case CC_IR_TYPEID_INT:
-    case CC_IR_TYPEID_FLOAT:
-    case CC_IR_TYPEID_DATA:
-        return local->data_size;
-    case CC_IR_TYPEID_PTR:  return sizeof(void*);
-    default:                return 0;
-    }
+    if (program->image && (uint8_t*)chunk >= program->image && (uint8_t*)chunk < program->image + program->image_size)
+        return;
+    free(chunk);
 }
 
-void cc_vmprogram_create(cc_vmprogram* program) {
+void cc_vmprogram_create(cc_vmprogram* program)
+{
     memset(program, 0, sizeof(*program));
+    program->is_verified = true;
+    program->jit_threshold = 1000;
 }
 void cc_vmprogram_destroy(cc_vmprogram* program)
 {
     for (size_t i = 0; i < program->num_ins_chunks; ++i)
-        free(program->ins_chunks[i]);
+        cc__vmprogram_free_chunk(program, program->ins_chunks[i]);
     free(program->ins_chunks);
     free(program->ins_chunk_lengths);
     for (size_t i = 0; i < program->num_global_chunks; ++i)
-        free(program->global_chunks[i]);
+        cc__vmprogram_free_chunk(program, program->global_chunks[i]);
     free(program->global_chunks);
+    free(program->global_chunk_sizes);
     for (size_t i = 0; i < program->num_symbols; ++i)
         cc_vmsymbol_destroy(&program->symbols[i]);
     free(program->symbols);
-    cc_vmimport* import = program->first_import;
-    do
+#if CC_VM_NATIVE
+    for (size_t i = 0; i < program->num_natives; ++i)
+        cc__vmnative_destroy(&program->natives[i]);
+#endif
+    free(program->natives);
+    free(program->free_natives);
+    for (size_t i = 0; i < program->num_symbols; ++i)
     {
-        cc_vmimport* next_import = import->next_import;
-        cc_vmimport_destroy(import);
-        import = next_import;
-    } while (import);
+        if (program->tiers[i].func)
+            cc_ir_func_destroy(program->tiers[i].func);
+    }
+    free(program->tiers);
+    cc_hmap32_destroy(&program->symbol_map);
+    // Every import belongs to one chunk, whether it was resolved or not
+    for (size_t i = 0; i < program->num_ins_chunks; ++i)
+    {
+        cc_vmchunk* chunk = &program->chunks[i];
+        for (size_t j = 0; j < chunk->num_imports; ++j)
+            cc_vmimport_destroy(chunk->imports[j]);
+        free(chunk->imports);
+    }
+    free(program->chunks);
+    free(program->imports);
+    cc_hmap32_destroy(&program->import_map);
+    if (program->is_image_mapped)
+        cc__vmprogram_unmap(program);
 }
 cc_vmsymbol* cc_vmprogram_get_symbol(const cc_vmprogram* program, const char* name, size_t name_len)
 {
@@ -468,110 +918,628 @@ cc_vmsymbol* cc_vmprogram_get_symbol(const cc_vmprogram* program, const char* na
     if (!name_len)
         return NULL;
 
-    for (size_t i = 0; i < program->num_symbols; ++i)
+    uint32_t index = cc__vmprogram_find_symbol(program, name, name_len, cc_fnv1a_32(name, name_len));
+    return index == UINT32_MAX ? NULL : &program->symbols[index];
+}
+uint32_t cc__vmprogram_find_symbol(const cc_vmprogram* program, const char* name, size_t name_len, uint32_t hash)
+{
+    uint32_t index = cc_hmap32_get_default(&program->symbol_map, hash, UINT32_MAX);
+    while (index != UINT32_MAX)
     {
-        cc_vmsymbol* symbol = &program->symbols[i];
-        if (symbol->name_len == name_len && !memcmp(symbol->name, name, name_len));
-            return symbol;
+        const cc_vmsymbol* symbol = &program->symbols[index];
+        if (symbol->name_len == name_len && (!name_len || !memcmp(symbol->name, name, name_len)))
+            return index;
+        index = symbol->next_hashed;
     }
-    return NULL;
+    return UINT32_MAX;
 }
-bool cc_vmprogram_link(cc_vmprogram* program, const cc_ir_object* obj)
+/// @brief Compile `obj` for `program`, with symbols starting at `first_symbol_index`
+static bool cc__vmprogram_compile_object(const cc_vmprogram* program, cc_vmobject* vmobj, const cc_ir_object* obj, size_t first_symbol_index)
 {
-    cc_vmobject vmobj;
-    size_t first_symbol_index = program->num_symbols;
-    cc_vmobject_create(&vmobj);
-    if (!cc_vmobject_compile(&vmobj, obj, first_symbol_index))
+    cc_vmobject_create(vmobj);
+    vmobj->target = program->target;
+    // Counting is only useful when there is a native tier to promote to
+    vmobj->is_counted = CC_VM_NATIVE && program->jit && program->jit_threshold != 0;
+    if (!cc_vmobject_compile(vmobj, obj, first_symbol_index))
     {
-        cc_vmobject_destroy(&vmobj);
+        cc_vmobject_destroy(vmobj);
         return false;
     }
+    return true;
+}
+/// @brief Move a compiled object into the chunk and its reserved symbol indexes, and resolve imports in both directions
+static void cc__vmprogram_install(cc_vmprogram* program, size_t chunk_index, cc_vmobject* vmobj, const cc_ir_object* obj)
+{
+    cc_vmchunk* chunk = &program->chunks[chunk_index];
+    size_t first_symbol_index = chunk->first_symbol_index;
+    size_t end_symbol_index = first_symbol_index + vmobj->num_symbols;
+    chunk->num_symbols = vmobj->num_symbols;
+    chunk->is_verified = vmobj->is_verified;
+    program->is_verified = program->is_verified && vmobj->is_verified;
+    memset(program->tiers + first_symbol_index, 0, vmobj->num_symbols * sizeof(program->tiers[0]));
+
+    // Move data out of vmobject and into vmprogram, without unecessary copying
+
+    program->ins_chunk_lengths[chunk_index] = vmobj->num_ins;
+    program->ins_chunks[chunk_index] = vmobj->ins;
+    program->global_chunks[chunk_index] = vmobj->global_data;
+    program->global_chunk_sizes[chunk_index] = vmobj->size_global_data;
+
+    vmobj->ins = NULL;
+    vmobj->global_data = NULL;
+
+    cc_vmimport* new_imports = vmobj->first_import;
+    vmobj->first_import = NULL;
+
+    for (size_t i = 0; i < vmobj->num_symbols; ++i)
+    {
+        uint32_t index = (uint32_t)(first_symbol_index + i);
+        cc_vmsymbol* new_symbol = &program->symbols[index];
+        cc_vmsymbol_move(new_symbol, &vmobj->symbols[i]);
+        // All symbols are functions for now.
+        // Because the code array is reallocating, the ptr is just an offset.
+        // So convert the ptr back to an actual ptr
+        new_symbol->ptr = (uint8_t*)program->ins_chunks[chunk_index] + (size_t)new_symbol->ptr;
+
+        // Append to the end of its hash chain, so a name finds its first symbol
+        new_symbol->next_hashed = UINT32_MAX;
+        uint32_t* link = NULL;
+        uint32_t other = cc_hmap32_get_default(&program->symbol_map, new_symbol->hash, UINT32_MAX);
+        while (other != UINT32_MAX)
+        {
+            link = &program->symbols[other].next_hashed;
+            other = *link;
+        }
+        if (link)
+            *link = index;
+        else
+            cc_hmap32_put(&program->symbol_map, new_symbol->hash, index);
+    }
+
+    // All data was moved. Now we may destroy our compiled object.
+    bool is_counted = vmobj->is_counted;
+    cc_vmobject_destroy(vmobj);
+
+    // The new symbols are in the same order as the object's internal symbols
+    if (is_counted)
+    {
+        // Keep the IR of every function, because it is compiled after `obj` may be destroyed
+        size_t symbol_index = first_symbol_index;
+        for (size_t i = 0; i < obj->num_symbols; ++i)
+        {
+            const cc_ir_symbol* irsymbol = &obj->symbols[i];
+            if (irsymbol->symbol_flags & CC_IR_SYMBOLFLAG_EXTERNAL)
+                continue;
+            if (irsymbol->ptr.func->entry_block)
+            {
+                cc_ir_func* func = (cc_ir_func*)malloc(sizeof(*func));
+                cc_ir_func_clone(irsymbol->ptr.func, func);
+                program->tiers[symbol_index].func = func;
+            }
+            ++symbol_index;
+        }
+    }
+    else if (program->jit)
+    {
+        size_t symbol_index = first_symbol_index;
+        for (size_t i = 0; i < obj->num_symbols; ++i)
+        {
+            const cc_ir_symbol* irsymbol = &obj->symbols[i];
+            if (irsymbol->symbol_flags & CC_IR_SYMBOLFLAG_EXTERNAL)
+                continue;
+            // A function without blocks has no code, so its ptr is the next function's code
+            if (irsymbol->ptr.func->entry_block)
+                cc__vmprogram_compile_native(program, irsymbol->ptr.func, (cc_ir_ins*)program->symbols[symbol_index].ptr);
+            ++symbol_index;
+        }
+    }
     
+    // Resolve the earlier imports of every new symbol.
+    // Only the chain with the symbol's hash is searched, instead of every unresolved import.
+    for (size_t i = first_symbol_index; i < end_symbol_index; ++i)
+    {
+        cc_vmsymbol* symbol = &program->symbols[i];
+        uint32_t chain;
+        if (!cc_hmap32_get(&program->import_map, symbol->hash, &chain))
+            continue;
+        cc_vmimport** prev_link = &program->imports[chain];
+        while (*prev_link)
+        {
+            cc_vmimport* import = *prev_link;
+            if (import->name_len == symbol->name_len && (!symbol->name_len || !memcmp(import->name, symbol->name, symbol->name_len)))
+            {
+                // Move this import to the symbol. It is resolved.
+                for (size_t j = 0; j < import->num_code_refs; ++j)
+                    *import->code_refs[j] = (cc_ir_symbolid)i;
+                *prev_link = import->next_import;
+                import->symbol_index = (uint32_t)i;
+                import->next_import = symbol->first_import;
+                symbol->first_import = import;
+            }
+            else
+                prev_link = &import->next_import;
+        }
+    }
+
+    // Resolve the new imports, or keep them for a later link
+    while (new_imports)
+    {
+        cc_vmimport* import = new_imports;
+        new_imports = import->next_import;
+        ++chunk->num_imports;
+        cc_vmimport** entry = (cc_vmimport**)cc_vec_resize(chunk->imports, chunk->num_imports);
+        *entry = import;
+        if (!cc__vmprogram_resolve(program, import))
+            cc__vmprogram_unresolve(program, import);
+    }
+}
+/// @brief Remove everything installed in the chunk, except for its reserved symbol indexes
+/// @param out_orphans Stores the list of imports which were resolved to the chunk's symbols, linked by @ref cc_vmimport.next_import
+static void cc__vmprogram_detach(cc_vmprogram* program, size_t chunk_index, cc_vmimport** out_orphans)
+{
+    cc_vmchunk* chunk = &program->chunks[chunk_index];
+
+    // Destroy the object's imports, which reference its code
+    for (size_t i = 0; i < chunk->num_imports; ++i)
+    {
+        cc_vmimport* import = chunk->imports[i];
+        cc_vmimport** link = import->symbol_index != UINT32_MAX
+            ? &program->symbols[import->symbol_index].first_import
+            : &program->imports[cc_hmap32_get_default(&program->import_map, import->hash, 0)];
+        while (*link != import)
+            link = &(*link)->next_import;
+        *link = import->next_import;
+        cc_vmimport_destroy(import);
+    }
+    free(chunk->imports);
+    chunk->imports = NULL;
+    chunk->num_imports = 0;
+
+    // Remove the object's symbols, and collect every import resolved to them
+    *out_orphans = NULL;
+    for (size_t i = chunk->first_symbol_index; i < chunk->first_symbol_index + chunk->num_symbols; ++i)
+    {
+        cc_vmsymbol* symbol = &program->symbols[i];
+        uint32_t head = cc_hmap32_get_default(&program->symbol_map, symbol->hash, UINT32_MAX);
+        if (head == i)
+        {
+            if (symbol->next_hashed == UINT32_MAX)
+                cc_hmap32_delete(&program->symbol_map, symbol->hash);
+            else
+                cc_hmap32_put(&program->symbol_map, symbol->hash, symbol->next_hashed);
+        }
+        else
+        {
+            uint32_t* link = &program->symbols[head].next_hashed;
+            while (*link != i)
+                link = &program->symbols[*link].next_hashed;
+            *link = symbol->next_hashed;
+        }
+
+        while (symbol->first_import)
+        {
+            cc_vmimport* import = symbol->first_import;
+            symbol->first_import = import->next_import;
+            import->next_import = *out_orphans;
+            *out_orphans = import;
+        }
+
+#if CC_VM_NATIVE
+        // A function without blocks shares the next function's code, so its native code may already be freed
+        const cc_ir_ins* entry = (const cc_ir_ins*)symbol->ptr;
+        const cc_ir_ins* end_ins = program->ins_chunks[chunk_index] + program->ins_chunk_lengths[chunk_index];
+        if (entry != end_ins && entry->opcode == CC_VMOPCODE_NATIVE)
+            cc__vmprogram_free_native(program, entry->operand.u32);
+#endif
+        if (program->tiers[i].func)
+            cc_ir_func_destroy(program->tiers[i].func);
+        memset(&program->tiers[i], 0, sizeof(program->tiers[i]));
+        cc_vmsymbol_destroy(symbol);
+        memset(symbol, 0, sizeof(*symbol));
+        symbol->next_hashed = UINT32_MAX;
+    }
+    chunk->num_symbols = 0;
+    chunk->is_verified = true;
+
+    cc__vmprogram_free_chunk(program, program->ins_chunks[chunk_index]);
+    cc__vmprogram_free_chunk(program, program->global_chunks[chunk_index]);
+    program->ins_chunks[chunk_index] = NULL;
+    program->global_chunks[chunk_index] = NULL;
+    program->ins_chunk_lengths[chunk_index] = 0;
+    program->global_chunk_sizes[chunk_index] = 0;
+}
+/// @brief Resolve every import in a list, or add it to the unresolved imports
+static void cc__vmprogram_adopt(cc_vmprogram* program, cc_vmimport* orphans)
+{
+    while (orphans)
+    {
+        cc_vmimport* import = orphans;
+        orphans = import->next_import;
+        if (!cc__vmprogram_resolve(program, import))
+            cc__vmprogram_unresolve(program, import);
+    }
+}
+/// @brief Count the symbols that `obj` will have once compiled
+static size_t cc__vmprogram_count_symbols(const cc_ir_object* obj)
+{
+    size_t num_symbols = 0;
+    for (size_t i = 0; i < obj->num_symbols; ++i)
+        num_symbols += !(obj->symbols[i].symbol_flags & CC_IR_SYMBOLFLAG_EXTERNAL);
+    return num_symbols;
+}
+/// @brief Append a chunk for an object with `num_symbols` symbols, and reserve its symbol indexes
+static void cc__vmprogram_add_chunk(cc_vmprogram* program, size_t num_symbols)
+{
+    size_t first_symbol_index = program->num_symbols;
     ++program->num_ins_chunks;
     ++program->num_global_chunks;
-    program->num_symbols += vmobj.num_symbols;
+    program->num_symbols += num_symbols;
     
     cc_vec_resize(program->ins_chunk_lengths,   program->num_ins_chunks);
     cc_vec_resize(program->ins_chunks,          program->num_ins_chunks);
     cc_vec_resize(program->global_chunks,       program->num_global_chunks);
+    cc_vec_resize(program->global_chunk_sizes,  program->num_global_chunks);
     cc_vec_resize(program->symbols,             program->num_symbols);
+    cc_vec_resize(program->tiers,               program->num_symbols);
+    cc_vmchunk* chunk = (cc_vmchunk*)cc_vec_resize(program->chunks, program->num_ins_chunks);
+    memset(chunk, 0, sizeof(*chunk));
+    chunk->first_symbol_index = first_symbol_index;
+    chunk->max_symbols = num_symbols;
+}
+bool cc_vmprogram_link(cc_vmprogram* program, const cc_ir_object* obj)
+{
+    if (program->is_shared)
+        return false;
+    cc_vmobject vmobj;
+    if (!cc__vmprogram_compile_object(program, &vmobj, obj, program->num_symbols))
+        return false;
+    cc__vmprogram_add_chunk(program, vmobj.num_symbols);
+    cc__vmprogram_install(program, program->num_ins_chunks - 1, &vmobj, obj);
+    return true;
+}
 
-    // Move data out of vmobject and into vmprogram, without unecessary copying
+/// @brief Objects shared by the threads of @ref cc_vmprogram_link_many
+typedef struct cc__vmlink_work
+{
+    const cc_vmprogram* program;
+    const cc_ir_object* const* objs;
+    cc_vmobject* vmobjs;
+    /// @brief Index of each object's first symbol
+    size_t* first_symbol_indexes;
+    /// @brief Whether each object compiled
+    bool* results;
+    size_t num_objs;
+    /// @brief Index of the next object to compile
+    size_t next;
+#ifdef _WIN32
+    CRITICAL_SECTION lock;
+#elif CC__VM_THREADS
+    pthread_mutex_t lock;
+#endif
+} cc__vmlink_work;
+
+/// @brief Take the next object to compile
+/// @return `num_objs` when every object is taken
+static size_t cc__vmlink_take(cc__vmlink_work* work)
+{
+#ifdef _WIN32
+    EnterCriticalSection(&work->lock);
+    size_t index = work->next++;
+    LeaveCriticalSection(&work->lock);
+#elif CC__VM_THREADS
+    pthread_mutex_lock(&work->lock);
+    size_t index = work->next++;
+    pthread_mutex_unlock(&work->lock);
+#else
+    size_t index = work->next++;
+#endif
+    return index < work->num_objs ? index : work->num_objs;
+}
+/// @brief Compile objects until there are none left. Objects are taken one at a time, so large objects do not hold up a thread.
+static void cc__vmlink_compile(cc__vmlink_work* work)
+{
+    size_t i;
+    while ((i = cc__vmlink_take(work)) < work->num_objs)
+        work->results[i] = cc__vmprogram_compile_object(work->program, &work->vmobjs[i], work->objs[i], work->first_symbol_indexes[i]);
+}
+#ifdef _WIN32
+static DWORD WINAPI cc__vmlink_thread(LPVOID work) {
+    cc__vmlink_compile((cc__vmlink_work*)work);
+    return 0;
+}
+#elif CC__VM_THREADS
+static void* cc__vmlink_thread(void* work) {
+    cc__vmlink_compile((cc__vmlink_work*)work);
+    return NULL;
+}
+#endif
+
+bool cc_vmprogram_link_many(cc_vmprogram* program, const cc_ir_object* const* objs, size_t num_objs, size_t num_threads)
+{
+    if (program->is_shared)
+        return false;
+    if (!num_objs)
+        return true;
+    cc__vmlink_work work;
+    memset(&work, 0, sizeof(work));
+    work.program = program;
+    work.objs = objs;
+    work.num_objs = num_objs;
+    work.vmobjs = (cc_vmobject*)malloc(num_objs * sizeof(work.vmobjs[0]));
+    work.first_symbol_indexes = (size_t*)malloc(num_objs * sizeof(work.first_symbol_indexes[0]));
+    work.results = (bool*)calloc(num_objs, sizeof(work.results[0]));
+
+    // Symbol indexes are reserved up front, so objects compile in any order
+    size_t first_symbol_index = program->num_symbols;
+    for (size_t i = 0; i < num_objs; ++i)
+    {
+        work.first_symbol_indexes[i] = first_symbol_index;
+        first_symbol_index += cc__vmprogram_count_symbols(objs[i]);
+    }
+
+    // The calling thread compiles too
+    if (num_threads > num_objs)
+        num_threads = num_objs;
+    size_t num_started = 0;
+#ifdef _WIN32
+    InitializeCriticalSection(&work.lock);
+    HANDLE* threads = (HANDLE*)malloc(num_threads * sizeof(threads[0]));
+    for (size_t i = 1; i < num_threads; ++i)
+    {
+        threads[num_started] = CreateThread(NULL, 0, &cc__vmlink_thread, &work, 0, NULL);
+        num_started += threads[num_started] != NULL;
+    }
+    cc__vmlink_compile(&work);
+    for (size_t i = 0; i < num_started; ++i)
+    {
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+    }
+    free(threads);
+    DeleteCriticalSection(&work.lock);
+#elif CC__VM_THREADS
+    pthread_mutex_init(&work.lock, NULL);
+    pthread_t* threads = (pthread_t*)malloc(num_threads * sizeof(threads[0]));
+    for (size_t i = 1; i < num_threads; ++i)
+        num_started += !pthread_create(&threads[num_started], NULL, &cc__vmlink_thread, &work);
+    cc__vmlink_compile(&work);
+    for (size_t i = 0; i < num_started; ++i)
+        pthread_join(threads[i], NULL);
+    free(threads);
+    pthread_mutex_destroy(&work.lock);
+#else
+    (void)num_started;
+    cc__vmlink_compile(&work);
+#endif
+
+    // Objects are merged in order, so the program is the same as linking them one at a time
+    bool result = true;
+    for (size_t i = 0; i < num_objs; ++i)
+        result = result && work.results[i];
+    for (size_t i = 0; i < num_objs; ++i)
+    {
+        if (!result)
+        {
+            if (work.results[i])
+                cc_vmobject_destroy(&work.vmobjs[i]);
+            continue;
+        }
+        cc__vmprogram_add_chunk(program, work.vmobjs[i].num_symbols);
+        cc__vmprogram_install(program, program->num_ins_chunks - 1, &work.vmobjs[i], objs[i]);
+    }
+    free(work.vmobjs);
+    free(work.first_symbol_indexes);
+    free(work.results);
+    return result;
+}
+bool cc_vmprogram_relink(cc_vmprogram* program, size_t chunk_index, const cc_ir_object* obj)
+{
+    if (program->is_shared)
+        return false;
+    // Reuse the object's symbol indexes if the new object fits. Otherwise, reserve new ones at the end.
+    size_t num_symbols = cc__vmprogram_count_symbols(obj);
+    bool is_moved = num_symbols > program->chunks[chunk_index].max_symbols;
+    size_t first_symbol_index = is_moved ? program->num_symbols : program->chunks[chunk_index].first_symbol_index;
+
+    cc_vmobject vmobj;
+    if (!cc__vmprogram_compile_object(program, &vmobj, obj, first_symbol_index))
+        return false;
+
+    cc_vmimport* orphans;
+    cc__vmprogram_detach(program, chunk_index, &orphans);
+    if (is_moved)
+    {
+        program->num_symbols += num_symbols;
+        cc_vec_resize(program->symbols, program->num_symbols);
+        cc_vec_resize(program->tiers,   program->num_symbols);
+        cc_vmchunk* chunk = &program->chunks[chunk_index];
+        chunk->first_symbol_index = first_symbol_index;
+        chunk->max_symbols = num_symbols;
+    }
 
-    program->ins_chunk_lengths[program->num_ins_chunks - 1] = vmobj.num_ins;
-    program->ins_chunks[program->num_ins_chunks - 1] = vmobj.ins;
-    program->global_chunks[program->num_global_chunks - 1] = vmobj.global_data;
+    // Only the replaced object may have been unverified
+    program->is_verified = true;
+    for (size_t i = 0; i < program->num_ins_chunks; ++i)
+        program->is_verified = program->is_verified && program->chunks[i].is_verified;
+    cc__vmprogram_install(program, chunk_index, &vmobj, obj);
+    // The replaced object's symbols may be the new symbols with the same names
+    cc__vmprogram_adopt(program, orphans);
+    return true;
+}
+bool cc_vmprogram_unlink(cc_vmprogram* program, size_t chunk_index)
+{
+    if (program->is_shared)
+        return false;
+    cc_vmimport* orphans;
+    cc__vmprogram_detach(program, chunk_index, &orphans);
+    program->is_verified = true;
+    for (size_t i = 0; i < program->num_ins_chunks; ++i)
+        program->is_verified = program->is_verified && program->chunks[i].is_verified;
+    cc__vmprogram_adopt(program, orphans);
+    return true;
+}
 
-    vmobj.ins = NULL;
-    vmobj.global_data = NULL;
+bool cc__vmprogram_resolve(cc_vmprogram* program, cc_vmimport* import)
+{
+    uint32_t index = cc__vmprogram_find_symbol(program, import->name, import->name_len, import->hash);
+    if (index == UINT32_MAX)
+        return false; // No symbol found. Skip.
+    cc_ir_symbolid symbolid = (cc_ir_symbolid)index;
 
-    cc_vmimport** last_import = &program->first_import;
-    while (*last_import)
-        last_import = &(*last_import)->next_import;
-    *last_import = vmobj.first_import;
-    vmobj.first_import = NULL;
+    // Symbol was found. Change all references in code
+    for (size_t i = 0; i < import->num_code_refs; ++i)
+        *import->code_refs[i] = symbolid;
+    cc_vmsymbol* symbol = &program->symbols[index];
+    import->symbol_index = index;
+    import->next_import = symbol->first_import;
+    symbol->first_import = import;
+    return true;
+}
+void cc__vmprogram_unresolve(cc_vmprogram* program, cc_vmimport* import)
+{
+    for (size_t i = 0; i < import->num_code_refs; ++i)
+        *import->code_refs[i] = (cc_ir_symbolid)-1;
+    import->symbol_index = UINT32_MAX;
 
-    for (size_t i = 0; i < vmobj.num_symbols; ++i)
+    uint32_t chain;
+    if (!cc_hmap32_get(&program->import_map, import->hash, &chain))
     {
-        cc_vmsymbol* new_symbol = &program->symbols[first_symbol_index + i];
-        cc_vmsymbol_move(new_symbol, &vmobj.symbols[i]);
-        // All symbols are functions for now.
-        // Because the code array is reallocating, the ptr is just an offset.
-        // So convert the ptr back to an actual ptr
-        new_symbol->ptr = (uint8_t*)program->ins_chunks[program->num_ins_chunks - 1] + (size_t)new_symbol->ptr;
+        chain = (uint32_t)program->num_imports++;
+        cc_vmimport** head = (cc_vmimport**)cc_vec_resize(program->imports, program->num_imports);
+        *head = NULL;
+        cc_hmap32_put(&program->import_map, import->hash, chain);
     }
+    import->next_import = program->imports[chain];
+    program->imports[chain] = import;
+}
 
-    // All data was moved. Now we may destroy our compiled object.
-    cc_vmobject_destroy(&vmobj);
-    
-    // Try to resolve all imports
+bool cc__vmprogram_compile_native(cc_vmprogram* program, const cc_ir_func* func, cc_ir_ins* entry)
+{
+#if CC_VM_NATIVE
+    if (entry->opcode != CC_IR_OPCODE_FRAME)
+        return false;
 
-    cc_vmimport* import = program->first_import;
-    cc_vmimport** prev_link = &program->first_import;
-    while (import)
+    x86gen gen;
+    x86func x86;
+    x86gen_create(&gen, CC__VM_NATIVE_CONV, func);
+    bool is_supported = x86gen_dump(&gen, &x86);
+    x86gen_destroy(&gen);
+    if (!is_supported)
+        return false;
+
+    // Copy the code to new memory, which is never writable and executable at once
+    size_t size = x86.size_code;
+#ifdef _WIN32
+    void* memory = VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (memory)
     {
-        cc_vmimport* next_import = import->next_import;
-        if (cc__vmprogram_resolve(program, import))
+        DWORD old_protect;
+        memcpy(memory, x86.code, size);
+        if (!VirtualProtect(memory, size, PAGE_EXECUTE_READ, &old_protect))
         {
-            // Remove this import. It is resolved.
-            cc_vmimport_destroy(import);
-            *prev_link = next_import;
-            import = next_import;
-            continue;
+            VirtualFree(memory, 0, MEM_RELEASE);
+            memory = NULL;
+        }
+    }
+#else
+    void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+        memory = NULL;
+    if (memory)
+    {
+        memcpy(memory, x86.code, size);
+        if (mprotect(memory, size, PROT_READ | PROT_EXEC))
+        {
+            munmap(memory, size);
+            memory = NULL;
         }
+    }
+#endif
+    x86func_destroy(&x86);
+    if (!memory)
+        return false;
 
-        prev_link = &import->next_import;
-        import = next_import;
+    uint32_t native_index;
+    if (program->num_free_natives)
+        native_index = program->free_natives[--program->num_free_natives];
+    else
+    {
+        native_index = (uint32_t)program->num_natives++;
+        cc_vec_resize(program->natives, program->num_natives);
     }
+    cc_vmnative* native = &program->natives[native_index];
+    native->entry = (cc_vmnative_func)memory;
+    native->size = size;
+    native->frame = *entry;
 
+    entry->opcode = CC_VMOPCODE_NATIVE;
+    entry->operand.u32 = native_index;
     return true;
+#else
+    return false;
+#endif
 }
-
-bool cc__vmprogram_resolve(cc_vmprogram* program, const cc_vmimport* import)
+void cc_vmprogram_share(cc_vmprogram* program)
 {
-    cc_ir_symbolid symbolid = (cc_ir_symbolid)-1;
-    
-    // Find a corresponding symbol
+    // Counting only writes to a tier which is waiting to be compiled
     for (size_t i = 0; i < program->num_symbols; ++i)
     {
-        const cc_vmsymbol* next_symbol = &program->symbols[i];
-        if (next_symbol->name_len == import->name_len && !memcmp(next_symbol->name, import->name, next_symbol->name_len))
-        {
-            symbolid = (cc_ir_symbolid)i;
-            break;
-        }
+        if (program->tiers[i].func)
+            cc__vmprogram_tier_up(program, i);
     }
-    if (symbolid == (cc_ir_symbolid)-1)
-        return false; // No symbol found. Skip.
+    program->is_shared = true;
+}
+void cc__vmprogram_tier_up(cc_vmprogram* program, size_t symbol_index)
+{
+    cc_vmtier* tier = &program->tiers[symbol_index];
+    cc_ir_func* func = tier->func;
+    if (!func)
+        return;
+    // Unsupported functions stay interpreted, and are not counted again
+    tier->func = NULL;
+    cc__vmprogram_compile_native(program, func, (cc_ir_ins*)program->symbols[symbol_index].ptr);
+    cc_ir_func_destroy(func);
+}
 
-    // Symbol was found. Change all references in code
-    for (size_t i = 0; i < import->num_code_refs; ++i)
-        *import->code_refs[i] = symbolid;
-    return true;
+void cc_vmprofile_create(cc_vmprofile* profile)
+{
+    memset(profile, 0, sizeof(*profile));
+    cc_hmap32_create(&profile->ngram_indices);
+}
+void cc_vmprofile_destroy(cc_vmprofile* profile)
+{
+    free(profile->ngrams);
+    cc_hmap32_destroy(&profile->ngram_indices);
+}
+static int cc__vmngram_compare(const void* lhs, const void* rhs)
+{
+    const cc_vmngram* a = (const cc_vmngram*)lhs;
+    const cc_vmngram* b = (const cc_vmngram*)rhs;
+    if (a->count != b->count)
+        return a->count > b->count ? -1 : 1;
+    // Prefer longer sequences, then order by opcode, so the result does not depend on execution order
+    if (a->length != b->length)
+        return a->length > b->length ? -1 : 1;
+    return memcmp(a->opcodes, b->opcodes, sizeof(a->opcodes));
+}
+void cc_vmprofile_sort(cc_vmprofile* profile)
+{
+    if (!profile->num_ngrams)
+        return;
+    qsort(profile->ngrams, profile->num_ngrams, sizeof(profile->ngrams[0]), cc__vmngram_compare);
+    // Every sequence moved, so the map must be rebuilt
+    cc_hmap32_clear(&profile->ngram_indices);
+    for (size_t i = 0; i < profile->num_ngrams; ++i)
+    {
+        const cc_vmngram* ngram = &profile->ngrams[i];
+        cc_hmap32_put(&profile->ngram_indices, cc__vmngram_key(ngram->opcodes, ngram->length), (uint32_t)i);
+    }
 }
 
-void cc_vmobject_create(cc_vmobject* vmobj) {
+void cc_vmobject_create(cc_vmobject* vmobj)
+{
     memset(vmobj, 0, sizeof(*vmobj));
+    vmobj->is_verified = true;
 }
 void cc_vmobject_destroy(cc_vmobject* vmobj)
 {
@@ -592,20 +1560,13 @@ bool cc_vmobject_compile(cc_vmobject* vmobject, const cc_ir_object* irobject, si
 {
     vmobject->first_symbol_index = first_symbol_index;
     
-    struct _symbolmap
-    {
-        cc_ir_symbolid ir_id; // ID in IR
-        cc_ir_symbolid vm_id; // `vmobject->symbol` array-index + first_symbol_index
-    };
-    struct _importmap
-    {
-        cc_ir_symbolid ir_id; // ID in IR
-        cc_vmimport* vmimport; // Pointer into vmobject import list
-    };
     bool result = false;
-    struct _symbolmap* symbolmap = NULL;
-    struct _importmap* importmap = NULL;
+    cc_hmap32 symbolmap; // ID in IR -> `vmobject->symbol` array-index + first_symbol_index
+    cc_hmap32 importmap; // ID in IR -> index into `imports`
+    cc_vmimport** imports = NULL;
     size_t num_imports = 0;
+    cc_hmap32_create(&symbolmap);
+    cc_hmap32_create(&importmap);
 
     // Copy all symbols and code into the obj
     for (size_t i = 0; i < irobject->num_symbols; ++i)
@@ -621,29 +1582,40 @@ bool cc_vmobject_compile(cc_vmobject* vmobject, const cc_ir_object* irobject, si
             vmobject->first_import = vmimport;
 
             ++num_imports;
-            struct _importmap* entry = (struct _importmap*)cc_vec_resize(importmap, num_imports);
-            entry->ir_id = irsymbol->symbolid;
-            entry->vmimport = vmimport;
+            cc_vmimport** entry = (cc_vmimport**)cc_vec_resize(imports, num_imports);
+            *entry = vmimport;
+            cc_hmap32_put(&importmap, irsymbol->symbolid, (uint32_t)(num_imports - 1));
         }
         else // Map internal irsymbol to vmsymbol
         {
             ++vmobject->num_symbols;
             cc_vmsymbol* vmsymbol = (cc_vmsymbol*)cc_vec_resize(vmobject->symbols,  vmobject->num_symbols);
-            struct _symbolmap* entry = (struct _symbolmap*)cc_vec_resize(symbolmap, vmobject->num_symbols);
+            cc_ir_symbolid vm_id = (cc_ir_symbolid)(vmobject->num_symbols - 1 + first_symbol_index);
 
             cc_vmsymbol_create(vmsymbol, irsymbol->name, irsymbol->name_len);
-            entry->ir_id = irsymbol->symbolid;
-            entry->vm_id = vmobject->num_symbols - 1 + first_symbol_index;
+            cc_hmap32_put(&symbolmap, irsymbol->symbolid, vm_id);
 
             // Symbol is a function. Append its code.
             {
                 const cc_ir_func* irfunc = irsymbol->ptr.func;
-                size_t code_offset = vmobject->num_ins * sizeof(vmobject->ins[0]);
+                size_t first_ins = vmobject->num_ins;
+                size_t code_offset = first_ins * sizeof(vmobject->ins[0]);
                 if (!cc__vmobject_flatten(vmobject, irfunc))
                 {
                     result = false;
                     goto end;
                 }
+                for (size_t j = first_ins; j < vmobject->num_ins; ++j)
+                {
+                    if (vmobject->ins[j].opcode == CC_VMOPCODE_COUNT)
+                        vmobject->ins[j].operand.u32 = vm_id;
+                }
+                if (vmobject->num_ins > first_ins)
+                {
+                    if (!cc__vm_verify_func(vmobject->ins + first_ins, vmobject->num_ins - first_ins))
+                        vmobject->is_verified = false;
+                    cc__vm_fuse(vmobject->ins + first_ins, vmobject->num_ins - first_ins, vmobject->target);
+                }
                 
                 vmsymbol->ptr = (void*)code_offset;
             }
@@ -656,7 +1628,7 @@ bool cc_vmobject_compile(cc_vmobject* vmobject, const cc_ir_object* irobject, si
     for (size_t i = 0; i < vmobject->num_ins; ++i)
     {
         cc_ir_ins* ins = &vmobject->ins[i];
-        const cc_ir_ins_format* fmt = &cc_ir_ins_formats[ins->opcode];
+        const cc_ir_ins_format* fmt = cc_vm_ins_format(ins->opcode);
         for (size_t i = 0; i < CC_IR_MAX_OPERANDS; ++i)
         {
             if (fmt->operand[i] != CC_IR_OPERAND_SYMBOLID)
@@ -664,21 +1636,11 @@ bool cc_vmobject_compile(cc_vmobject* vmobject, const cc_ir_object* irobject, si
             
             cc_ir_symbolid* symbolid = &ins->operand.symbolid;
 
-            // Find symbolid in `importmap`, if it's an import
-            cc_vmimport* vmimport = NULL;
-            for (size_t i = 0; i < num_imports; ++i)
-            {
-                struct _importmap* entry = &importmap[i];
-                if (entry->ir_id == *symbolid)
-                {
-                    vmimport = entry->vmimport;
-                    break;
-                }
-            }
-
             // ID is an imported symbol. Add to the list of referencing IDs and continue
-            if (vmimport)
+            uint32_t index;
+            if (cc_hmap32_get(&importmap, *symbolid, &index))
             {
+                cc_vmimport* vmimport = imports[index];
                 *symbolid = (cc_ir_symbolid)-1;
                 ++vmimport->num_code_refs;
                 cc_ir_symbolid** ref = (cc_ir_symbolid**)cc_vec_resize(vmimport->code_refs, vmimport->num_code_refs);
@@ -687,44 +1649,38 @@ bool cc_vmobject_compile(cc_vmobject* vmobject, const cc_ir_object* irobject, si
             }
             
             // Else, ID must be an internal symbol. Change it to the new ID.
-            bool exists = false;
-            for (size_t i = 0; i < vmobject->num_symbols; ++i)
-            {
-                struct _symbolmap* entry = &symbolmap[i];
-                if (entry->ir_id == *symbolid)
-                {
-                    exists = true;
-                    *symbolid = entry->vm_id;
-                    break;
-                }
-            }
-
-            // no such ID exists
-            if (!exists)
+            if (!cc_hmap32_get(&symbolmap, *symbolid, &index))
             {
+                // no such ID exists
                 result = false;
                 goto end;
             }
+            *symbolid = (cc_ir_symbolid)index;
         }
     }
 
     result = true;
 
 end:
-    free(symbolmap);
-    free(importmap);
+    cc_hmap32_destroy(&symbolmap);
+    cc_hmap32_destroy(&importmap);
+    free(imports);
     return result;
 }
 bool cc__vmobject_flatten(cc_vmobject* vmobject, const cc_ir_func* func)
 {
     struct _blockmap
     {
-        cc_ir_blockid blockid; // this block's id
+        size_t order; // position in the function's list of blocks
         size_t ins_index; // index in the object's instruction array
+        bool is_counted; // the block begins with CC_VMOPCODE_COUNT
     };
     bool result = false;
+    // Indexed by blockid, which are dense
     struct _blockmap* blockmap = NULL;
-    size_t num_blocks = 0;
+    size_t num_blocks = func->num_blocks;
+    cc_vmframe frame;
+    cc__vmframe_create(&frame, func);
 
     if (func->entry_block == NULL)
     {
@@ -732,9 +1688,9 @@ bool cc__vmobject_flatten(cc_vmobject* vmobject, const cc_ir_func* func)
         goto end;
     }
     
-    // Add the FRAME instruction to setup the stack frame (if any locals are present)
-    size_t local_frame_size = cc__vm_local_stack_size(func);
-    if (local_frame_size)
+    // Add the FRAME instruction to setup the stack frame.
+    // It is required even without locals, because it reserves the stack for trusted execution.
+    size_t local_frame_size = frame.size;
     {
         ++vmobject->num_ins;
         cc_ir_ins* ins = (cc_ir_ins*)cc_vec_resize(vmobject->ins, vmobject->num_ins);
@@ -743,14 +1699,48 @@ bool cc__vmobject_flatten(cc_vmobject* vmobject, const cc_ir_func* func)
         ins->operand.u32 = local_frame_size;
     }
     
+    // Map every block, in order
+    blockmap = (struct _blockmap*)calloc(num_blocks, sizeof(*blockmap));
+    size_t block_order = 0;
+    for (const cc_ir_block* block = func->entry_block; block; block = block->next_block, ++block_order)
+    {
+        struct _blockmap* entry = &blockmap[block->blockid];
+        entry->order = block_order;
+        entry->is_counted = vmobject->is_counted && block_order == 0;
+    }
+
+    // Count loop headers, which are any blocks jumped to from the same or a later block
+    if (vmobject->is_counted)
+    {
+        for (const cc_ir_block* block = func->entry_block; block; block = block->next_block)
+        {
+            for (size_t i = 0; i < block->num_ins; ++i)
+            {
+                const cc_ir_ins* ins = &block->ins[i];
+                if (ins->opcode != CC_IR_OPCODE_JZ && ins->opcode != CC_IR_OPCODE_JNZ)
+                    continue;
+                cc_ir_blockid target = ins->operand.blockid;
+                if (target < num_blocks && blockmap[target].order <= blockmap[block->blockid].order)
+                    blockmap[target].is_counted = true;
+            }
+        }
+    }
+
     // Append the block's data
+    size_t first_ins = vmobject->num_ins;
     for (const cc_ir_block* block = func->entry_block; block; block = block->next_block)
     {
-        // Append to block map
-        ++num_blocks;
-        struct _blockmap* entry = (struct _blockmap*)cc_vec_resize(blockmap, num_blocks);
-        entry->blockid = block->blockid;
+        // Jumps to this block land on its COUNT instruction
+        struct _blockmap* entry = &blockmap[block->blockid];
         entry->ins_index = vmobject->num_ins;
+        if (entry->is_counted)
+        {
+            // The operand is set to the symbol's index by cc_vmobject_compile
+            ++vmobject->num_ins;
+            cc_ir_ins* ins = (cc_ir_ins*)cc_vec_resize(vmobject->ins, vmobject->num_ins);
+            memset(ins, 0, sizeof(*ins));
+            ins->opcode = CC_VMOPCODE_COUNT;
+        }
         
         // Append instructions to vmobject
         size_t dst_index = vmobject->num_ins;
@@ -763,40 +1753,44 @@ bool cc__vmobject_flatten(cc_vmobject* vmobject, const cc_ir_func* func)
     // - Replace locals logic with frame pointer logic
     // - Replace blockid operands with a byte offset to that block, relative to the next instruction
     // - Replace 0 with `sizeof(void*)` in `data_size` and `extend_data_size` operands
-    for (size_t i = blockmap[0].ins_index; i < vmobject->num_ins; ++i)
+    for (size_t i = first_ins; i < vmobject->num_ins; ++i)
     {   
         cc_ir_ins* ins = &vmobject->ins[i];
+        if (ins->opcode == CC_VMOPCODE_COUNT)
+            continue;
 
         // Replace locals logic with frame pointer logic
         switch (ins->opcode)
         {
         case CC_IR_OPCODE_ADDRL: // Set u32 stack offset
-            ins->operand.u32 = (uint32_t)cc__vm_local_stack_offset(func, ins->operand.local);
-            break;
         case CC_IR_OPCODE_SIZEL: // Replace with the uconst instruction
+        case CC_IR_OPCODE_LOADL: // Set u32 stack offset; Set data_size to local's size
         {
-            const cc_ir_local* irlocal = cc_ir_func_getlocal(func, ins->operand.local);
-            if (irlocal == NULL) // No such local exists
+            cc_ir_localid localid = ins->operand.local;
+            if (localid >= frame.num_locals) // No such local exists
             {
                 result = false;
                 goto end;
             }
-            // (data_size is already set)
-            ins->opcode = CC_IR_OPCODE_UCONST;
-            ins->operand.u32 = (uint32_t)cc__vm_local_size(irlocal);
-            break;
-        }
-        case CC_IR_OPCODE_LOADL: // Set u32 stack offset; Set data_size to local's size
-        {
-            const cc_ir_local* irlocal = cc_ir_func_getlocal(func, ins->operand.local);
-            if (irlocal == NULL) // No such local exists
+            if (ins->opcode == CC_IR_OPCODE_SIZEL)
             {
-                result = false;
-                goto end;
+                // (data_size is already set)
+                ins->opcode = CC_IR_OPCODE_UCONST;
+                ins->operand.u32 = frame.sizes[localid];
+                break;
             }
-            ins->data_size = (cc_ir_datasize)cc__vm_local_size(irlocal);
-            ins->operand.u32 = cc__vm_local_stack_offset(func, irlocal->localid);
+            if (ins->opcode == CC_IR_OPCODE_LOADL)
+                ins->data_size = (cc_ir_datasize)frame.sizes[localid];
+            ins->operand.u32 = frame.offsets[localid];
+            break;
         }
+        case CC_IR_OPCODE_SIZEP: // Replace with the uconst instruction
+            ins->opcode = CC_IR_OPCODE_UCONST;
+            ins->operand.u32 = sizeof(void*);
+            break;
+        case CC_IR_OPCODE_RET: // Set u32 to the frame size, which is freed before returning
+            ins->operand.u32 = (uint32_t)local_frame_size;
+            break;
         }
         
         // - Replace blockid operands with byte offsets
@@ -809,25 +1803,18 @@ bool cc__vmobject_flatten(cc_vmobject* vmobject, const cc_ir_func* func)
             {
             case CC_IR_OPERAND_BLOCKID:
             {
-                cc_ir_blockid* blockid = &ins->operand.blockid;
+                cc_ir_blockid blockid = ins->operand.blockid;
 
                 // Find relevant block in blockmap, and replace `blockid` with an offset
-                const struct _blockmap* mapped_block = NULL;
-                for (size_t i = 0; i < num_blocks; ++i)
-                {
-                    if (blockmap[i].blockid == *blockid)
-                    {
-                        mapped_block = &blockmap[i];
-                        break;
-                    }
-                }
-                if (mapped_block == NULL) // No such block exists
+                if (blockid >= num_blocks) // No such block exists
                 {
                     result = false;
                     goto end; 
                 }
+                const struct _blockmap* mapped_block = &blockmap[blockid];
                 
-                *blockid = (cc_ir_blockid)((mapped_block->ins_index - next_ip) * sizeof(vmobject->ins[0]));
+                ptrdiff_t offset = ((ptrdiff_t)mapped_block->ins_index - (ptrdiff_t)next_ip) * (ptrdiff_t)sizeof(vmobject->ins[0]);
+                ins->operand.u32 = (uint32_t)(int32_t)offset;
                 break;
             }
             case CC_IR_OPERAND_DATASIZE:
@@ -840,12 +1827,439 @@ bool cc__vmobject_flatten(cc_vmobject* vmobject, const cc_ir_func* func)
                 break;
             }
         }
+
+        cc__vm_specialize(ins);
     }
 
     result = true;
 
 end:
     free(blockmap);
+    cc__vmframe_destroy(&frame);
+    return result;
+}
+
+void cc__vm_specialize(cc_ir_ins* ins)
+{
+    // Index of the native width. Every specialized opcode is ordered as I8, I16, I32, I64.
+    uint8_t width;
+    switch (ins->data_size)
+    {
+    case 1: width = 0; break;
+    case 2: width = 1; break;
+    case 4: width = 2; break;
+    case 8: width = 3; break;
+    default: return;
+    }
+
+    switch (ins->opcode)
+    {
+    case CC_IR_OPCODE_ICONST:
+    case CC_IR_OPCODE_UCONST:
+        if (width < 3) // No extension is required
+            ins->opcode = CC_VMOPCODE_CONST_I8 + width;
+        else if (ins->opcode == CC_IR_OPCODE_ICONST && (int32_t)ins->operand.u32 < 0)
+            ins->opcode = CC_VMOPCODE_ICONST_I64;
+        else // Sign-extension of a non-negative constant is the same as zero-extension
+            ins->opcode = CC_VMOPCODE_UCONST_I64;
+        break;
+    case CC_IR_OPCODE_LOADL: ins->opcode = CC_VMOPCODE_LOADL_I8 + width; break;
+    case CC_IR_OPCODE_LOAD:  ins->opcode = CC_VMOPCODE_LOAD_I8 + width; break;
+    case CC_IR_OPCODE_STORE: ins->opcode = CC_VMOPCODE_STORE_I8 + width; break;
+    case CC_IR_OPCODE_ADD:   ins->opcode = CC_VMOPCODE_ADD_I8 + width; break;
+    case CC_IR_OPCODE_SUB:   ins->opcode = CC_VMOPCODE_SUB_I8 + width; break;
+    case CC_IR_OPCODE_MUL:   ins->opcode = CC_VMOPCODE_MUL_I8 + width; break;
+    case CC_IR_OPCODE_UMUL:  ins->opcode = CC_VMOPCODE_MUL_I8 + width; break;
+    case CC_IR_OPCODE_DIV:   ins->opcode = CC_VMOPCODE_DIV_I8 + width; break;
+    case CC_IR_OPCODE_UDIV:  ins->opcode = CC_VMOPCODE_UDIV_I8 + width; break;
+    case CC_IR_OPCODE_MOD:   ins->opcode = CC_VMOPCODE_MOD_I8 + width; break;
+    case CC_IR_OPCODE_UMOD:  ins->opcode = CC_VMOPCODE_UMOD_I8 + width; break;
+    case CC_IR_OPCODE_NEG:   ins->opcode = CC_VMOPCODE_NEG_I8 + width; break;
+    case CC_IR_OPCODE_NOT:   ins->opcode = CC_VMOPCODE_NOT_I8 + width; break;
+    case CC_IR_OPCODE_AND:   ins->opcode = CC_VMOPCODE_AND_I8 + width; break;
+    case CC_IR_OPCODE_OR:    ins->opcode = CC_VMOPCODE_OR_I8 + width; break;
+    case CC_IR_OPCODE_XOR:   ins->opcode = CC_VMOPCODE_XOR_I8 + width; break;
+    case CC_IR_OPCODE_LSH:   ins->opcode = CC_VMOPCODE_LSH_I8 + width; break;
+    case CC_IR_OPCODE_RSH:   ins->opcode = CC_VMOPCODE_RSH_I8 + width; break;
+    case CC_IR_OPCODE_ZEXT:
+    case CC_IR_OPCODE_SEXT:
+        // The destination is written by a switch, so it must be native too
+        switch (ins->operand.extend_data_size)
+        {
+        case 1: case 2: case 4: case 8: break;
+        default: return;
+        }
+        ins->opcode = (ins->opcode == CC_IR_OPCODE_ZEXT ? CC_VMOPCODE_ZEXT_I8 : CC_VMOPCODE_SEXT_I8) + width;
+        break;
+    case CC_IR_OPCODE_JZ:    ins->opcode = CC_VMOPCODE_JZ_I8 + width; break;
+    case CC_IR_OPCODE_JNZ:   ins->opcode = CC_VMOPCODE_JNZ_I8 + width; break;
+    }
+}
+
+/// @brief Check if `opcode` is a width-specialized variant of `opcode_i8`, and get the index of its width
+static bool cc__vm_width_of(uint8_t opcode, uint8_t opcode_i8, uint8_t* width)
+{
+    if (opcode < opcode_i8 || opcode >= opcode_i8 + 4)
+        return false;
+    *width = (uint8_t)(opcode - opcode_i8);
+    return true;
+}
+
+/// @brief Get the opcode which pushes a constant of a native width, without sign-extension
+static uint8_t cc__vm_const_opcode(uint8_t width)
+{
+    return width < 3 ? CC_VMOPCODE_CONST_I8 + width : CC_VMOPCODE_UCONST_I64;
+}
+
+/// @brief Stack instructions with a three-address form, and the 4-byte variants of those forms
+static const struct
+{
+    uint8_t opcode_i8;
+    uint8_t rr_i32;
+    uint8_t rk_i32;
+} cc__vm_three_address_ops[] =
+{
+    {CC_VMOPCODE_ADD_I8, CC_VMOPCODE_ADD_RR_I32, CC_VMOPCODE_ADD_RK_I32},
+    {CC_VMOPCODE_SUB_I8, CC_VMOPCODE_SUB_RR_I32, CC_VMOPCODE_SUB_RK_I32},
+    {CC_VMOPCODE_MUL_I8, CC_VMOPCODE_MUL_RR_I32, CC_VMOPCODE_MUL_RK_I32},
+    {CC_VMOPCODE_AND_I8, CC_VMOPCODE_AND_RR_I32, CC_VMOPCODE_AND_RK_I32},
+    {CC_VMOPCODE_OR_I8,  CC_VMOPCODE_OR_RR_I32,  CC_VMOPCODE_OR_RK_I32},
+    {CC_VMOPCODE_XOR_I8, CC_VMOPCODE_XOR_RR_I32, CC_VMOPCODE_XOR_RK_I32},
+};
+
+/// @brief Replace a sequence at `ins` with a three-address instruction
+/// @return The number of instructions replaced, or 0 if there is no match
+static size_t cc__vm_fuse_register(cc_ir_ins* ins, size_t num_ins)
+{
+    uint8_t width;
+    uint8_t opcode = ins[0].opcode;
+    bool is_local = cc__vm_width_of(opcode, CC_VMOPCODE_LOADL_I8, &width);
+    if (!is_local && !(cc__vm_width_of(opcode, CC_VMOPCODE_CONST_I8, &width) && width < 3))
+    {
+        if (opcode != CC_VMOPCODE_UCONST_I64)
+            return 0;
+        width = 3;
+    }
+
+    // `c = a OP b` or `c = a OP k`
+    if (num_ins >= 5 && width >= 2 && ins[1].opcode == CC_VMOPCODE_LOADL_I8 + width
+        && ins[3].opcode == CC_IR_OPCODE_ADDRL && ins[4].opcode == CC_VMOPCODE_STORE_I8 + width)
+    {
+        for (size_t i = 0; i < sizeof(cc__vm_three_address_ops) / sizeof(cc__vm_three_address_ops[0]); ++i)
+        {
+            if (ins[2].opcode != cc__vm_three_address_ops[i].opcode_i8 + width)
+                continue;
+            ins[0].opcode = (is_local ? cc__vm_three_address_ops[i].rr_i32 : cc__vm_three_address_ops[i].rk_i32) + width - 2;
+            return 5;
+        }
+    }
+    // `c = a` or `c = k`
+    if (num_ins >= 3 && ins[1].opcode == CC_IR_OPCODE_ADDRL && ins[2].opcode == CC_VMOPCODE_STORE_I8 + width)
+    {
+        ins[0].opcode = (is_local ? CC_VMOPCODE_MOV_R_I8 : CC_VMOPCODE_MOV_K_I8) + width;
+        return 3;
+    }
+    // `if (a) goto` or `if (!a) goto`
+    if (num_ins >= 2 && is_local && width >= 2)
+    {
+        if (ins[1].opcode == CC_VMOPCODE_JZ_I8 + width)
+        {
+            ins[0].opcode = CC_VMOPCODE_JZ_R_I32 + width - 2;
+            return 2;
+        }
+        if (ins[1].opcode == CC_VMOPCODE_JNZ_I8 + width)
+        {
+            ins[0].opcode = CC_VMOPCODE_JNZ_R_I32 + width - 2;
+            return 2;
+        }
+    }
+    return 0;
+}
+
+void cc__vm_fuse(cc_ir_ins* ins, size_t num_ins, cc_vmtarget target)
+{
+    // Fused instructions only replace the first opcode, so a sequence may span blocks.
+    // A jump into the middle of it just executes the original instructions.
+    for (size_t i = 0; i + 1 < num_ins; ++i)
+    {
+        cc_ir_ins* first = &ins[i];
+        const cc_ir_ins* second = &ins[i + 1];
+        const cc_ir_ins* third = i + 2 < num_ins ? &ins[i + 2] : NULL;
+        uint8_t width;
+        size_t length = 1;
+
+        if (target == CC_VMTARGET_REGISTER && (length = cc__vm_fuse_register(first, num_ins - i)) != 0)
+        {
+            i += length - 1;
+            continue;
+        }
+        length = 1;
+
+        if (third && first->opcode == CC_IR_OPCODE_DUPE && second->opcode == CC_IR_OPCODE_ADDRL
+            && cc__vm_width_of(third->opcode, CC_VMOPCODE_STORE_I8, &width) && first->data_size == third->data_size)
+        {
+            first->opcode = CC_VMOPCODE_DUPE_ADDRL_STORE_I8 + width;
+            length = 3;
+        }
+        else if (third && cc__vm_width_of(first->opcode, CC_VMOPCODE_LOADL_I8, &width)
+            && second->opcode == cc__vm_const_opcode(width) && third->opcode == CC_VMOPCODE_ADD_I8 + width)
+        {
+            first->opcode = CC_VMOPCODE_LOADL_CONST_ADD_I8 + width;
+            length = 3;
+        }
+        else if (first->opcode == CC_IR_OPCODE_ADDRL && cc__vm_width_of(second->opcode, CC_VMOPCODE_LOAD_I8, &width))
+        {
+            first->opcode = CC_VMOPCODE_ADDRL_LOAD_I8 + width;
+            length = 2;
+        }
+        else if (first->opcode == CC_IR_OPCODE_ADDRL && cc__vm_width_of(second->opcode, CC_VMOPCODE_STORE_I8, &width))
+        {
+            first->opcode = CC_VMOPCODE_ADDRL_STORE_I8 + width;
+            length = 2;
+        }
+        else if (cc__vm_width_of(second->opcode, CC_VMOPCODE_JZ_I8, &width) && first->opcode == cc__vm_const_opcode(width))
+        {
+            first->opcode = CC_VMOPCODE_CONST_JZ_I8 + width;
+            length = 2;
+        }
+        else if (cc__vm_width_of(second->opcode, CC_VMOPCODE_JNZ_I8, &width) && first->opcode == cc__vm_const_opcode(width))
+        {
+            first->opcode = CC_VMOPCODE_CONST_JNZ_I8 + width;
+            length = 2;
+        }
+
+        // Instructions inside of a sequence are not fused again
+        i += length - 1;
+    }
+}
+
+uint8_t cc__vm_unfuse(uint8_t opcode, size_t* length)
+{
+    uint8_t width;
+    uint8_t first_opcode;
+    size_t num_ins = 2;
+
+    if (cc__vm_width_of(opcode, CC_VMOPCODE_ADDRL_LOAD_I8, &width) || cc__vm_width_of(opcode, CC_VMOPCODE_ADDRL_STORE_I8, &width))
+        first_opcode = CC_IR_OPCODE_ADDRL;
+    else if (cc__vm_width_of(opcode, CC_VMOPCODE_DUPE_ADDRL_STORE_I8, &width))
+    {
+        first_opcode = CC_IR_OPCODE_DUPE;
+        num_ins = 3;
+    }
+    else if (cc__vm_width_of(opcode, CC_VMOPCODE_LOADL_CONST_ADD_I8, &width))
+    {
+        first_opcode = CC_VMOPCODE_LOADL_I8 + width;
+        num_ins = 3;
+    }
+    else if (cc__vm_width_of(opcode, CC_VMOPCODE_CONST_JZ_I8, &width) || cc__vm_width_of(opcode, CC_VMOPCODE_CONST_JNZ_I8, &width))
+        first_opcode = cc__vm_const_opcode(width);
+    else if (opcode >= CC_VMOPCODE_ADD_RR_I32 && opcode <= CC_VMOPCODE_XOR_RK_I64)
+    {
+        // Every operation has the RR_I32, RR_I64, RK_I32, and RK_I64 variants in order
+        uint8_t index = (uint8_t)(opcode - CC_VMOPCODE_ADD_RR_I32) % 4;
+        width = 2 + index % 2;
+        first_opcode = index < 2 ? CC_VMOPCODE_LOADL_I8 + width : cc__vm_const_opcode(width);
+        num_ins = 5;
+    }
+    else if (cc__vm_width_of(opcode, CC_VMOPCODE_MOV_R_I8, &width))
+    {
+        first_opcode = CC_VMOPCODE_LOADL_I8 + width;
+        num_ins = 3;
+    }
+    else if (cc__vm_width_of(opcode, CC_VMOPCODE_MOV_K_I8, &width))
+    {
+        first_opcode = cc__vm_const_opcode(width);
+        num_ins = 3;
+    }
+    else if (opcode >= CC_VMOPCODE_JZ_R_I32 && opcode <= CC_VMOPCODE_JNZ_R_I64)
+        first_opcode = CC_VMOPCODE_LOADL_I32 + (opcode - CC_VMOPCODE_JZ_R_I32) % 2;
+    else
+    {
+        first_opcode = opcode;
+        num_ins = 1;
+    }
+
+    if (length)
+        *length = num_ins;
+    return first_opcode;
+}
+
+/// @brief Get the IR opcode that a VM-private opcode was specialized from
+static uint8_t cc__vm_generic_opcode(uint8_t opcode)
+{
+#define CC__VM_WIDTH_CASES(NAME) \
+    case CC_VMOPCODE_##NAME##_I8: case CC_VMOPCODE_##NAME##_I16: case CC_VMOPCODE_##NAME##_I32: case CC_VMOPCODE_##NAME##_I64
+    switch (opcode)
+    {
+    case CC_VMOPCODE_CONST_I8: case CC_VMOPCODE_CONST_I16: case CC_VMOPCODE_CONST_I32:
+    case CC_VMOPCODE_UCONST_I64:    return CC_IR_OPCODE_UCONST;
+    case CC_VMOPCODE_ICONST_I64:    return CC_IR_OPCODE_ICONST;
+    CC__VM_WIDTH_CASES(LOADL):      return CC_IR_OPCODE_LOADL;
+    CC__VM_WIDTH_CASES(LOAD):       return CC_IR_OPCODE_LOAD;
+    CC__VM_WIDTH_CASES(STORE):      return CC_IR_OPCODE_STORE;
+    CC__VM_WIDTH_CASES(ADD):        return CC_IR_OPCODE_ADD;
+    CC__VM_WIDTH_CASES(SUB):        return CC_IR_OPCODE_SUB;
+    CC__VM_WIDTH_CASES(MUL):        return CC_IR_OPCODE_MUL;
+    CC__VM_WIDTH_CASES(DIV):        return CC_IR_OPCODE_DIV;
+    CC__VM_WIDTH_CASES(UDIV):       return CC_IR_OPCODE_UDIV;
+    CC__VM_WIDTH_CASES(MOD):        return CC_IR_OPCODE_MOD;
+    CC__VM_WIDTH_CASES(UMOD):       return CC_IR_OPCODE_UMOD;
+    CC__VM_WIDTH_CASES(NEG):        return CC_IR_OPCODE_NEG;
+    CC__VM_WIDTH_CASES(NOT):        return CC_IR_OPCODE_NOT;
+    CC__VM_WIDTH_CASES(AND):        return CC_IR_OPCODE_AND;
+    CC__VM_WIDTH_CASES(OR):         return CC_IR_OPCODE_OR;
+    CC__VM_WIDTH_CASES(XOR):        return CC_IR_OPCODE_XOR;
+    CC__VM_WIDTH_CASES(LSH):        return CC_IR_OPCODE_LSH;
+    CC__VM_WIDTH_CASES(RSH):        return CC_IR_OPCODE_RSH;
+    CC__VM_WIDTH_CASES(ZEXT):       return CC_IR_OPCODE_ZEXT;
+    CC__VM_WIDTH_CASES(SEXT):       return CC_IR_OPCODE_SEXT;
+    CC__VM_WIDTH_CASES(JZ):         return CC_IR_OPCODE_JZ;
+    CC__VM_WIDTH_CASES(JNZ):        return CC_IR_OPCODE_JNZ;
+    default:                        return opcode;
+    }
+#undef CC__VM_WIDTH_CASES
+}
+
+/// @brief Get the number of bytes popped, then pushed, by a flattened instruction
+/// @return `false` if the effect is unknown, such as for JMP
+static bool cc__vm_stack_effect(const cc_ir_ins* ins, uint32_t* pop, uint32_t* push)
+{
+    *pop = 0;
+    *push = 0;
+    switch (cc__vm_generic_opcode(ins->opcode))
+    {
+    case CC_IR_OPCODE_ARGP:
+    case CC_IR_OPCODE_ADDRL:
+    case CC_IR_OPCODE_ADDRG:
+        *push = sizeof(void*);
+        return true;
+    case CC_IR_OPCODE_LOADL:
+    case CC_IR_OPCODE_ICONST:
+    case CC_IR_OPCODE_UCONST:
+        *push = ins->data_size;
+        return true;
+    case CC_IR_OPCODE_LOAD:
+        *pop = sizeof(void*);
+        *push = ins->data_size;
+        return true;
+    case CC_IR_OPCODE_STORE:
+        *pop = sizeof(void*) + ins->data_size;
+        return true;
+    case CC_IR_OPCODE_DUPE:
+        *pop = ins->data_size;
+        *push = ins->data_size * 2;
+        return true;
+    case CC_IR_OPCODE_FREE:
+    case CC_IR_OPCODE_JZ:
+    case CC_IR_OPCODE_JNZ:
+        *pop = ins->data_size;
+        return true;
+    case CC_IR_OPCODE_ADD: case CC_IR_OPCODE_SUB:
+    case CC_IR_OPCODE_MUL: case CC_IR_OPCODE_UMUL:
+    case CC_IR_OPCODE_DIV: case CC_IR_OPCODE_UDIV:
+    case CC_IR_OPCODE_MOD: case CC_IR_OPCODE_UMOD:
+    case CC_IR_OPCODE_AND: case CC_IR_OPCODE_OR: case CC_IR_OPCODE_XOR:
+    case CC_IR_OPCODE_LSH: case CC_IR_OPCODE_RSH:
+        *pop = ins->data_size * 2;
+        *push = ins->data_size;
+        return true;
+    case CC_IR_OPCODE_NEG:
+    case CC_IR_OPCODE_NOT:
+        *pop = ins->data_size;
+        *push = ins->data_size;
+        return true;
+    case CC_IR_OPCODE_ZEXT:
+    case CC_IR_OPCODE_SEXT:
+        *pop = ins->data_size;
+        *push = ins->operand.extend_data_size;
+        return true;
+    case CC_IR_OPCODE_CALL: // The callee is verified to return with the same stack
+        *pop = sizeof(void*);
+        return true;
+    case CC_IR_OPCODE_RET:
+    case CC_IR_OPCODE_INT:
+    case CC_VMOPCODE_COUNT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool cc__vm_verify_func(cc_ir_ins* ins, size_t num_ins)
+{
+    const uint32_t unvisited = (uint32_t)-1;
+    bool result = false;
+    uint32_t max_depth = 0;
+    // Operand stack depth before every instruction, relative to the frame pointer
+    uint32_t* depths = (uint32_t*)malloc(num_ins * sizeof(depths[0]));
+    size_t* worklist = (size_t*)malloc(num_ins * sizeof(worklist[0]));
+    size_t num_work = 0;
+
+    if (num_ins < 2 || ins[0].opcode != CC_IR_OPCODE_FRAME)
+        goto end;
+    
+    for (size_t i = 0; i < num_ins; ++i)
+        depths[i] = unvisited;
+    depths[1] = 0;
+    worklist[num_work++] = 1;
+
+    while (num_work)
+    {
+        size_t index = worklist[--num_work];
+        const cc_ir_ins* next = &ins[index];
+        uint32_t depth = depths[index];
+        uint32_t pop, push;
+
+        if (!cc__vm_stack_effect(next, &pop, &push) || pop > depth)
+            goto end;
+        depth = depth - pop + push;
+        if (depth > max_depth)
+            max_depth = depth;
+        
+        uint8_t opcode = cc__vm_generic_opcode(next->opcode);
+        if (opcode == CC_IR_OPCODE_RET)
+        {
+            if (depth != 0)
+                goto end;
+            continue;
+        }
+
+        // Every successor must be reached with the same depth
+        size_t successors[2];
+        size_t num_successors = 0;
+        successors[num_successors++] = index + 1;
+        if (opcode == CC_IR_OPCODE_JZ || opcode == CC_IR_OPCODE_JNZ)
+        {
+            int32_t offset = (int32_t)next->operand.u32;
+            if (offset % (int32_t)sizeof(*ins))
+                goto end;
+            successors[num_successors++] = (size_t)((ptrdiff_t)index + 1 + offset / (ptrdiff_t)sizeof(*ins));
+        }
+
+        for (size_t i = 0; i < num_successors; ++i)
+        {
+            size_t successor = successors[i];
+            // Code may not jump to FRAME or outside of the function
+            if (successor == 0 || successor >= num_ins)
+                goto end;
+            if (depths[successor] == unvisited)
+            {
+                depths[successor] = depth;
+                worklist[num_work++] = successor;
+            }
+            else if (depths[successor] != depth)
+                goto end;
+        }
+    }
+
+    if (max_depth > UINT16_MAX)
+        goto end;
+    ins[0].data_size = (cc_ir_datasize)max_depth;
+    result = true;
+
+end:
+    free(depths);
+    free(worklist);
     return result;
 }
 
@@ -853,6 +2267,7 @@ void cc_vmsymbol_create(cc_vmsymbol* vmsymbol, const char* name, size_t name_len
 {
     memset(vmsymbol, 0, sizeof(*vmsymbol));
     vmsymbol->name = cc_strclone_char(name, name_len, &vmsymbol->name_len);
+    vmsymbol->hash = cc_fnv1a_32(vmsymbol->name, vmsymbol->name_len);
 }
 void cc_vmsymbol_destroy(cc_vmsymbol* vmsymbol) {
     free(vmsymbol->name);
@@ -868,6 +2283,8 @@ cc_vmimport* cc_vmimport_create(const char* name, size_t name_len)
     cc_vmimport* vmimport = (cc_vmimport*)calloc(1, sizeof(*vmimport));
     memset(vmimport, 0, sizeof(vmimport));
     vmimport->name = cc_strclone_char(name, name_len, &vmimport->name_len);
+    vmimport->hash = cc_fnv1a_32(vmimport->name, vmimport->name_len);
+    vmimport->symbol_index = UINT32_MAX;
     return vmimport;
 }
 void cc_vmimport_destroy(cc_vmimport* vmimport)
@@ -0,0 +1,439 @@
+#include <cc/lib.h>
+#include <cc/vm.h>
+#include <string.h>
+#include <malloc.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#define CC__VMIMAGE_ALIGN 8
+#define CC__VMIMAGE_BYTE_ORDER 0x01020304
+
+static uint64_t cc__vmimage_align(uint64_t offset) {
+    return (offset + CC__VMIMAGE_ALIGN - 1) & ~(uint64_t)(CC__VMIMAGE_ALIGN - 1);
+}
+/// @brief Write bytes, then pad them to the image alignment
+static bool cc__vmimage_write(cc_stream* stream, uint64_t* offset, const void* data, size_t size)
+{
+    static const uint8_t zeros[CC__VMIMAGE_ALIGN] = { 0 };
+    size_t padding = (size_t)(cc__vmimage_align(*offset + size) - (*offset + size));
+    if (size && cc_stream_write(stream, (const uint8_t*)data, size) != size)
+        return false;
+    if (padding && cc_stream_write(stream, zeros, padding) != padding)
+        return false;
+    *offset += size + padding;
+    return true;
+}
+/// @brief Check that `count` items of `item_size` bytes at `offset` are inside an image of `size` bytes
+static bool cc__vmimage_contains(uint64_t size, uint64_t offset, uint64_t count, uint64_t item_size)
+{
+    if (offset > size)
+        return false;
+    return !item_size || count <= (size - offset) / item_size;
+}
+
+bool cc_vmprogram_write(const cc_vmprogram* program, cc_stream* stream)
+{
+    bool result = false;
+    size_t num_chunks = program->num_ins_chunks;
+    size_t num_imports = 0;
+    for (size_t i = 0; i < num_chunks; ++i)
+        num_imports += program->chunks[i].num_imports;
+
+    cc_vmimage_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "CCVM", sizeof(header.magic));
+    header.version = CC_VMIMAGE_VERSION;
+    header.byte_order = CC__VMIMAGE_BYTE_ORDER;
+    header.ptr_size = sizeof(void*);
+    header.ins_size = sizeof(cc_ir_ins);
+    header.num_chunks = (uint32_t)num_chunks;
+    header.num_symbols = (uint32_t)program->num_symbols;
+    header.num_imports = (uint32_t)num_imports;
+    header.target = (uint8_t)program->target;
+    header.is_verified = program->is_verified;
+
+    cc_vmimage_chunk* chunks = (cc_vmimage_chunk*)calloc(num_chunks ? num_chunks : 1, sizeof(*chunks));
+    cc_vmimage_symbol* symbols = (cc_vmimage_symbol*)calloc(program->num_symbols ? program->num_symbols : 1, sizeof(*symbols));
+    cc_vmimage_import* imports = (cc_vmimage_import*)calloc(num_imports ? num_imports : 1, sizeof(*imports));
+    uint64_t* code_refs = NULL;
+    cc_ir_ins* ins = NULL;
+
+    // Lay out the tables, then the code references, instructions, globals, and names
+    uint64_t offset = cc__vmimage_align(sizeof(header));
+    header.chunks_offset = offset;
+    offset = cc__vmimage_align(offset + num_chunks * sizeof(*chunks));
+    header.symbols_offset = offset;
+    offset = cc__vmimage_align(offset + program->num_symbols * sizeof(*symbols));
+    header.imports_offset = offset;
+    offset = cc__vmimage_align(offset + num_imports * sizeof(*imports));
+
+    size_t import_index = 0;
+    for (size_t i = 0; i < num_chunks; ++i)
+    {
+        const cc_vmchunk* chunk = &program->chunks[i];
+        chunks[i].first_import = import_index;
+        for (size_t j = 0; j < chunk->num_imports; ++j, ++import_index)
+        {
+            imports[import_index].code_refs_offset = offset;
+            offset = cc__vmimage_align(offset + chunk->imports[j]->num_code_refs * sizeof(code_refs[0]));
+        }
+    }
+    for (size_t i = 0; i < num_chunks; ++i)
+    {
+        chunks[i].ins_offset = offset;
+        offset = cc__vmimage_align(offset + program->ins_chunk_lengths[i] * sizeof(cc_ir_ins));
+    }
+    for (size_t i = 0; i < num_chunks; ++i)
+    {
+        chunks[i].global_offset = offset;
+        offset = cc__vmimage_align(offset + program->global_chunk_sizes[i]);
+    }
+
+    // Fill in the tables
+    for (size_t i = 0; i < program->num_symbols; ++i)
+        symbols[i].code_offset = UINT64_MAX; // Unused, until it is found in a chunk
+    import_index = 0;
+    for (size_t i = 0; i < num_chunks; ++i)
+    {
+        const cc_vmchunk* chunk = &program->chunks[i];
+        const uint8_t* chunk_begin = (const uint8_t*)program->ins_chunks[i];
+        chunks[i].num_ins = program->ins_chunk_lengths[i];
+        chunks[i].global_size = program->global_chunk_sizes[i];
+        chunks[i].first_symbol_index = chunk->first_symbol_index;
+        chunks[i].num_symbols = chunk->num_symbols;
+        chunks[i].max_symbols = chunk->max_symbols;
+        chunks[i].num_imports = chunk->num_imports;
+        chunks[i].is_verified = chunk->is_verified;
+
+        for (size_t j = chunk->first_symbol_index; j < chunk->first_symbol_index + chunk->num_symbols; ++j)
+        {
+            const cc_vmsymbol* symbol = &program->symbols[j];
+            symbols[j].name_offset = offset;
+            symbols[j].name_len = symbol->name_len;
+            offset = cc__vmimage_align(offset + symbol->name_len);
+            symbols[j].code_offset = chunks[i].ins_offset + (uint64_t)((const uint8_t*)symbol->ptr - chunk_begin);
+            symbols[j].hash = symbol->hash;
+            symbols[j].next_hashed = symbol->next_hashed;
+            symbols[j].is_first_hashed = cc_hmap32_get_default(&program->symbol_map, symbol->hash, UINT32_MAX) == j;
+        }
+        for (size_t j = 0; j < chunk->num_imports; ++j, ++import_index)
+        {
+            const cc_vmimport* import = chunk->imports[j];
+            imports[import_index].name_offset = offset;
+            imports[import_index].name_len = import->name_len;
+            offset = cc__vmimage_align(offset + import->name_len);
+            imports[import_index].num_code_refs = import->num_code_refs;
+            imports[import_index].hash = import->hash;
+            imports[import_index].symbol_index = import->symbol_index;
+        }
+    }
+    header.size = offset;
+
+    // Write everything in the same order
+    offset = 0;
+    if (!cc__vmimage_write(stream, &offset, &header, sizeof(header))
+        || !cc__vmimage_write(stream, &offset, chunks, num_chunks * sizeof(*chunks))
+        || !cc__vmimage_write(stream, &offset, symbols, program->num_symbols * sizeof(*symbols))
+        || !cc__vmimage_write(stream, &offset, imports, num_imports * sizeof(*imports)))
+        goto end;
+    for (size_t i = 0; i < num_chunks; ++i)
+    {
+        const cc_vmchunk* chunk = &program->chunks[i];
+        const uint8_t* chunk_begin = (const uint8_t*)program->ins_chunks[i];
+        for (size_t j = 0; j < chunk->num_imports; ++j)
+        {
+            // Each reference is an offset in the image, instead of a pointer
+            const cc_vmimport* import = chunk->imports[j];
+            cc_vec_resize(code_refs, import->num_code_refs);
+            for (size_t k = 0; k < import->num_code_refs; ++k)
+                code_refs[k] = chunks[i].ins_offset + (uint64_t)((const uint8_t*)import->code_refs[k] - chunk_begin);
+            if (!cc__vmimage_write(stream, &offset, code_refs, import->num_code_refs * sizeof(code_refs[0])))
+                goto end;
+        }
+    }
+    for (size_t i = 0; i < num_chunks; ++i)
+    {
+        // Native code is not saved, so restore the FRAME instructions it replaced
+        size_t num_ins = program->ins_chunk_lengths[i];
+        cc_vec_resize(ins, num_ins);
+        if (num_ins)
+            memcpy(ins, program->ins_chunks[i], num_ins * sizeof(ins[0]));
+        for (size_t j = 0; j < num_ins; ++j)
+        {
+            if (ins[j].opcode == CC_VMOPCODE_NATIVE)
+                ins[j] = program->natives[ins[j].operand.u32].frame;
+        }
+        if (!cc__vmimage_write(stream, &offset, ins, num_ins * sizeof(ins[0])))
+            goto end;
+    }
+    for (size_t i = 0; i < num_chunks; ++i)
+    {
+        if (!cc__vmimage_write(stream, &offset, program->global_chunks[i], program->global_chunk_sizes[i]))
+            goto end;
+    }
+    for (size_t i = 0; i < num_chunks; ++i)
+    {
+        const cc_vmchunk* chunk = &program->chunks[i];
+        for (size_t j = chunk->first_symbol_index; j < chunk->first_symbol_index + chunk->num_symbols; ++j)
+        {
+            if (!cc__vmimage_write(stream, &offset, program->symbols[j].name, program->symbols[j].name_len))
+                goto end;
+        }
+        for (size_t j = 0; j < chunk->num_imports; ++j)
+        {
+            if (!cc__vmimage_write(stream, &offset, chunk->imports[j]->name, chunk->imports[j]->name_len))
+                goto end;
+        }
+    }
+    result = true;
+
+end:
+    free(chunks);
+    free(symbols);
+    free(imports);
+    free(code_refs);
+    free(ins);
+    return result;
+}
+
+/// @brief Check every table of an image, before anything is created from it
+static bool cc__vmimage_verify(const uint8_t* image, size_t size)
+{
+    const cc_vmimage_header* header = (const cc_vmimage_header*)image;
+    if (size < sizeof(*header) || ((uintptr_t)image % CC__VMIMAGE_ALIGN) || memcmp(header->magic, "CCVM", sizeof(header->magic))
+        || header->version != CC_VMIMAGE_VERSION || header->byte_order != CC__VMIMAGE_BYTE_ORDER
+        || header->ptr_size != sizeof(void*) || header->ins_size != sizeof(cc_ir_ins) || header->size > size)
+        return false;
+
+    uint64_t image_size = header->size;
+    if (header->chunks_offset % CC__VMIMAGE_ALIGN || header->symbols_offset % CC__VMIMAGE_ALIGN || header->imports_offset % CC__VMIMAGE_ALIGN
+        || !cc__vmimage_contains(image_size, header->chunks_offset, header->num_chunks, sizeof(cc_vmimage_chunk))
+        || !cc__vmimage_contains(image_size, header->symbols_offset, header->num_symbols, sizeof(cc_vmimage_symbol))
+        || !cc__vmimage_contains(image_size, header->imports_offset, header->num_imports, sizeof(cc_vmimage_import)))
+        return false;
+
+    const cc_vmimage_chunk* chunks = (const cc_vmimage_chunk*)(image + header->chunks_offset);
+    const cc_vmimage_symbol* symbols = (const cc_vmimage_symbol*)(image + header->symbols_offset);
+    const cc_vmimage_import* imports = (const cc_vmimage_import*)(image + header->imports_offset);
+    for (size_t i = 0; i < header->num_chunks; ++i)
+    {
+        const cc_vmimage_chunk* chunk = &chunks[i];
+        if (chunk->ins_offset % _Alignof(cc_ir_ins)
+            || !cc__vmimage_contains(image_size, chunk->ins_offset, chunk->num_ins, sizeof(cc_ir_ins))
+            || !cc__vmimage_contains(image_size, chunk->global_offset, chunk->global_size, 1)
+            || chunk->num_symbols > chunk->max_symbols || chunk->first_symbol_index > header->num_symbols
+            || chunk->max_symbols > header->num_symbols - chunk->first_symbol_index
+            || chunk->first_import > header->num_imports || chunk->num_imports > header->num_imports - chunk->first_import)
+            return false;
+
+        // A symbol's code is in its chunk, or at the end of it
+        for (size_t j = chunk->first_symbol_index; j < chunk->first_symbol_index + chunk->num_symbols; ++j)
+        {
+            if (symbols[j].code_offset < chunk->ins_offset || symbols[j].code_offset > chunk->ins_offset + chunk->num_ins * sizeof(cc_ir_ins)
+                || (symbols[j].code_offset - chunk->ins_offset) % sizeof(cc_ir_ins))
+                return false;
+        }
+        for (size_t j = chunk->first_import; j < chunk->first_import + chunk->num_imports; ++j)
+        {
+            const cc_vmimage_import* import = &imports[j];
+            if (import->code_refs_offset % CC__VMIMAGE_ALIGN
+                || !cc__vmimage_contains(image_size, import->code_refs_offset, import->num_code_refs, sizeof(uint64_t)))
+                return false;
+            const uint64_t* code_refs = (const uint64_t*)(image + import->code_refs_offset);
+            uint64_t chunk_size = chunk->num_ins * sizeof(cc_ir_ins);
+            for (size_t k = 0; k < import->num_code_refs; ++k)
+            {
+                if (code_refs[k] % _Alignof(cc_ir_symbolid) || code_refs[k] < chunk->ins_offset
+                    || code_refs[k] - chunk->ins_offset >= chunk_size
+                    || chunk_size - (code_refs[k] - chunk->ins_offset) < sizeof(cc_ir_symbolid))
+                    return false;
+            }
+        }
+    }
+    for (size_t i = 0; i < header->num_symbols; ++i)
+    {
+        const cc_vmimage_symbol* symbol = &symbols[i];
+        if (symbol->code_offset == UINT64_MAX)
+            continue;
+        if (!cc__vmimage_contains(image_size, symbol->name_offset, symbol->name_len, 1)
+            || (symbol->next_hashed != UINT32_MAX && symbol->next_hashed >= header->num_symbols))
+            return false;
+    }
+    for (size_t i = 0; i < header->num_imports; ++i)
+    {
+        const cc_vmimage_import* import = &imports[i];
+        if (!cc__vmimage_contains(image_size, import->name_offset, import->name_len, 1)
+            || (import->symbol_index != UINT32_MAX
+                && (import->symbol_index >= header->num_symbols || symbols[import->symbol_index].code_offset == UINT64_MAX)))
+            return false;
+    }
+    return true;
+}
+
+bool cc_vmprogram_load(cc_vmprogram* program, uint8_t* image, size_t size)
+{
+    if (!cc__vmimage_verify(image, size))
+        return false;
+
+    const cc_vmimage_header* header = (const cc_vmimage_header*)image;
+    const cc_vmimage_chunk* chunks = (const cc_vmimage_chunk*)(image + header->chunks_offset);
+    const cc_vmimage_symbol* symbols = (const cc_vmimage_symbol*)(image + header->symbols_offset);
+    const cc_vmimage_import* imports = (const cc_vmimage_import*)(image + header->imports_offset);
+
+    cc_vmprogram_create(program);
+    program->image = image;
+    program->image_size = (size_t)header->size;
+    program->target = (cc_vmtarget)header->target;
+    // Only the table bounds were checked, and the code may have changed since it was verified,
+    // so a loaded program always runs with checks
+    program->is_verified = false;
+
+    // Chunks point into the image
+    size_t num_chunks = header->num_chunks;
+    program->num_ins_chunks = num_chunks;
+    program->num_global_chunks = num_chunks;
+    cc_vec_resize(program->ins_chunks,          num_chunks);
+    cc_vec_resize(program->ins_chunk_lengths,   num_chunks);
+    cc_vec_resize(program->global_chunks,       num_chunks);
+    cc_vec_resize(program->global_chunk_sizes,  num_chunks);
+    cc_vec_resize(program->chunks,              num_chunks);
+    for (size_t i = 0; i < num_chunks; ++i)
+    {
+        const cc_vmimage_chunk* src = &chunks[i];
+        cc_vmchunk* chunk = &program->chunks[i];
+        program->ins_chunks[i] = src->num_ins ? (cc_ir_ins*)(image + src->ins_offset) : NULL;
+        program->ins_chunk_lengths[i] = (size_t)src->num_ins;
+        program->global_chunks[i] = src->global_size ? image + src->global_offset : NULL;
+        program->global_chunk_sizes[i] = (size_t)src->global_size;
+        memset(chunk, 0, sizeof(*chunk));
+        chunk->first_symbol_index = (size_t)src->first_symbol_index;
+        chunk->num_symbols = (size_t)src->num_symbols;
+        chunk->max_symbols = (size_t)src->max_symbols;
+        chunk->is_verified = false;
+    }
+
+    // Symbols are rebuilt, because they own their names and point to code
+    program->num_symbols = header->num_symbols;
+    program->symbols = (cc_vmsymbol*)calloc(program->num_symbols ? program->num_symbols : 1, sizeof(program->symbols[0]));
+    program->tiers = (cc_vmtier*)calloc(program->num_symbols ? program->num_symbols : 1, sizeof(program->tiers[0]));
+    for (size_t i = 0; i < program->num_symbols; ++i)
+    {
+        const cc_vmimage_symbol* src = &symbols[i];
+        cc_vmsymbol* symbol = &program->symbols[i];
+        symbol->next_hashed = UINT32_MAX;
+        if (src->code_offset == UINT64_MAX)
+            continue;
+        cc_vmsymbol_create(symbol, (const char*)image + src->name_offset, (size_t)src->name_len);
+        symbol->ptr = image + src->code_offset;
+        symbol->next_hashed = src->next_hashed;
+        if (src->is_first_hashed)
+            cc_hmap32_put(&program->symbol_map, symbol->hash, (uint32_t)i);
+    }
+
+    // Imports are rebuilt with pointers to their code references
+    for (size_t i = 0; i < num_chunks; ++i)
+    {
+        cc_vmchunk* chunk = &program->chunks[i];
+        chunk->num_imports = (size_t)chunks[i].num_imports;
+        chunk->imports = (cc_vmimport**)malloc((chunk->num_imports ? chunk->num_imports : 1) * sizeof(chunk->imports[0]));
+        for (size_t j = 0; j < chunk->num_imports; ++j)
+        {
+            const cc_vmimage_import* src = &imports[chunks[i].first_import + j];
+            const uint64_t* code_refs = (const uint64_t*)(image + src->code_refs_offset);
+            cc_vmimport* import = cc_vmimport_create((const char*)image + src->name_offset, (size_t)src->name_len);
+            import->num_code_refs = (size_t)src->num_code_refs;
+            cc_vec_resize(import->code_refs, import->num_code_refs);
+            for (size_t k = 0; k < import->num_code_refs; ++k)
+                import->code_refs[k] = (cc_ir_symbolid*)(image + code_refs[k]);
+            chunk->imports[j] = import;
+
+            if (src->symbol_index == UINT32_MAX)
+            {
+                cc__vmprogram_unresolve(program, import);
+                continue;
+            }
+            cc_vmsymbol* symbol = &program->symbols[src->symbol_index];
+            import->symbol_index = src->symbol_index;
+            import->next_import = symbol->first_import;
+            symbol->first_import = import;
+        }
+    }
+    return true;
+}
+
+bool cc_vmprogram_map(cc_vmprogram* program, const char* path)
+{
+#if defined(_WIN32) || defined(__unix__) || defined(__APPLE__)
+  #ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER file_size;
+    HANDLE mapping = NULL;
+    uint8_t* image = NULL;
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+        mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    if (mapping)
+    {
+        // Copy-on-write, so patching code never changes the file
+        image = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+        CloseHandle(mapping);
+    }
+    CloseHandle(file);
+    if (!image)
+        return false;
+    size_t size = (size_t)file_size.QuadPart;
+  #else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat file_stat;
+    void* memory = MAP_FAILED;
+    if (!fstat(fd, &file_stat) && file_stat.st_size > 0)
+    {
+        // Private, so patching code never changes the file
+        memory = mmap(NULL, (size_t)file_stat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (memory == MAP_FAILED)
+        return false;
+    uint8_t* image = (uint8_t*)memory;
+    size_t size = (size_t)file_stat.st_size;
+  #endif
+
+    if (!cc_vmprogram_load(program, image, size))
+    {
+        program->image = image;
+        program->image_size = size;
+        cc__vmprogram_unmap(program);
+        return false;
+    }
+    program->image_size = size;
+    program->is_image_mapped = true;
+    return true;
+#else
+    // No way to map files
+    (void)path;
+    (void)program;
+    return false;
+#endif
+}
+
+void cc__vmprogram_unmap(cc_vmprogram* program)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(program->image);
+#elif defined(__unix__) || defined(__APPLE__)
+    munmap(program->image, program->image_size);
+#endif
+    program->image = NULL;
+    program->image_size = 0;
+    program->is_image_mapped = false;
+}
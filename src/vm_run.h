@@ -0,0 +1,487 @@
+/*
+ * The body of an interpreter function, included by vm.c once for every mode.
+ * The CC__VM_* dispatch and handler macros must already be defined.
+ *
+ * - CC__VM_RUN: The function name
+ * - CC__VM_CHECKED: 1 to check the SP on every push and pop.
+ *   0 to check it only at CALL, RET, and FRAME, which requires a program that passed the verifier.
+ */
+
+size_t CC__VM_RUN(cc_vm* vm, size_t max_steps)
+{
+    size_t steps = 0;
+    const cc_ir_ins* ins;
+    // A copy of a superinstruction's first instruction, when it must be executed alone
+    cc_ir_ins unfused;
+    // The IP and SP are kept in locals, and written back to the VM when execution stops.
+    // Otherwise, every store to the stack could alias `vm` and force them to be reloaded.
+    uint8_t* ip = vm->ip;
+    uint8_t* sp = vm->sp;
+    uint8_t* const stack_begin = vm->stack;
+    uint8_t* const stack_end = vm->stack + vm->stack_size;
+
+    if (vm->vmexception != CC_VMEXCEPTION_NONE)
+        return 0;
+    if (!ip)
+        CC__VM_RAISE(CC_VMEXCEPTION_INVALID_IP);
+    if (sp < stack_begin || sp > stack_end)
+        CC__VM_RAISE(CC_VMEXCEPTION_INVALID_SP);
+
+#if CC_VM_THREADED_DISPATCH
+    // Handler for every opcode, ordered by opcode
+    static const void* const dispatch_table[] =
+    {
+        &&op_ARGP, &&op_ADDRL, &&op_invalid, &&op_LOADL, &&op_ADDRG,
+        &&op_SIZEP,
+        &&op_ICONST, &&op_UCONST, &&op_LOAD, &&op_STORE, &&op_DUPE, &&op_FREE,
+        &&op_ADD, &&op_SUB, &&op_MUL, &&op_UMUL, &&op_DIV, &&op_UDIV, &&op_MOD, &&op_UMOD, &&op_NEG,
+        &&op_NOT, &&op_AND, &&op_OR, &&op_XOR, &&op_LSH, &&op_RSH,
+        &&op_ZEXT, &&op_SEXT,
+        &&op_CALL, &&op_invalid, &&op_JZ, &&op_JNZ, &&op_RET,
+        &&op_INT, &&op_FRAME,
+
+        // VM-private opcodes
+        &&op_VM_CONST_I8, &&op_VM_CONST_I16, &&op_VM_CONST_I32, &&op_VM_ICONST_I64, &&op_VM_UCONST_I64,
+        &&op_VM_LOADL_I8, &&op_VM_LOADL_I16, &&op_VM_LOADL_I32, &&op_VM_LOADL_I64,
+        &&op_VM_LOAD_I8, &&op_VM_LOAD_I16, &&op_VM_LOAD_I32, &&op_VM_LOAD_I64,
+        &&op_VM_STORE_I8, &&op_VM_STORE_I16, &&op_VM_STORE_I32, &&op_VM_STORE_I64,
+        &&op_VM_ADD_I8, &&op_VM_ADD_I16, &&op_VM_ADD_I32, &&op_VM_ADD_I64,
+        &&op_VM_SUB_I8, &&op_VM_SUB_I16, &&op_VM_SUB_I32, &&op_VM_SUB_I64,
+        &&op_VM_MUL_I8, &&op_VM_MUL_I16, &&op_VM_MUL_I32, &&op_VM_MUL_I64,
+        &&op_VM_DIV_I8, &&op_VM_DIV_I16, &&op_VM_DIV_I32, &&op_VM_DIV_I64,
+        &&op_VM_UDIV_I8, &&op_VM_UDIV_I16, &&op_VM_UDIV_I32, &&op_VM_UDIV_I64,
+        &&op_VM_MOD_I8, &&op_VM_MOD_I16, &&op_VM_MOD_I32, &&op_VM_MOD_I64,
+        &&op_VM_UMOD_I8, &&op_VM_UMOD_I16, &&op_VM_UMOD_I32, &&op_VM_UMOD_I64,
+        &&op_VM_NEG_I8, &&op_VM_NEG_I16, &&op_VM_NEG_I32, &&op_VM_NEG_I64,
+        &&op_VM_NOT_I8, &&op_VM_NOT_I16, &&op_VM_NOT_I32, &&op_VM_NOT_I64,
+        &&op_VM_AND_I8, &&op_VM_AND_I16, &&op_VM_AND_I32, &&op_VM_AND_I64,
+        &&op_VM_OR_I8, &&op_VM_OR_I16, &&op_VM_OR_I32, &&op_VM_OR_I64,
+        &&op_VM_XOR_I8, &&op_VM_XOR_I16, &&op_VM_XOR_I32, &&op_VM_XOR_I64,
+        &&op_VM_LSH_I8, &&op_VM_LSH_I16, &&op_VM_LSH_I32, &&op_VM_LSH_I64,
+        &&op_VM_RSH_I8, &&op_VM_RSH_I16, &&op_VM_RSH_I32, &&op_VM_RSH_I64,
+        &&op_VM_ZEXT_I8, &&op_VM_ZEXT_I16, &&op_VM_ZEXT_I32, &&op_VM_ZEXT_I64,
+        &&op_VM_SEXT_I8, &&op_VM_SEXT_I16, &&op_VM_SEXT_I32, &&op_VM_SEXT_I64,
+        &&op_VM_JZ_I8, &&op_VM_JZ_I16, &&op_VM_JZ_I32, &&op_VM_JZ_I64,
+        &&op_VM_JNZ_I8, &&op_VM_JNZ_I16, &&op_VM_JNZ_I32, &&op_VM_JNZ_I64,
+
+        // Superinstructions
+        &&op_VM_ADDRL_LOAD_I8, &&op_VM_ADDRL_LOAD_I16, &&op_VM_ADDRL_LOAD_I32, &&op_VM_ADDRL_LOAD_I64,
+        &&op_VM_ADDRL_STORE_I8, &&op_VM_ADDRL_STORE_I16, &&op_VM_ADDRL_STORE_I32, &&op_VM_ADDRL_STORE_I64,
+        &&op_VM_DUPE_ADDRL_STORE_I8, &&op_VM_DUPE_ADDRL_STORE_I16, &&op_VM_DUPE_ADDRL_STORE_I32, &&op_VM_DUPE_ADDRL_STORE_I64,
+        &&op_VM_LOADL_CONST_ADD_I8, &&op_VM_LOADL_CONST_ADD_I16, &&op_VM_LOADL_CONST_ADD_I32, &&op_VM_LOADL_CONST_ADD_I64,
+        &&op_VM_CONST_JZ_I8, &&op_VM_CONST_JZ_I16, &&op_VM_CONST_JZ_I32, &&op_VM_CONST_JZ_I64,
+        &&op_VM_CONST_JNZ_I8, &&op_VM_CONST_JNZ_I16, &&op_VM_CONST_JNZ_I32, &&op_VM_CONST_JNZ_I64,
+
+        // Three-address instructions
+        &&op_VM_ADD_RR_I32, &&op_VM_ADD_RR_I64, &&op_VM_ADD_RK_I32, &&op_VM_ADD_RK_I64,
+        &&op_VM_SUB_RR_I32, &&op_VM_SUB_RR_I64, &&op_VM_SUB_RK_I32, &&op_VM_SUB_RK_I64,
+        &&op_VM_MUL_RR_I32, &&op_VM_MUL_RR_I64, &&op_VM_MUL_RK_I32, &&op_VM_MUL_RK_I64,
+        &&op_VM_AND_RR_I32, &&op_VM_AND_RR_I64, &&op_VM_AND_RK_I32, &&op_VM_AND_RK_I64,
+        &&op_VM_OR_RR_I32, &&op_VM_OR_RR_I64, &&op_VM_OR_RK_I32, &&op_VM_OR_RK_I64,
+        &&op_VM_XOR_RR_I32, &&op_VM_XOR_RR_I64, &&op_VM_XOR_RK_I32, &&op_VM_XOR_RK_I64,
+        &&op_VM_MOV_R_I8, &&op_VM_MOV_R_I16, &&op_VM_MOV_R_I32, &&op_VM_MOV_R_I64,
+        &&op_VM_MOV_K_I8, &&op_VM_MOV_K_I16, &&op_VM_MOV_K_I32, &&op_VM_MOV_K_I64,
+        &&op_VM_JZ_R_I32, &&op_VM_JZ_R_I64, &&op_VM_JNZ_R_I32, &&op_VM_JNZ_R_I64,
+
+        &&op_VM_NATIVE, &&op_VM_COUNT,
+    };
+    _Static_assert(sizeof(dispatch_table) / sizeof(dispatch_table[0]) == CC_VMOPCODE__COUNT, "Every opcode requires a handler");
+    CC__VM_NEXT();
+#else
+    for (;;)
+    {
+    if (steps == max_steps)
+        goto end;
+    ++steps;
+    // Decode instruction and increment IP
+    ins = (const cc_ir_ins*)ip;
+    ip += sizeof(*ins);
+
+dispatch:
+    switch (ins->opcode)
+    {
+#endif
+    CC__VM_CASE(ARGP):
+    {
+        void* args_pointer = vm->args_pointer;
+        CC__VM_PUSH_VALUE(args_pointer);
+        CC__VM_NEXT();
+    }
+    // Special VM format: u32 is the frame pointer offset
+    CC__VM_CASE(ADDRL):
+    {
+        // Push local's address
+        void* address_of_local = vm->frame_pointer + ins->operand.u32;
+        CC__VM_PUSH_VALUE(address_of_local);
+        CC__VM_NEXT();
+    }
+    // SIZEL is replaced with UCONST at compile-time
+    // Special VM format: u32 is the frame pointer offset, data_size is the size
+    CC__VM_CASE(LOADL):
+    {
+        const void* src = vm->frame_pointer + ins->operand.u32;
+        void* dst;
+        CC__VM_PUSH(dst, ins->data_size);
+        memcpy(dst, src, ins->data_size);
+        CC__VM_NEXT();
+    }
+    CC__VM_CASE(ADDRG):
+    {
+        if (ins->operand.symbolid >= vm->vmprogram->num_symbols)
+            CC__VM_RAISE(CC_VMEXCEPTION_INVALID_SYMBOLID);
+
+        void* address_of_symbol = vm->vmprogram->symbols[ins->operand.symbolid].ptr;
+        CC__VM_PUSH_VALUE(address_of_symbol);
+        CC__VM_NEXT();
+    }
+    CC__VM_CASE(SIZEP):
+    {
+        void* dst;
+        CC__VM_PUSH(dst, ins->data_size);
+        cc_bigint_u32(ins->data_size, dst, sizeof(void*));
+        CC__VM_NEXT();
+    }
+    CC__VM_CASE(ICONST):
+    CC__VM_CASE(UCONST):
+    {
+        uint8_t* write_ptr;
+        CC__VM_PUSH(write_ptr, ins->data_size);
+
+        if (ins->opcode == CC_IR_OPCODE_ICONST)
+            cc_bigint_i32(ins->data_size, write_ptr, (int32_t)ins->operand.u32);
+        else
+            cc_bigint_u32(ins->data_size, write_ptr, ins->operand.u32);
+        CC__VM_NEXT();
+    }
+    CC__VM_CASE(LOAD):
+    {
+        // Pop the source pointer
+        void** src_ptr_on_stack;
+        CC__VM_POP(src_ptr_on_stack, sizeof(void*));
+        const void* src_ptr = *src_ptr_on_stack;
+
+        // Push the source data onto the stack
+        void* dst_ptr;
+        CC__VM_PUSH(dst_ptr, ins->data_size);
+        
+        memcpy(dst_ptr, src_ptr, ins->data_size);
+        CC__VM_NEXT();
+    }
+    CC__VM_CASE(STORE):
+    {
+        // Pop the destination pointer
+        void** dst_ptr_on_stack;
+        CC__VM_POP(dst_ptr_on_stack, sizeof(void*));
+        void* dst_ptr = *dst_ptr_on_stack;
+
+        // Pop value
+        const void* src_ptr;
+        CC__VM_POP(src_ptr, ins->data_size);
+
+        // Store the popped data at the destination
+        memcpy(dst_ptr, src_ptr, ins->data_size);
+        CC__VM_NEXT();
+    }
+    CC__VM_CASE(DUPE):
+    {
+        const void* src = sp;
+        void* dst;
+        CC__VM_PEEK(ins->data_size);
+        CC__VM_PUSH(dst, ins->data_size);
+
+        memcpy(dst, src, ins->data_size);
+        CC__VM_NEXT();
+    }
+    CC__VM_CASE(FREE):
+    {
+        const void* freed;
+        CC__VM_POP(freed, ins->data_size);
+        (void)freed;
+        CC__VM_NEXT();
+    }
+
+    // === Unary operations ===
+
+    CC__VM_CASE(NEG):
+    CC__VM_CASE(NOT):
+    {
+        uint8_t* lhs;
+        CC__VM_PEEK(ins->data_size);
+        lhs = sp;
+        switch (ins->opcode)
+        {
+        case CC_IR_OPCODE_NEG: cc_bigint_neg(ins->data_size, lhs); break;
+        case CC_IR_OPCODE_NOT: cc_bigint_not(ins->data_size, lhs); break;
+        }
+        CC__VM_NEXT();
+    }
+    CC__VM_CASE(ZEXT):
+    CC__VM_CASE(SEXT):
+    {
+        uint8_t* src, * dst;
+        CC__VM_POP(src, ins->data_size);
+        CC__VM_PUSH(dst, ins->operand.extend_data_size);
+
+        if (ins->opcode == CC_IR_OPCODE_ZEXT)
+            cc_bigint_extend_zero(ins->operand.extend_data_size, dst, ins->data_size, src);
+        else
+            cc_bigint_extend_sign(ins->operand.extend_data_size, dst, ins->data_size, src);
+        CC__VM_NEXT();
+    }
+
+
+    // === Binary operations ===
+
+    CC__VM_CASE(ADD):
+    CC__VM_CASE(SUB):
+    CC__VM_CASE(MUL):
+    CC__VM_CASE(UMUL):
+    CC__VM_CASE(DIV):
+    CC__VM_CASE(UDIV):
+    CC__VM_CASE(MOD):
+    CC__VM_CASE(UMOD):
+    CC__VM_CASE(AND):
+    CC__VM_CASE(OR):
+    CC__VM_CASE(XOR):
+    CC__VM_CASE(LSH):
+    CC__VM_CASE(RSH):
+    {
+        uint32_t* lhs, * rhs;
+        CC__VM_POP(lhs, ins->data_size);
+        CC__VM_POP(rhs, ins->data_size);
+
+        const void* result_ptr = lhs;
+        uint8_t _stack_quotient[8], _stack_remainder[8];
+        
+        switch (ins->opcode)
+        {
+        case CC_IR_OPCODE_ADD: cc_bigint_add(ins->data_size, lhs, rhs); break;
+        case CC_IR_OPCODE_SUB: cc_bigint_sub(ins->data_size, lhs, rhs); break;
+        case CC_IR_OPCODE_MUL: cc_bigint_mul(ins->data_size, lhs, rhs); break;
+        case CC_IR_OPCODE_UMUL: cc_bigint_umul(ins->data_size, lhs, rhs); break;
+        case CC_IR_OPCODE_DIV:
+        case CC_IR_OPCODE_UDIV:
+        case CC_IR_OPCODE_MOD:
+        case CC_IR_OPCODE_UMOD:
+        {
+            void* quotient = _stack_quotient, * remainder = _stack_remainder;
+
+            if (cc__vm_is_zero(ins->data_size, rhs))
+            {
+                // Restore the operands
+                sp -= ins->data_size * 2;
+                CC__VM_RAISE(CC_VMEXCEPTION_DIVIDE_BY_ZERO);
+            }
+
+            // Allocate scratch space for the quotient and remainder if required
+            if (ins->data_size > sizeof(_stack_quotient))
+            {
+                size_t required_scratch = ins->data_size * 2;
+                if (required_scratch > vm->scratch_size)
+                {
+                    vm->scratch_size = required_scratch;
+                    vm->scratch = (uint8_t*)realloc(vm->scratch, required_scratch);
+                }
+                quotient = vm->scratch;
+                remainder = vm->scratch + ins->data_size;
+            }
+
+            // Signed operation
+            if (ins->opcode == CC_IR_OPCODE_DIV || ins->opcode == CC_IR_OPCODE_MOD)
+                cc_bigint_div(ins->data_size, lhs, rhs, quotient, remainder);
+            else // Unsigned operation
+                cc_bigint_udiv(ins->data_size, lhs, rhs, quotient, remainder);
+
+            // Point the result to our quotient or remainder
+            result_ptr = quotient;
+            if (ins->opcode == CC_IR_OPCODE_MOD || ins->opcode == CC_IR_OPCODE_UMOD)
+                result_ptr = remainder;
+            break;
+        }
+
+        case CC_IR_OPCODE_AND:  cc_bigint_and(ins->data_size, lhs, rhs); break;
+        case CC_IR_OPCODE_OR:   cc_bigint_or(ins->data_size, lhs, rhs); break;
+        case CC_IR_OPCODE_XOR:  cc_bigint_xor(ins->data_size, lhs, rhs); break;
+        case CC_IR_OPCODE_LSH:  cc_bigint_lsh(ins->data_size, lhs, rhs); break;
+        case CC_IR_OPCODE_RSH:  cc_bigint_rsh(ins->data_size, lhs, rhs); break;
+        }
+
+        void* dst;
+        CC__VM_PUSH(dst, ins->data_size);
+        memcpy(dst, result_ptr, ins->data_size);
+        CC__VM_NEXT();
+    }
+
+    // TODO: Implement JMP
+    // Special VM format: u32 is the signed byte-offset to the block
+    CC__VM_CASE(JZ):
+    CC__VM_CASE(JNZ):
+    {
+        uint8_t* popped;
+        CC__VM_POP(popped, ins->data_size);
+
+        bool is_zero = true;
+        for (cc_ir_datasize i = 0; i < ins->data_size; ++i)
+        {
+            if (popped[i])
+            {
+                is_zero = false;
+                break;
+            }
+        }
+        
+        if (is_zero == (ins->opcode == CC_IR_OPCODE_JZ))
+            ip += (int32_t)ins->operand.u32;
+        CC__VM_NEXT();
+    }
+    CC__VM_CASE(CALL):
+    {
+        uint8_t** target_on_stack;
+        CC__VM_POP(target_on_stack, sizeof(void*));
+        
+        uint8_t* new_ip = *target_on_stack;
+        uint8_t* new_args_pointer = sp;
+
+        // Always checked, because the verifier cannot see past a call
+        // Same layout as pushing the IP, FP, and AP in order
+        uint8_t* saved[3] = { vm->args_pointer, vm->frame_pointer, ip };
+        if ((size_t)(sp - stack_begin) < sizeof(saved))
+            CC__VM_RAISE(CC_VMEXCEPTION_INVALID_SP);
+        sp -= sizeof(saved);
+        memcpy(sp, saved, sizeof(saved));
+
+        ip = new_ip;
+        vm->frame_pointer = sp;
+        vm->args_pointer = new_args_pointer;
+        if (!ip)
+            CC__VM_RAISE(CC_VMEXCEPTION_INVALID_IP);
+        CC__VM_NEXT();
+    }
+    // Special VM format: u32 is the size of the function's frame
+    CC__VM_CASE(RET):
+    {
+        // Always checked, because the verifier cannot see past a call
+        uint8_t* saved[3];
+        if ((size_t)(stack_end - sp) < ins->operand.u32 + sizeof(saved))
+            CC__VM_RAISE(CC_VMEXCEPTION_INVALID_SP);
+        sp += ins->operand.u32;
+        memcpy(saved, sp, sizeof(saved));
+        sp += sizeof(saved);
+
+        vm->args_pointer = saved[0];
+        vm->frame_pointer = saved[1];
+        ip = saved[2];
+        if (!ip)
+            CC__VM_RAISE(CC_VMEXCEPTION_INVALID_IP);
+        CC__VM_NEXT();
+    }
+    CC__VM_CASE(INT):
+        vm->interrupt = ins->operand.u32;
+        CC__VM_RAISE(CC_VMEXCEPTION_INTERRUPT);
+    CC__VM_CASE(FRAME):
+    {
+        // Always checked. In trusted mode, the verifier also stored the function's maximum
+        // operand stack depth in `data_size`, so this is the only overflow check for the rest of the function.
+        size_t reserved = ins->operand.u32;
+        if (!CC__VM_CHECKED)
+            reserved += ins->data_size;
+        if ((size_t)(sp - stack_begin) < reserved)
+            CC__VM_RAISE(CC_VMEXCEPTION_INVALID_SP);
+        sp -= ins->operand.u32;
+        vm->frame_pointer = sp;
+        CC__VM_NEXT();
+    }
+
+    // === VM-private opcodes ===
+
+    CC__VM_CONST(CONST_I8, uint8_t, uint32_t)
+    CC__VM_CONST(CONST_I16, uint16_t, uint32_t)
+    CC__VM_CONST(CONST_I32, uint32_t, uint32_t)
+    CC__VM_CONST(ICONST_I64, uint64_t, int32_t)
+    CC__VM_CONST(UCONST_I64, uint64_t, uint32_t)
+    CC__VM_WIDTHS(CC__VM_LOADL, LOADL)
+    CC__VM_WIDTHS(CC__VM_LOAD, LOAD)
+    CC__VM_WIDTHS(CC__VM_STORE, STORE)
+    CC__VM_WIDTHS(CC__VM_ADD, ADD)
+    CC__VM_WIDTHS(CC__VM_SUB, SUB)
+    CC__VM_WIDTHS(CC__VM_MUL, MUL)
+    CC__VM_WIDTHS(CC__VM_DIV, DIV)
+    CC__VM_WIDTHS(CC__VM_UDIV, UDIV)
+    CC__VM_WIDTHS(CC__VM_MOD, MOD)
+    CC__VM_WIDTHS(CC__VM_UMOD, UMOD)
+    CC__VM_WIDTHS(CC__VM_NEG, NEG)
+    CC__VM_WIDTHS(CC__VM_NOT, NOT)
+    CC__VM_WIDTHS(CC__VM_AND, AND)
+    CC__VM_WIDTHS(CC__VM_OR, OR)
+    CC__VM_WIDTHS(CC__VM_XOR, XOR)
+    CC__VM_WIDTHS(CC__VM_LSH, LSH)
+    CC__VM_WIDTHS(CC__VM_RSH, RSH)
+    CC__VM_WIDTHS(CC__VM_ZEXT, ZEXT)
+    CC__VM_WIDTHS(CC__VM_SEXT, SEXT)
+    CC__VM_WIDTHS(CC__VM_JZ, JZ)
+    CC__VM_WIDTHS(CC__VM_JNZ, JNZ)
+    CC__VM_WIDTHS(CC__VM_ADDRL_LOAD, ADDRL_LOAD)
+    CC__VM_WIDTHS(CC__VM_ADDRL_STORE, ADDRL_STORE)
+    CC__VM_WIDTHS(CC__VM_DUPE_ADDRL_STORE, DUPE_ADDRL_STORE)
+    CC__VM_WIDTHS(CC__VM_LOADL_CONST_ADD, LOADL_CONST_ADD)
+    CC__VM_WIDTHS(CC__VM_CONST_JZ, CONST_JZ)
+    CC__VM_WIDTHS(CC__VM_CONST_JNZ, CONST_JNZ)
+    CC__VM_WIDE_WIDTHS(CC__VM_ADD_RR, ADD_RR)
+    CC__VM_WIDE_WIDTHS(CC__VM_ADD_RK, ADD_RK)
+    CC__VM_WIDE_WIDTHS(CC__VM_SUB_RR, SUB_RR)
+    CC__VM_WIDE_WIDTHS(CC__VM_SUB_RK, SUB_RK)
+    CC__VM_WIDE_WIDTHS(CC__VM_MUL_RR, MUL_RR)
+    CC__VM_WIDE_WIDTHS(CC__VM_MUL_RK, MUL_RK)
+    CC__VM_WIDE_WIDTHS(CC__VM_AND_RR, AND_RR)
+    CC__VM_WIDE_WIDTHS(CC__VM_AND_RK, AND_RK)
+    CC__VM_WIDE_WIDTHS(CC__VM_OR_RR, OR_RR)
+    CC__VM_WIDE_WIDTHS(CC__VM_OR_RK, OR_RK)
+    CC__VM_WIDE_WIDTHS(CC__VM_XOR_RR, XOR_RR)
+    CC__VM_WIDE_WIDTHS(CC__VM_XOR_RK, XOR_RK)
+    CC__VM_WIDTHS(CC__VM_MOV_R, MOV_R)
+    CC__VM_WIDTHS(CC__VM_MOV_K, MOV_K)
+    CC__VM_WIDE_WIDTHS(CC__VM_JZ_R, JZ_R)
+    CC__VM_WIDE_WIDTHS(CC__VM_JNZ_R, JNZ_R)
+
+    // Special VM format: u32 is an index into the program's natives
+    CC__VM_VMCASE(NATIVE):
+    {
+        if (ins->operand.u32 >= vm->vmprogram->num_natives)
+            CC__VM_RAISE(CC_VMEXCEPTION_INVALID_CODE);
+        // The whole function runs in this step, and the native code does not use the VM's stack
+        vm->vmprogram->natives[ins->operand.u32].entry(vm->args_pointer);
+        // No frame was reserved, so there is none to free
+        unfused = *ins;
+        unfused.opcode = CC_IR_OPCODE_RET;
+        unfused.operand.u32 = 0;
+        ins = &unfused;
+        CC__VM_DISPATCH();
+    }
+    // Special VM format: u32 is an index into the program's symbols and tiers
+    CC__VM_VMCASE(COUNT):
+    {
+        if (ins->operand.u32 >= vm->vmprogram->num_symbols)
+            CC__VM_RAISE(CC_VMEXCEPTION_INVALID_CODE);
+        cc_vmtier* tier = &vm->vmprogram->tiers[ins->operand.u32];
+        // Compiling patches the function's code, which is the only write to a running program.
+        // The current activation continues to be interpreted.
+        if (tier->func && ++tier->count >= vm->vmprogram->jit_threshold)
+            cc__vmprogram_tier_up((cc_vmprogram*)vm->vmprogram, ins->operand.u32);
+        CC__VM_NEXT();
+    }
+
+    CC__VM_INVALID:
+        CC__VM_RAISE(CC_VMEXCEPTION_INVALID_CODE);
+#if !CC_VM_THREADED_DISPATCH
+    }
+    }
+#endif
+
+end:
+    vm->ip = ip;
+    vm->sp = sp;
+    return steps;
+}
+
+#undef CC__VM_RUN
+#undef CC__VM_CHECKED
@@ -542,6 +542,125 @@ void x86func_div(x86func* func, uint8_t opsize, x86operand src)
     x86func_modrm(func, src, x86_reg(6));
 }
 
+/**
+ * @brief Internal impl of the binary arithmetic and logic instructions, which share one encoding
+ * @param digit The `/digit` for a constant operand, as defined in the AMD64 manual.
+ * The other opcodes are derived from it: `digit*8 + 1` for `op reg/mem, reg` and `digit*8 + 3` for `op reg, reg/mem`.
+ */
+static void x86func__alu(x86func* func, uint8_t opsize, x86operand dst, x86operand src, uint8_t digit)
+{
+    if (dst.type == X86_OPERAND_CONST)
+        return;
+    
+    if (!x86func_rex_binary(func, opsize, dst, src))
+        return;
+    
+    if (src.type == X86_OPERAND_CONST)
+    {
+        if (opsize == X86_OPSIZE_BYTE)
+        {
+            x86func_imm8(func, 0x80);
+            x86func_modrm(func, dst, x86_reg(digit));
+            x86func_imm8(func, (uint8_t)src.offset);
+        }
+        else if (src.offset < INT8_MIN || src.offset > INT8_MAX)
+        {
+            x86func_imm8(func, 0x81);
+            x86func_modrm(func, dst, x86_reg(digit));
+            uint8_t imm_size = (func->mode == X86_MODE_REAL || opsize == X86_OPSIZE_WORD) ? 2 : 4;
+            x86func_imm(func, src.offset, imm_size, &func->rhs_imm);
+        }
+        else
+        {
+            x86func_imm8(func, 0x83);
+            x86func_modrm(func, dst, x86_reg(digit));
+            x86func_imm8(func, (uint8_t)src.offset);
+        }
+    }
+    else if (src.type == X86_OPERAND_REG)
+    {
+        x86func_imm8(func, digit * 8 + (opsize == X86_OPSIZE_BYTE ? 0 : 1));
+        x86func_modrm(func, dst, src);
+    }
+    else
+    {
+        x86func_imm8(func, digit * 8 + (opsize == X86_OPSIZE_BYTE ? 2 : 3));
+        x86func_modrm(func, dst, src);
+    }
+}
+void x86func_and(x86func* func, uint8_t opsize, x86operand dst, x86operand src) {
+    x86func__alu(func, opsize, dst, src, 4);
+}
+void x86func_or(x86func* func, uint8_t opsize, x86operand dst, x86operand src) {
+    x86func__alu(func, opsize, dst, src, 1);
+}
+void x86func_xor(x86func* func, uint8_t opsize, x86operand dst, x86operand src) {
+    x86func__alu(func, opsize, dst, src, 6);
+}
+
+void x86func_neg(x86func* func, uint8_t opsize, x86operand dst)
+{
+    if (dst.type == X86_OPERAND_CONST)
+        return;
+    if (!x86func_rex_binary(func, opsize, dst, x86_reg(3)))
+        return;
+    x86func_imm8(func, opsize == X86_OPSIZE_BYTE ? 0xF6 : 0xF7);
+    x86func_modrm(func, dst, x86_reg(3));
+}
+void x86func_not(x86func* func, uint8_t opsize, x86operand dst)
+{
+    if (dst.type == X86_OPERAND_CONST)
+        return;
+    if (!x86func_rex_binary(func, opsize, dst, x86_reg(2)))
+        return;
+    x86func_imm8(func, opsize == X86_OPSIZE_BYTE ? 0xF6 : 0xF7);
+    x86func_modrm(func, dst, x86_reg(2));
+}
+
+/**
+ * @brief Internal shift impl
+ * @param count A constant, or the register C (which shifts by CL)
+ * @param digit The `/digit` number, as defined in the AMD64 manual
+ */
+static void x86func__shift(x86func* func, uint8_t opsize, x86operand dst, x86operand count, uint8_t digit)
+{
+    if (dst.type == X86_OPERAND_CONST)
+        return;
+    if (count.type == X86_OPERAND_REG && count.reg != X86_REG_C)
+        return; // Only CL can be used as a count
+    if (count.type != X86_OPERAND_REG && count.type != X86_OPERAND_CONST)
+        return;
+    if (!x86func_rex_binary(func, opsize, dst, x86_reg(digit)))
+        return;
+
+    bool is_byte = opsize == X86_OPSIZE_BYTE;
+    if (count.type == X86_OPERAND_REG)
+    {
+        x86func_imm8(func, is_byte ? 0xD2 : 0xD3);
+        x86func_modrm(func, dst, x86_reg(digit));
+    }
+    else if (count.offset == 1)
+    {
+        x86func_imm8(func, is_byte ? 0xD0 : 0xD1);
+        x86func_modrm(func, dst, x86_reg(digit));
+    }
+    else
+    {
+        x86func_imm8(func, is_byte ? 0xC0 : 0xC1);
+        x86func_modrm(func, dst, x86_reg(digit));
+        x86func_imm8(func, (uint8_t)count.offset);
+    }
+}
+void x86func_shl(x86func* func, uint8_t opsize, x86operand dst, x86operand count) {
+    x86func__shift(func, opsize, dst, count, 4);
+}
+void x86func_shr(x86func* func, uint8_t opsize, x86operand dst, x86operand count) {
+    x86func__shift(func, opsize, dst, count, 5);
+}
+void x86func_sar(x86func* func, uint8_t opsize, x86operand dst, x86operand count) {
+    x86func__shift(func, opsize, dst, count, 7);
+}
+
 void x86func_cmp(x86func* func, uint8_t opsize, x86operand lhs, x86operand rhs)
 {
     if (lhs.type == X86_OPERAND_CONST)
@@ -620,6 +739,18 @@ void x86func_mov(x86func* func, uint8_t opsize, x86operand dst, x86operand src)
     }
 }
 
+void x86func_lea(x86func* func, uint8_t opsize, uint8_t dst, x86operand src)
+{
+    if (src.type != X86_OPERAND_MEM && src.type != X86_OPERAND_OFFSET)
+        return;
+    if (opsize == X86_OPSIZE_BYTE)
+        return;
+    if (!x86func_rex_binary(func, opsize, src, x86_reg(dst)))
+        return;
+    x86func_imm8(func, 0x8D);
+    x86func_modrm(func, src, x86_reg(dst));
+}
+
 /// @brief Interal jmp impl
 /// @param offset Offset relative to the end of the instruction
 static void x86func__jmp(x86func* func, int32_t offset)
@@ -655,9 +786,9 @@ static void x86func__jmp_simpler(x86func* func, int32_t offset)
         post_offset = offset - ins_size;
         func->writepos = func->lhs_imm.offset;
         if (func->lhs_imm.size == 2)
-            x86func_imm16(func, (uint16_t)offset);
+            x86func_imm16(func, (uint16_t)post_offset);
         else
-            x86func_imm32(func, (uint32_t)offset);
+            x86func_imm32(func, (uint32_t)post_offset);
     }
 }
 
@@ -710,9 +841,9 @@ static void x86func__jcc_simpler(x86func* func, int32_t offset, uint8_t nibble)
         post_offset = offset - ins_size;
         func->writepos = func->lhs_imm.offset;
         if (func->lhs_imm.size == 2)
-            x86func_imm16(func, (uint16_t)offset);
+            x86func_imm16(func, (uint16_t)post_offset);
         else
-            x86func_imm32(func, (uint32_t)offset);
+            x86func_imm32(func, (uint32_t)post_offset);
     }
 }
 
@@ -19,6 +19,8 @@ const x86conv X86_CONV_WIN64_FASTCALL =
     32,    // stack_preargs
     0,     // stack_postargs
     false, // noreturn
+    { X86_REG_C, X86_REG_D, X86_REG_R8, X86_REG_R9 }, // int_args
+    4,     // num_int_args
 };
 const x86conv X86_CONV_SYSV64_CDECL =
 {
@@ -38,4 +40,765 @@ const x86conv X86_CONV_SYSV64_CDECL =
     0,     // stack_preargs
     0,     // stack_postargs
     false, // noreturn
+    { X86_REG_DI, X86_REG_SI, X86_REG_D, X86_REG_C, X86_REG_R8, X86_REG_R9 }, // int_args
+    6,     // num_int_args
 };
+
+/// @brief Size of a local in the stack frame. Functions and blocks have no size.
+static uint32_t x86gen__local_size(const x86gen* gen, const cc_ir_local* local)
+{
+    switch (local->typeid)
+    {
+    case CC_IR_TYPEID_INT:
+    case CC_IR_TYPEID_FLOAT:
+    case CC_IR_TYPEID_DATA:
+        return local->data_size;
+    case CC_IR_TYPEID_PTR:  return x86_ptrsize(gen->mode);
+    default:                return 0;
+    }
+}
+
+/// @brief Get the operand size for a value of `size` bytes
+/// @return A value from @ref x86_opsize, or @ref X86_OPSIZE_DEFAULT if no register has that size
+static uint8_t x86gen__opsize(uint32_t size)
+{
+    switch (size)
+    {
+    case 1: return X86_OPSIZE_BYTE;
+    case 2: return X86_OPSIZE_WORD;
+    case 4: return X86_OPSIZE_DWORD;
+    case 8: return X86_OPSIZE_QWORD;
+    default: return X86_OPSIZE_DEFAULT;
+    }
+}
+
+void x86gen_create(x86gen* gen, const x86conv* conv, const cc_ir_func* irfunc)
+{
+    memset(gen, 0, sizeof(*gen));
+    gen->mode = X86_MODE_LONG;
+    gen->conv = conv;
+    cc_hmap32_create(&gen->map_blocks);
+    cc_hmap32_create(&gen->map_locals);
+    cc_hmap32_create(&gen->map_registers);
+
+    gen->irfunc = (cc_ir_func*)malloc(sizeof(*gen->irfunc));
+    x86gen_simplify(gen, irfunc, gen->irfunc);
+}
+void x86gen_destroy(x86gen* gen)
+{
+    cc_ir_func_destroy(gen->irfunc);
+    cc_hmap32_destroy(&gen->map_blocks);
+    cc_hmap32_destroy(&gen->map_locals);
+    cc_hmap32_destroy(&gen->map_registers);
+}
+
+void x86gen_simplify(const x86gen* gen, const cc_ir_func* input, cc_ir_func* output)
+{
+    uint8_t ptrsize = x86_ptrsize(gen->mode);
+    cc_ir_func_clone(input, output);
+
+    // - Replace 0 with the pointer size in `data_size` and `extend_data_size` operands
+    // - Replace size instructions with the uconst instruction
+    for (cc_ir_block* block = output->entry_block; block; block = block->next_block)
+    {
+        for (size_t i = 0; i < block->num_ins; ++i)
+        {
+            cc_ir_ins* ins = &block->ins[i];
+            if (ins->data_size == 0)
+                ins->data_size = ptrsize;
+            
+            switch (ins->opcode)
+            {
+            case CC_IR_OPCODE_SIZEP:
+                ins->opcode = CC_IR_OPCODE_UCONST;
+                ins->operand.u32 = ptrsize;
+                break;
+            case CC_IR_OPCODE_SIZEL:
+                ins->opcode = CC_IR_OPCODE_UCONST;
+                ins->operand.u32 = x86gen__local_size(gen, cc_ir_func_getlocal(output, ins->operand.local));
+                break;
+            case CC_IR_OPCODE_ZEXT:
+            case CC_IR_OPCODE_SEXT:
+                if (ins->operand.extend_data_size == 0)
+                    ins->operand.extend_data_size = ptrsize;
+                break;
+            }
+        }
+    }
+}
+
+/// @brief The size of every value on the operand stack, from bottom to top
+typedef struct x86gen__values
+{
+    uint8_t* sizes;
+    size_t num_sizes;
+} x86gen__values;
+
+static void x86gen__push_value(x86gen__values* values, uint32_t size)
+{
+    ++values->num_sizes;
+    uint8_t* value = (uint8_t*)cc_vec_resize(values->sizes, values->num_sizes);
+    *value = (uint8_t)size;
+}
+/**
+ * @brief Count the values on top of the stack that make up exactly `num_bytes`
+ * @return False if the bytes would split a value, or if there are too few values
+ */
+static bool x86gen__count_values(const x86gen__values* values, uint32_t num_bytes, size_t* out_count)
+{
+    size_t count = 0;
+    while (num_bytes)
+    {
+        if (count == values->num_sizes || values->sizes[values->num_sizes - 1 - count] > num_bytes)
+            return false;
+        num_bytes -= values->sizes[values->num_sizes - 1 - count];
+        ++count;
+    }
+    *out_count = count;
+    return true;
+}
+/// @brief Pop one value of `size` bytes
+/// @return False if the value on top of the stack has a different size
+static bool x86gen__pop_value(x86gen__values* values, uint32_t size)
+{
+    if (!values->num_sizes || values->sizes[values->num_sizes - 1] != size)
+        return false;
+    --values->num_sizes;
+    return true;
+}
+
+/// @brief Restore the callee-saved registers and return
+static void x86gen__epilogue(x86gen* gen)
+{
+    x86func* func = gen->func;
+    for (uint8_t reg = 0; reg < X86_NUM_REGISTERS; ++reg)
+    {
+        if (gen->save_offsets[reg])
+            x86func_mov(func, X86_OPSIZE_QWORD, x86_reg(reg), x86_index(X86_REG_BP, X86_REG_SP, X86_SIB_SCALE_1, gen->save_offsets[reg]));
+    }
+    x86func_mov(func, X86_OPSIZE_QWORD, x86_reg(X86_REG_B), x86_index(X86_REG_BP, X86_REG_SP, X86_SIB_SCALE_1, -8));
+    x86func_mov(func, X86_OPSIZE_QWORD, x86_reg(X86_REG_SP), x86_reg(X86_REG_BP));
+    x86func_pop(func, 0, x86_reg(X86_REG_BP));
+    x86func_ret(func);
+}
+
+/// @brief Get the location of a local, which is a register or a slot in the frame
+static bool x86gen__local(const x86gen* gen, cc_ir_localid localid, x86operand* out_operand)
+{
+    uint32_t value;
+    if (cc_hmap32_get(&gen->map_registers, localid, &value))
+    {
+        *out_operand = x86_reg((uint8_t)value);
+        return true;
+    }
+    if (!cc_hmap32_get(&gen->map_locals, localid, &value))
+        return false;
+    *out_operand = x86_index(X86_REG_BP, X86_REG_SP, X86_SIB_SCALE_1, (int32_t)value);
+    return true;
+}
+
+/// @brief Get the location of the operand stack value at `depth`, counting from the bottom
+static x86operand x86gen__value(const x86gen* gen, size_t depth)
+{
+    if (depth < gen->num_value_registers)
+        return x86_reg(gen->value_registers[depth]);
+    int32_t offset = gen->values_offset - (int32_t)(depth - gen->num_value_registers) * 8;
+    return x86_index(X86_REG_BP, X86_REG_SP, X86_SIB_SCALE_1, offset);
+}
+
+/// @brief Copy a whole 8-byte location, through A if both are in memory
+static void x86gen__move(x86gen* gen, x86operand dst, x86operand src)
+{
+    if (dst.type == X86_OPERAND_REG && src.type == X86_OPERAND_REG && dst.reg == src.reg)
+        return;
+    if (dst.type != X86_OPERAND_REG && src.type != X86_OPERAND_REG && src.type != X86_OPERAND_CONST)
+    {
+        x86func_mov(gen->func, X86_OPSIZE_QWORD, x86_reg(X86_REG_A), src);
+        src = x86_reg(X86_REG_A);
+    }
+    x86func_mov(gen->func, X86_OPSIZE_QWORD, dst, src);
+}
+
+/// @brief Get a location as a register, loading it into `scratch` if it is in memory
+static x86operand x86gen__reg(x86gen* gen, x86operand operand, uint8_t scratch)
+{
+    if (operand.type == X86_OPERAND_REG)
+        return operand;
+    x86func_mov(gen->func, X86_OPSIZE_QWORD, x86_reg(scratch), operand);
+    return x86_reg(scratch);
+}
+
+/// @brief Get a location that may be used with `opsize`.
+/// Without a REX prefix, the low bytes of SP, BP, SI, and DI are not addressable, so they are copied to `scratch`.
+static x86operand x86gen__sized(x86gen* gen, uint8_t opsize, x86operand operand, uint8_t scratch)
+{
+    if (opsize != X86_OPSIZE_BYTE || operand.type != X86_OPERAND_REG || operand.reg < X86_REG_SP || operand.reg > X86_REG_DI)
+        return operand;
+    x86func_mov(gen->func, X86_OPSIZE_QWORD, x86_reg(scratch), operand);
+    return x86_reg(scratch);
+}
+
+/// @brief Check if the instruction at `i` is `ADDRL x; STORE` with the size of `x`, which does not take its address
+static bool x86gen__is_local_store(const x86gen* gen, const cc_ir_block* block, size_t i)
+{
+    const cc_ir_ins* ins = &block->ins[i];
+    if (ins->opcode != CC_IR_OPCODE_ADDRL || i + 1 >= block->num_ins || block->ins[i + 1].opcode != CC_IR_OPCODE_STORE)
+        return false;
+    const cc_ir_local* local = cc_ir_func_getlocal(gen->irfunc, ins->operand.local);
+    return local && block->ins[i + 1].data_size == x86gen__local_size(gen, local);
+}
+
+/**
+ * @brief Emit the template for one instruction, or for a sequence which is lowered together
+ * @param num_ins The number of instructions remaining in the block, including `ins`
+ * @return The number of instructions emitted, or 0 if the instruction is not supported
+ */
+static size_t x86gen__ins(x86gen* gen, const cc_ir_ins* ins, size_t num_ins, x86gen__values* values)
+{
+    x86func* func = gen->func;
+    const x86operand rax = x86_reg(X86_REG_A);
+    const uint32_t ptrsize = x86_ptrsize(gen->mode);
+    const size_t depth = values->num_sizes;
+    uint32_t size = ins->data_size;
+    uint8_t opsize = x86gen__opsize(size);
+    x86operand local, top, lhs, src;
+    size_t count;
+    uint32_t label;
+
+    switch (ins->opcode)
+    {
+    case CC_IR_OPCODE_ARGP:
+        x86gen__move(gen, x86gen__value(gen, depth), x86_reg(X86_REG_B));
+        x86gen__push_value(values, ptrsize);
+        return 1;
+    case CC_IR_OPCODE_ADDRL:
+        if (!x86gen__local(gen, ins->operand.local, &local))
+            return 0;
+        // `ADDRL x; STORE` stores directly to x
+        if (num_ins > 1 && ins[1].opcode == CC_IR_OPCODE_STORE)
+        {
+            size = ins[1].data_size;
+            opsize = x86gen__opsize(size);
+            if (opsize == X86_OPSIZE_DEFAULT || !x86gen__pop_value(values, size))
+                return 0;
+            src = x86gen__value(gen, depth - 1);
+            if (local.type == X86_OPERAND_REG)
+                x86gen__move(gen, local, src);
+            else
+                x86func_mov(func, opsize, local, x86gen__sized(gen, opsize, x86gen__reg(gen, src, X86_REG_C), X86_REG_C));
+            return 2;
+        }
+        if (local.type == X86_OPERAND_REG)
+            return 0; // The local's address is never taken, so this is a bug in the allocator
+        top = x86gen__value(gen, depth);
+        x86func_lea(func, X86_OPSIZE_QWORD, top.type == X86_OPERAND_REG ? top.reg : X86_REG_A, local);
+        if (top.type != X86_OPERAND_REG)
+            x86func_mov(func, X86_OPSIZE_QWORD, top, rax);
+        x86gen__push_value(values, ptrsize);
+        return 1;
+    case CC_IR_OPCODE_LOADL:
+        size = x86gen__local_size(gen, cc_ir_func_getlocal(gen->irfunc, ins->operand.local));
+        opsize = x86gen__opsize(size);
+        if (opsize == X86_OPSIZE_DEFAULT || !x86gen__local(gen, ins->operand.local, &local))
+            return 0;
+        top = x86gen__value(gen, depth);
+        if (local.type == X86_OPERAND_REG)
+            x86gen__move(gen, top, local);
+        else if (top.type == X86_OPERAND_REG && opsize >= X86_OPSIZE_DWORD)
+            x86func_mov(func, opsize, top, local);
+        else
+        {
+            x86func_mov(func, opsize, rax, local);
+            x86gen__move(gen, top, rax);
+        }
+        x86gen__push_value(values, size);
+        return 1;
+    case CC_IR_OPCODE_ICONST:
+    case CC_IR_OPCODE_UCONST:
+        if (opsize == X86_OPSIZE_DEFAULT)
+            return 0;
+        top = x86gen__value(gen, depth);
+        // An imm32 is sign-extended, so a large unsigned value is zero-extended by a 32-bit move instead
+        if (ins->opcode == CC_IR_OPCODE_UCONST && opsize == X86_OPSIZE_QWORD && ins->operand.u32 > INT32_MAX)
+        {
+            x86operand dst = top.type == X86_OPERAND_REG ? top : rax;
+            x86func_mov(func, X86_OPSIZE_DWORD, dst, x86_const((int32_t)ins->operand.u32));
+            x86gen__move(gen, top, dst);
+        }
+        else
+            x86func_mov(func, X86_OPSIZE_QWORD, top, x86_const((int32_t)ins->operand.u32));
+        x86gen__push_value(values, size);
+        return 1;
+    case CC_IR_OPCODE_LOAD:
+        if (opsize == X86_OPSIZE_DEFAULT || !x86gen__pop_value(values, ptrsize))
+            return 0;
+        top = x86gen__value(gen, depth - 1);
+        src = x86_deref(x86gen__reg(gen, top, X86_REG_A).reg);
+        if (top.type == X86_OPERAND_REG && x86gen__sized(gen, opsize, top, X86_REG_A).reg == top.reg)
+            x86func_mov(func, opsize, top, src);
+        else
+        {
+            x86func_mov(func, opsize, rax, src);
+            x86gen__move(gen, top, rax);
+        }
+        x86gen__push_value(values, size);
+        return 1;
+    case CC_IR_OPCODE_STORE:
+        if (opsize == X86_OPSIZE_DEFAULT || !x86gen__pop_value(values, ptrsize) || !x86gen__pop_value(values, size))
+            return 0;
+        {
+            x86operand pointer = x86gen__reg(gen, x86gen__value(gen, depth - 1), X86_REG_A);
+            src = x86gen__reg(gen, x86gen__value(gen, depth - 2), X86_REG_C);
+            x86func_mov(func, opsize, x86_deref(pointer.reg), x86gen__sized(gen, opsize, src, X86_REG_C));
+        }
+        return 1;
+    case CC_IR_OPCODE_DUPE:
+        if (!x86gen__count_values(values, ins->data_size, &count))
+            return 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            x86gen__move(gen, x86gen__value(gen, depth + i), x86gen__value(gen, depth - count + i));
+            x86gen__push_value(values, values->sizes[depth - count + i]);
+        }
+        return 1;
+    case CC_IR_OPCODE_FREE:
+        if (!x86gen__count_values(values, ins->data_size, &count))
+            return 0;
+        values->num_sizes -= count;
+        return 1;
+    
+    // Arithmetic is done on whole locations, because the lower bytes of the result are the same.
+    // The lhs is on top, and the result replaces the rhs.
+    
+    case CC_IR_OPCODE_ADD:
+    case CC_IR_OPCODE_SUB:
+    case CC_IR_OPCODE_MUL:
+    case CC_IR_OPCODE_UMUL:
+    case CC_IR_OPCODE_AND:
+    case CC_IR_OPCODE_OR:
+    case CC_IR_OPCODE_XOR:
+        if (!x86gen__pop_value(values, size) || !x86gen__pop_value(values, size))
+            return 0;
+        lhs = x86gen__value(gen, depth - 1);
+        top = x86gen__value(gen, depth - 2);
+        switch (ins->opcode)
+        {
+        case CC_IR_OPCODE_SUB:
+            x86func_mov(func, X86_OPSIZE_QWORD, rax, lhs);
+            x86func_sub(func, X86_OPSIZE_QWORD, rax, top);
+            x86func_mov(func, X86_OPSIZE_QWORD, top, rax);
+            break;
+        case CC_IR_OPCODE_MUL:
+        case CC_IR_OPCODE_UMUL:
+            if (top.type == X86_OPERAND_REG)
+                x86func_imul2(func, X86_OPSIZE_QWORD, top.reg, lhs);
+            else
+            {
+                x86func_mov(func, X86_OPSIZE_QWORD, rax, lhs);
+                x86func_imul2(func, X86_OPSIZE_QWORD, X86_REG_A, top);
+                x86func_mov(func, X86_OPSIZE_QWORD, top, rax);
+            }
+            break;
+        default:
+            if (top.type != X86_OPERAND_REG)
+                lhs = x86gen__reg(gen, lhs, X86_REG_A);
+            switch (ins->opcode)
+            {
+            case CC_IR_OPCODE_ADD: x86func_add(func, X86_OPSIZE_QWORD, top, lhs); break;
+            case CC_IR_OPCODE_AND: x86func_and(func, X86_OPSIZE_QWORD, top, lhs); break;
+            case CC_IR_OPCODE_OR:  x86func_or(func, X86_OPSIZE_QWORD, top, lhs); break;
+            default:               x86func_xor(func, X86_OPSIZE_QWORD, top, lhs); break;
+            }
+            break;
+        }
+        x86gen__push_value(values, size);
+        return 1;
+    case CC_IR_OPCODE_NEG:
+    case CC_IR_OPCODE_NOT:
+        if (!x86gen__pop_value(values, size))
+            return 0;
+        top = x86gen__value(gen, depth - 1);
+        if (ins->opcode == CC_IR_OPCODE_NEG)
+            x86func_neg(func, X86_OPSIZE_QWORD, top);
+        else
+            x86func_not(func, X86_OPSIZE_QWORD, top);
+        x86gen__push_value(values, size);
+        return 1;
+    case CC_IR_OPCODE_ZEXT:
+    case CC_IR_OPCODE_SEXT:
+    {
+        uint32_t extend_size = ins->operand.extend_data_size;
+        if (opsize == X86_OPSIZE_DEFAULT || x86gen__opsize(extend_size) == X86_OPSIZE_DEFAULT || !x86gen__pop_value(values, size))
+            return 0;
+        top = x86gen__value(gen, depth - 1);
+        // Truncating does nothing, because the upper bytes are ignored
+        if (extend_size > size && ins->opcode == CC_IR_OPCODE_ZEXT && size == 4 && top.type == X86_OPERAND_REG)
+            x86func_mov(func, X86_OPSIZE_DWORD, top, top); // Writing a 32-bit register clears the upper bytes
+        else if (extend_size > size)
+        {
+            x86operand bits = x86_const(64 - (int32_t)size * 8);
+            x86operand reg = x86gen__reg(gen, top, X86_REG_A);
+            x86func_shl(func, X86_OPSIZE_QWORD, reg, bits);
+            if (ins->opcode == CC_IR_OPCODE_ZEXT)
+                x86func_shr(func, X86_OPSIZE_QWORD, reg, bits);
+            else
+                x86func_sar(func, X86_OPSIZE_QWORD, reg, bits);
+            x86gen__move(gen, top, reg);
+        }
+        x86gen__push_value(values, extend_size);
+        return 1;
+    }
+    case CC_IR_OPCODE_JZ:
+    case CC_IR_OPCODE_JNZ:
+        if (opsize == X86_OPSIZE_DEFAULT || !x86gen__pop_value(values, size) || values->num_sizes)
+            return 0;
+        if (!cc_hmap32_get(&gen->map_blocks, ins->operand.blockid, &label))
+            return 0;
+        x86func_cmp(func, opsize, x86gen__sized(gen, opsize, x86gen__value(gen, depth - 1), X86_REG_A), x86_const(0));
+        if (ins->opcode == CC_IR_OPCODE_JZ)
+            x86func_jz(func, (x86label)label);
+        else
+            x86func_jnz(func, (x86label)label);
+        return 1;
+    case CC_IR_OPCODE_RET:
+        x86gen__epilogue(gen);
+        values->num_sizes = 0;
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief Emit every block
+ * @param out_max_depth Stores the maximum number of values on the operand stack
+ * @return False if the function uses something that is not supported
+ */
+static bool x86gen__blocks(x86gen* gen, size_t* out_max_depth)
+{
+    x86gen__values values = { NULL, 0 };
+    size_t max_depth = 0;
+    bool result = false;
+
+    for (const cc_ir_block* block = gen->irfunc->entry_block; block; block = block->next_block)
+    {
+        // Values are not tracked across jumps, so blocks must start with an empty stack
+        if (values.num_sizes)
+            goto end;
+        x86func_label(gen->func, (x86label)cc_hmap32_get_default(&gen->map_blocks, block->blockid, 0));
+
+        for (size_t i = 0; i < block->num_ins;)
+        {
+            size_t length = x86gen__ins(gen, &block->ins[i], block->num_ins - i, &values);
+            if (!length)
+                goto end;
+            i += length;
+            if (values.num_sizes > max_depth)
+                max_depth = values.num_sizes;
+        }
+    }
+    // Falling through the last block returns
+    x86gen__epilogue(gen);
+    *out_max_depth = max_depth;
+    result = true;
+
+end:
+    free(values.sizes);
+    return result;
+}
+
+/// @brief The live interval of a local, in the order that instructions are emitted
+typedef struct x86gen__interval
+{
+    cc_ir_localid localid;
+    size_t start;
+    size_t end;
+    /// @brief The assigned register, or @ref X86_NUM_REGISTERS if the local is in memory
+    uint8_t reg;
+} x86gen__interval;
+
+static int x86gen__compare_intervals(const void* lhs, const void* rhs)
+{
+    const x86gen__interval* a = (const x86gen__interval*)lhs;
+    const x86gen__interval* b = (const x86gen__interval*)rhs;
+    if (a->start != b->start)
+        return a->start < b->start ? -1 : 1;
+    return a->localid < b->localid ? -1 : a->localid > b->localid;
+}
+
+/**
+ * @brief Assign registers to the operand stack and to locals with linear scan.
+ * Locals without a register are written to `map_locals` by @ref x86gen_dump.
+ * @param max_depth The maximum number of values on the operand stack
+ */
+static void x86gen__allocate(x86gen* gen, size_t max_depth)
+{
+    const cc_ir_func* irfunc = gen->irfunc;
+    const x86conv* conv = gen->conv;
+
+    // Volatile registers come first, because they are free to use in a leaf function.
+    // A and C are reserved for templates, and B holds the args pointer.
+    uint8_t pool[X86_NUM_REGISTERS];
+    size_t num_pool = 0;
+    for (int is_volatile = 1; is_volatile >= 0; --is_volatile)
+    {
+        for (uint8_t reg = X86_REG_A; reg <= X86_REG_R15; ++reg)
+        {
+            if (reg == X86_REG_A || reg == X86_REG_C || reg == X86_REG_B || reg == X86_REG_SP || reg == X86_REG_BP)
+                continue;
+            if (conv->volatiles[reg] == (bool)is_volatile)
+                pool[num_pool++] = reg;
+        }
+    }
+
+    // The bottom of the operand stack is used by almost every instruction, so it is assigned first
+    const size_t max_value_registers = 4;
+    size_t num_values = max_depth < max_value_registers ? max_depth : max_value_registers;
+    bool is_used[X86_NUM_REGISTERS] = { 0 };
+    for (size_t i = 0; i < num_values; ++i)
+    {
+        gen->value_registers[i] = pool[i];
+        is_used[pool[i]] = true;
+    }
+    gen->num_value_registers = (uint8_t)num_values;
+
+    // Find the interval of every local with a register-sized integer, whose address is never taken
+    x86gen__interval* intervals = (x86gen__interval*)calloc(irfunc->num_locals ? irfunc->num_locals : 1, sizeof(*intervals));
+    bool* is_candidate = (bool*)calloc(irfunc->num_locals ? irfunc->num_locals : 1, sizeof(*is_candidate));
+    for (size_t i = 0; i < irfunc->num_locals; ++i)
+    {
+        const cc_ir_local* local = &irfunc->locals[i];
+        intervals[i].localid = local->localid;
+        intervals[i].start = SIZE_MAX;
+        intervals[i].reg = X86_NUM_REGISTERS;
+        is_candidate[i] = (local->typeid == CC_IR_TYPEID_INT || local->typeid == CC_IR_TYPEID_PTR)
+            && x86gen__opsize(x86gen__local_size(gen, local)) != X86_OPSIZE_DEFAULT;
+    }
+
+    // Number the instructions, and remember where every block starts and every jump is
+    size_t* block_starts = NULL;
+    size_t num_blocks = 0;
+    size_t position = 0;
+    for (const cc_ir_block* block = irfunc->entry_block; block; block = block->next_block)
+    {
+        ++num_blocks;
+        size_t* block_start = (size_t*)cc_vec_resize(block_starts, num_blocks);
+        *block_start = position;
+        cc_hmap32_put(&gen->map_registers, block->blockid, (uint32_t)(num_blocks - 1)); // Temporary map of blockid -> index
+
+        for (size_t i = 0; i < block->num_ins; ++i, ++position)
+        {
+            const cc_ir_ins* ins = &block->ins[i];
+            if (ins->opcode != CC_IR_OPCODE_ADDRL && ins->opcode != CC_IR_OPCODE_LOADL)
+                continue;
+            const cc_ir_local* local = cc_ir_func_getlocal(irfunc, ins->operand.local);
+            if (!local)
+                continue;
+            size_t index = (size_t)(local - irfunc->locals);
+            if (ins->opcode == CC_IR_OPCODE_ADDRL && !x86gen__is_local_store(gen, block, i))
+                is_candidate[index] = false;
+            if (intervals[index].start == SIZE_MAX)
+                intervals[index].start = position;
+            intervals[index].end = position;
+        }
+    }
+
+    // Extend every interval that overlaps a loop to cover the whole loop, until nothing changes
+    bool is_changed = true;
+    while (is_changed)
+    {
+        is_changed = false;
+        position = 0;
+        for (const cc_ir_block* block = irfunc->entry_block; block; block = block->next_block)
+        {
+            for (size_t i = 0; i < block->num_ins; ++i, ++position)
+            {
+                const cc_ir_ins* ins = &block->ins[i];
+                uint32_t target;
+                if ((ins->opcode != CC_IR_OPCODE_JZ && ins->opcode != CC_IR_OPCODE_JNZ)
+                    || !cc_hmap32_get(&gen->map_registers, ins->operand.blockid, &target) || block_starts[target] > position)
+                    continue;
+                size_t loop_start = block_starts[target];
+                for (size_t j = 0; j < irfunc->num_locals; ++j)
+                {
+                    x86gen__interval* interval = &intervals[j];
+                    if (interval->start == SIZE_MAX || interval->end < loop_start || interval->start > position)
+                        continue;
+                    if (interval->start > loop_start || interval->end < position)
+                    {
+                        interval->start = interval->start < loop_start ? interval->start : loop_start;
+                        interval->end = interval->end > position ? interval->end : position;
+                        is_changed = true;
+                    }
+                }
+            }
+        }
+    }
+    cc_hmap32_clear(&gen->map_registers);
+    free(block_starts);
+
+    // Linear scan over the candidates, in order of their start
+    size_t num_intervals = 0;
+    for (size_t i = 0; i < irfunc->num_locals; ++i)
+    {
+        if (is_candidate[i] && intervals[i].start != SIZE_MAX)
+            intervals[num_intervals++] = intervals[i];
+    }
+    qsort(intervals, num_intervals, sizeof(*intervals), x86gen__compare_intervals);
+
+    x86gen__interval** active = (x86gen__interval**)malloc((num_intervals ? num_intervals : 1) * sizeof(*active));
+    size_t num_active = 0;
+    for (size_t i = 0; i < num_intervals; ++i)
+    {
+        x86gen__interval* interval = &intervals[i];
+
+        // Expire intervals that ended before this one, and free their registers
+        for (size_t j = 0; j < num_active;)
+        {
+            if (active[j]->end < interval->start)
+            {
+                is_used[active[j]->reg] = false;
+                active[j] = active[--num_active];
+            }
+            else
+                ++j;
+        }
+
+        for (size_t j = num_values; j < num_pool; ++j)
+        {
+            if (!is_used[pool[j]])
+            {
+                interval->reg = pool[j];
+                break;
+            }
+        }
+        if (interval->reg == X86_NUM_REGISTERS)
+        {
+            // Spill whichever interval ends last, which frees a register for the longest time
+            size_t last = num_active;
+            for (size_t j = 0; j < num_active; ++j)
+            {
+                if (active[j]->end > interval->end && (last == num_active || active[j]->end > active[last]->end))
+                    last = j;
+            }
+            if (last == num_active)
+                continue; // This interval ends last, so it is spilled
+            interval->reg = active[last]->reg;
+            active[last]->reg = X86_NUM_REGISTERS;
+            active[last] = interval;
+        }
+        else
+            active[num_active++] = interval;
+        is_used[interval->reg] = true;
+    }
+
+    for (size_t i = 0; i < num_intervals; ++i)
+    {
+        const x86gen__interval* interval = &intervals[i];
+        if (interval->reg == X86_NUM_REGISTERS)
+            continue;
+        cc_hmap32_put(&gen->map_registers, interval->localid, interval->reg);
+    }
+    free(active);
+    free(intervals);
+    free(is_candidate);
+}
+
+bool x86gen_dump(x86gen* gen, x86func* func)
+{
+    const cc_ir_func* irfunc = gen->irfunc;
+    size_t max_depth;
+    bool result = false;
+
+    x86func_create(func, gen->mode);
+    gen->func = func;
+    cc_hmap32_clear(&gen->map_blocks);
+    cc_hmap32_clear(&gen->map_locals);
+    cc_hmap32_clear(&gen->map_registers);
+    gen->num_value_registers = 0;
+    memset(gen->save_offsets, 0, sizeof(gen->save_offsets));
+
+    if (gen->mode != X86_MODE_LONG || !gen->conv->num_int_args)
+        goto end;
+
+    for (const cc_ir_block* block = irfunc->entry_block; block; block = block->next_block)
+        cc_hmap32_put(&gen->map_blocks, block->blockid, x86func_newlabel(func));
+
+    // The first pass finds whether the function is supported, and the depth of its operand stack.
+    // Every local is in memory, and the code is thrown away.
+    for (size_t i = 0; i < irfunc->num_locals; ++i)
+        cc_hmap32_put(&gen->map_locals, irfunc->locals[i].localid, (uint32_t)-8);
+    gen->values_offset = -8;
+    if (!x86gen__blocks(gen, &max_depth))
+        goto end;
+    x86func_destroy(func);
+    x86func_create(func, gen->mode);
+    cc_hmap32_clear(&gen->map_blocks);
+    cc_hmap32_clear(&gen->map_locals);
+    for (const cc_ir_block* block = irfunc->entry_block; block; block = block->next_block)
+        cc_hmap32_put(&gen->map_blocks, block->blockid, x86func_newlabel(func));
+
+    x86gen__allocate(gen, max_depth);
+
+    // The frame is below the saved BP and BX. It has an 8-byte slot for every local in memory,
+    // then every saved register, then every value on the operand stack which is not in a register.
+    uint32_t frame_size = 0;
+    uint32_t reg;
+    for (size_t i = 0; i < irfunc->num_locals; ++i)
+    {
+        if (!cc_hmap32_get(&gen->map_registers, irfunc->locals[i].localid, &reg))
+            frame_size += (x86gen__local_size(gen, &irfunc->locals[i]) + 7) & ~7u;
+    }
+    bool is_saved[X86_NUM_REGISTERS] = { 0 };
+    for (size_t i = 0; i < gen->num_value_registers; ++i)
+        is_saved[gen->value_registers[i]] = !gen->conv->volatiles[gen->value_registers[i]];
+    for (size_t i = 0; i < irfunc->num_locals; ++i)
+    {
+        if (cc_hmap32_get(&gen->map_registers, irfunc->locals[i].localid, &reg))
+            is_saved[reg] = !gen->conv->volatiles[reg];
+    }
+    for (size_t i = 0; i < X86_NUM_REGISTERS; ++i)
+        frame_size += is_saved[i] ? 8 : 0;
+    frame_size += (uint32_t)(max_depth - gen->num_value_registers) * 8;
+    frame_size = (frame_size + 15) & ~15u;
+
+    int32_t offset = -8 - (int32_t)frame_size;
+    for (size_t i = 0; i < irfunc->num_locals; ++i)
+    {
+        const cc_ir_local* local = &irfunc->locals[i];
+        uint32_t size = x86gen__local_size(gen, local);
+        if (!size || cc_hmap32_get(&gen->map_registers, local->localid, &reg))
+            continue;
+        cc_hmap32_put(&gen->map_locals, local->localid, (uint32_t)offset);
+        offset += (int32_t)((size + 7) & ~7u);
+    }
+    for (size_t i = 0; i < X86_NUM_REGISTERS; ++i)
+    {
+        if (!is_saved[i])
+            continue;
+        gen->save_offsets[i] = offset;
+        offset += 8;
+    }
+    gen->values_offset = offset + (int32_t)(max_depth - gen->num_value_registers - 1) * 8;
+
+    // Prologue. BX is callee-saved in every supported convention, and holds the args pointer.
+    x86func_push(func, 0, x86_reg(X86_REG_BP));
+    x86func_mov(func, X86_OPSIZE_QWORD, x86_reg(X86_REG_BP), x86_reg(X86_REG_SP));
+    x86func_push(func, 0, x86_reg(X86_REG_B));
+    x86func_mov(func, X86_OPSIZE_QWORD, x86_reg(X86_REG_B), x86_reg(gen->conv->int_args[0]));
+    if (frame_size)
+        x86func_sub(func, X86_OPSIZE_QWORD, x86_reg(X86_REG_SP), x86_const((int32_t)frame_size));
+    for (uint8_t i = 0; i < X86_NUM_REGISTERS; ++i)
+    {
+        if (gen->save_offsets[i])
+            x86func_mov(func, X86_OPSIZE_QWORD, x86_index(X86_REG_BP, X86_REG_SP, X86_SIB_SCALE_1, gen->save_offsets[i]), x86_reg(i));
+    }
+    gen->stack_offset = -16 - (int32_t)frame_size;
+
+    result = x86gen__blocks(gen, &max_depth);
+
+end:
+    if (!result)
+        x86func_destroy(func);
+    return result;
+}
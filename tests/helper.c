@@ -2,6 +2,7 @@
 #include <cc/lexer.h>
 #include <cc/parser.h>
 #include <cc/ir.h>
+#include <cc/vm.h>
 #include <stdio.h>
 #include <assert.h>
 #include <stdlib.h>
@@ -285,9 +286,8 @@ void print_ir_local(const cc_ir_local* local)
     printf(",");
 }
 
-void print_ir_ins(const cc_ir_ins* ins, const cc_ir_func* func)
+static void print__ins(const cc_ir_ins_format* fmt, const cc_ir_ins* ins, const cc_ir_func* func)
 {
-    const cc_ir_ins_format* fmt = &cc_ir_ins_formats[ins->opcode];
     printf("%s", fmt->mnemonic);
     for (int i = 0; i < CC_IR_MAX_OPERANDS; ++i)
     {
@@ -325,6 +325,21 @@ void print_ir_ins(const cc_ir_ins* ins, const cc_ir_func* func)
     }
 }
 
+void print_ir_ins(const cc_ir_ins* ins, const cc_ir_func* func) {
+    print__ins(&cc_ir_ins_formats[ins->opcode], ins, func);
+}
+
+void print_vm_ins(const cc_ir_ins* ins)
+{
+    const cc_ir_ins_format* fmt = cc_vm_ins_format(ins->opcode);
+    if (!fmt)
+    {
+        printf("<unknown opcode %u>", ins->opcode);
+        return;
+    }
+    print__ins(fmt, ins, NULL);
+}
+
 void print_ir_func(const cc_ir_func* func)
 {
     for (const cc_ir_block* block = func->entry_block; block; block = block->next_block)
@@ -20,6 +20,7 @@ void test__assert(const char* comment, int result, const char* file, int line);
  */
 int helper_create_parser(cc_parser* out_parser, const char* source_code);
 
+struct cc_ir_ins;
 struct cc_ir_func;
 
 void print_ast_expr(const cc_ast_expr* expr);
@@ -37,4 +38,6 @@ void print_ast_stmt(const cc_ast_stmt* stmt);
 void print_ast_body(const cc_ast_body* body);
 /// @param func (optional) The function, to resolve names
 void print_ir_ins(const struct cc_ir_ins* ins, const struct cc_ir_func* func);
+/// @brief Print an instruction compiled for the VM, which may use a VM-private opcode
+void print_vm_ins(const struct cc_ir_ins* ins);
 void print_ir_func(const struct cc_ir_func* func);
\ No newline at end of file
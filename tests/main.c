@@ -12,6 +12,7 @@ static void run_test(const char* name, int(*test)(void)) {
 int main(int argc, char** argv)
 {
     run_test("test_hmap", &test_hmap);
+    run_test("test_lexer", &test_lexer);
     run_test("test_expr", &test_expr);
     run_test("test_stmt", &test_stmt);
     run_test("test_function", &test_function);
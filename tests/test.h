@@ -9,4 +9,5 @@ int test_expr(void);
 int test_stmt(void);
 int test_function(void);
 int test_vm(void);
-int test_bigint(void);
\ No newline at end of file
+int test_bigint(void);
+int test_lexer(void);
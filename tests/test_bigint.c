@@ -1,5 +1,6 @@
 #include "test.h"
 #include <cc/bigint.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -109,6 +110,28 @@ int test_bigint(void)
         cc_bigint_div(sizeof(lhs), lhs, rhs, quotient, remainder);
 
         test_assert("Expected the division of two random numbers", !memcmp(quotient, answer, sizeof(quotient)));
+        cc_bigint_atoi(sizeof(answer), answer, 16, "-fedeb79cf363bdb728cc4", -1);
+        test_assert("Expected the remainder to take the sign of the numerator", !memcmp(remainder, answer, sizeof(remainder)));
+    }
+    // Test native-width operations
+    {
+        int32_t lhs = -7, rhs = 2, quotient, remainder;
+        cc_bigint_div(sizeof(lhs), &lhs, &rhs, &quotient, &remainder);
+        test_assert("Expected -7 / 2 == -3 and -7 % 2 == -1", quotient == -3 && remainder == -1);
+
+        int8_t min = INT8_MIN, minus_one = -1, quotient8, remainder8;
+        cc_bigint_div(sizeof(min), &min, &minus_one, &quotient8, &remainder8);
+        test_assert("Expected INT8_MIN / -1 to wrap", quotient8 == INT8_MIN && remainder8 == 0);
+
+        uint16_t shifted = 0xFFFF;
+        cc_bigint_lsh_u32(sizeof(shifted), &shifted, 16);
+        test_assert("Expected a 16-bit integer shifted by 16 bits to be zero", shifted == 0);
+
+        int16_t small = -2;
+        int64_t large;
+        cc_bigint_extend_sign(sizeof(large), &large, sizeof(small), &small);
+        test_assert("Expected -2 sign-extended from 16-bit to 64-bit", large == -2);
+        test_assert("Expected -2 < 1", cc_bigint_cmp(sizeof(small), &small, &(int16_t){1}) == -1);
     }
     // Test basic bit operations
     {
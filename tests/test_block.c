@@ -1,6 +1,8 @@
 #include "test.h"
 #include <cc/ir.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <cc/x86_gen.h>
 
 int test_block(void)
@@ -25,6 +27,56 @@ int test_block(void)
     printf("Original IR:\n");
     print_ir_func(irfunc);
 
+    // Blocks are found by ID, regardless of their order in the list
+    test_assert("Expected every block to be found by its ID", cc_ir_func_getblock(irfunc, entry->blockid) == entry
+        && cc_ir_func_getblock(irfunc, loop->blockid) == loop && cc_ir_func_getblock(irfunc, end->blockid) == end);
+    test_assert("Expected a missing block to not be found", cc_ir_func_getblock(irfunc, (cc_ir_blockid)irfunc->num_blocks) == NULL);
+    cc_ir_block* middle = cc_ir_func_insert(irfunc, entry, CC_STR("middle"), -1);
+    cc_ir_func* clone = (cc_ir_func*)malloc(sizeof(*clone));
+    cc_ir_func_clone(irfunc, clone);
+    const cc_ir_block* cloned = cc_ir_func_getblock(clone, middle->blockid);
+    test_assert("Expected a cloned block to be found by its ID", cloned && cloned != middle && cloned == clone->entry_block->next_block);
+    cc_ir_func_destroy(clone);
+
+    { // Test writing and reading an object
+        cc_ir_localid x = cc_ir_func_int(irfunc, INT_SIZE, "x");
+        cc_ir_symbolid imported = cc_ir_object_import(&obj, false, CC_STR("imported"), -1);
+        cc_ir_block_iconst(loop, INT_SIZE, -100000);
+        cc_ir_block_addrl(loop, x);
+        cc_ir_block_store(loop, INT_SIZE);
+        cc_ir_block_addrg(loop, imported);
+        cc_ir_block_free(loop, sizeof(void*));
+        cc_ir_block_iconst(loop, INT_SIZE, 0);
+        cc_ir_block_jz(loop, INT_SIZE, end);
+
+        cc_stream* stream = cc_stream_create_dynamic();
+        test_assert("Expected an object to be written", cc_ir_object_write(&obj, stream));
+        cc_dynamicstream* written = (cc_dynamicstream*)stream;
+
+        cc_ir_object read;
+        test_assert("Expected an object to be read", cc_ir_object_read(&read, stream));
+        test_assert("Expected the same symbols", read.num_symbols == obj.num_symbols && read._next_symbolid == obj._next_symbolid
+            && read.symbols[1].symbolid == imported && !strcmp(read.symbols[1].name, "imported")
+            && read.symbols[1].symbol_flags == obj.symbols[1].symbol_flags);
+        const cc_ir_func* func = read.symbols[0].ptr.func;
+        test_assert("Expected the same locals", func->num_locals == irfunc->num_locals
+            && !strcmp(func->locals[x].name, "x") && func->locals[x].data_size == (uint32_t)INT_SIZE);
+        int is_same_code = func->num_blocks == irfunc->num_blocks;
+        const cc_ir_block* lhs = func->entry_block, *rhs = irfunc->entry_block;
+        for (; is_same_code && lhs && rhs; lhs = lhs->next_block, rhs = rhs->next_block)
+            is_same_code = lhs->blockid == rhs->blockid && lhs->num_ins == rhs->num_ins
+                && (!lhs->num_ins || !memcmp(lhs->ins, rhs->ins, lhs->num_ins * sizeof(lhs->ins[0])))
+                && (lhs->name ? rhs->name && !strcmp(lhs->name, rhs->name) : !rhs->name);
+        test_assert("Expected the same blocks and instructions", is_same_code && !lhs && !rhs);
+        cc_ir_object_destroy(&read);
+
+        // A truncated object is rejected
+        cc_stream* truncated = cc_stream_create_static(written->buffer, written->size - 1);
+        test_assert("Expected a truncated object to be rejected", !cc_ir_object_read(&read, truncated));
+        cc_stream_destroy(truncated);
+        cc_stream_destroy(stream);
+    }
+
     cc_ir_object_destroy(&obj);
     return 1;
 }
\ No newline at end of file
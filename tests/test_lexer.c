@@ -0,0 +1,267 @@
+#include "test.h"
+#include <cc/lexer.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+/// @brief Check that `source` is exactly one token with `tokenid`
+static int is_one_token(const cc_char* source, int tokenid)
+{
+    cc_token* tokens;
+    size_t num_tokens;
+    int result = cc_lexer_readall(source, NULL, &tokens, &num_tokens) && num_tokens == 1 && tokens[0].tokenid == tokenid;
+    free(tokens);
+    return result;
+}
+
+static int is_same_token(const cc_token* lhs, const cc_token* rhs)
+{
+    return lhs->tokenid == rhs->tokenid && lhs->end - lhs->begin == rhs->end - rhs->begin
+        && !memcmp(lhs->begin, rhs->begin, (size_t)(lhs->end - lhs->begin) * sizeof(cc_char));
+}
+
+int test_lexer(void)
+{
+    // Test keywords, and identifiers that are almost keywords
+    {
+        const struct { const cc_char* str; int tokenid; } keywords[] =
+        {
+            {"int", CC_TOKENID_INT}, {"char", CC_TOKENID_CHAR}, {"void", CC_TOKENID_VOID},
+            {"const", CC_TOKENID_CONST}, {"short", CC_TOKENID_SHORT}, {"long", CC_TOKENID_LONG},
+            {"signed", CC_TOKENID_SIGNED}, {"unsigned", CC_TOKENID_UNSIGNED}, {"volatile", CC_TOKENID_VOLATILE},
+            {"static", CC_TOKENID_STATIC}, {"if", CC_TOKENID_IF}, {"else", CC_TOKENID_ELSE},
+            {"while", CC_TOKENID_WHILE}, {"goto", CC_TOKENID_GOTO}, {"return", CC_TOKENID_RETURN},
+            {"break", CC_TOKENID_BREAK}, {"continue", CC_TOKENID_CONTINUE},
+        };
+        for (size_t i = 0; i < sizeof(keywords) / sizeof(keywords[0]); ++i)
+        {
+            if (!is_one_token(keywords[i].str, keywords[i].tokenid))
+                printf("Keyword \"%s\" was not recognized\n", keywords[i].str);
+            test_assert("Expected every keyword to be recognized", is_one_token(keywords[i].str, keywords[i].tokenid));
+        }
+
+        const cc_char* identifiers[] = { "i", "in", "ints", "iF", "eee", "cont", "continu", "signet", "stati", "_", "x1" };
+        for (size_t i = 0; i < sizeof(identifiers) / sizeof(identifiers[0]); ++i)
+            test_assert("Expected an identifier like a keyword to stay an identifier", is_one_token(identifiers[i], CC_TOKENID_IDENTIFIER));
+    }
+    // Test punctuation, which reads the longest token
+    {
+        const cc_char* source = "a--b->c<=d!=!e&&&f||g;{}[]()\t\v\f\r\n~9x";
+        const int expected[] =
+        {
+            CC_TOKENID_IDENTIFIER, CC_TOKENID_MINUSMINUS, CC_TOKENID_IDENTIFIER, CC_TOKENID_ARROW,
+            CC_TOKENID_IDENTIFIER, CC_TOKENID_LEFT_ANGLEEQUAL, CC_TOKENID_IDENTIFIER, CC_TOKENID_EXCLAMATIONEQUAL,
+            CC_TOKENID_EXCLAMATION, CC_TOKENID_IDENTIFIER, CC_TOKENID_AMPAMP, CC_TOKENID_AMP, CC_TOKENID_IDENTIFIER,
+            CC_TOKENID_PIPEPIPE, CC_TOKENID_IDENTIFIER, CC_TOKENID_SEMICOLON, CC_TOKENID_LEFT_CURLY, CC_TOKENID_RIGHT_CURLY,
+            CC_TOKENID_LEFT_SQUARE, CC_TOKENID_RIGHT_SQUARE, CC_TOKENID_LEFT_ROUND, CC_TOKENID_RIGHT_ROUND,
+            CC_TOKENID_TILDE, CC_TOKENID_INTCONST, CC_TOKENID_IDENTIFIER,
+        };
+        cc_token* tokens;
+        size_t num_tokens;
+        test_assert("Expected punctuation to be read", cc_lexer_readall(source, NULL, &tokens, &num_tokens));
+        int is_expected = num_tokens == sizeof(expected) / sizeof(expected[0]);
+        for (size_t i = 0; is_expected && i < num_tokens; ++i)
+            is_expected = tokens[i].tokenid == expected[i];
+        test_assert("Expected the longest punctuation tokens", is_expected);
+        free(tokens);
+
+        test_assert("Expected a trailing '-' to be read alone", is_one_token("-", CC_TOKENID_MINUS));
+        test_assert("Expected unknown chars to stop the lexer", !cc_lexer_readall("a @ b", NULL, &tokens, &num_tokens)
+            && num_tokens == 1);
+        free(tokens);
+    }
+    // Test long runs, which are scanned many chars at a time
+    {
+        const cc_char* source = "  \t\t\n\n\r\r\v\v\f\f                       abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_0123456789"
+            "+01234567890123456789012345678901234567890123456789*z";
+        cc_token* tokens;
+        size_t num_tokens;
+        test_assert("Expected long runs to be read", cc_lexer_readall(source, NULL, &tokens, &num_tokens) && num_tokens == 5);
+        test_assert("Expected a long identifier", tokens[0].tokenid == CC_TOKENID_IDENTIFIER && cc_token_len(&tokens[0]) == 63);
+        test_assert("Expected a long integer", tokens[2].tokenid == CC_TOKENID_INTCONST && cc_token_len(&tokens[2]) == 50);
+        free(tokens);
+
+        // Every token must be a maximal run, wherever the run ends
+        const cc_char alphabet[] = "aZ_9 \t\n+-;{=<>!&|";
+        cc_char random[200];
+        unsigned seed = 1;
+        int is_maximal = 1;
+        for (int i = 0; i < 200 && is_maximal; ++i)
+        {
+            for (size_t j = 0; j < sizeof(random); ++j)
+            {
+                seed = seed * 1103515245 + 12345;
+                random[j] = alphabet[(seed >> 16) % (sizeof(alphabet) - 1)];
+            }
+            is_maximal = cc_lexer_readall(random, random + sizeof(random), &tokens, &num_tokens);
+            for (size_t j = 0; j < num_tokens; ++j)
+            {
+                const cc_token* tk = &tokens[j];
+                // An integer is only digits, so a letter after it begins an identifier
+                int (*is_in_run)(int) = tk->tokenid == CC_TOKENID_INTCONST ? &isdigit : &isalnum;
+                if (tk->tokenid != CC_TOKENID_IDENTIFIER && tk->tokenid != CC_TOKENID_INTCONST)
+                    continue;
+                for (const cc_char* c = tk->begin; c < tk->end; ++c)
+                    is_maximal = is_maximal && (is_in_run((unsigned char)*c) || (*c == '_' && is_in_run == &isalnum));
+                is_maximal = is_maximal && (tk->end == random + sizeof(random)
+                    || !(is_in_run((unsigned char)*tk->end) || (*tk->end == '_' && is_in_run == &isalnum)));
+            }
+            free(tokens);
+        }
+        test_assert("Expected identifiers and integers to end where their run ends", is_maximal);
+
+        // Runs of every length from every offset, then tails of every length, end in every lane of the scan
+        const cc_char* run_chars[] = { "aZ_9x", "0123456789", " \t\n\v\f\r" };
+        const int run_tokenids[] = { CC_TOKENID_IDENTIFIER, CC_TOKENID_INTCONST };
+        cc_char buffer[16 + 40 + 20];
+        int is_exact = 1;
+        for (size_t kind = 0; kind < 3; ++kind)
+        {
+            for (size_t offset = 0; offset < 16; ++offset)
+            {
+                for (size_t len = 1; len <= 40; ++len)
+                {
+                    for (size_t tail = 0; tail <= 18; ++tail)
+                    {
+                        // Whitespace runs are between identifiers. Other runs are after whitespace, and before punctuation.
+                        const int is_space = kind == 2;
+                        size_t n = 0;
+                        for (; n < offset; ++n)
+                            buffer[n] = is_space ? 'q' : ' ';
+                        for (size_t j = 0; j < len; ++j)
+                            buffer[n++] = run_chars[kind][j % strlen(run_chars[kind])];
+                        for (size_t j = 0; j < tail; ++j)
+                            buffer[n++] = j ? ' ' : is_space ? 'q' : '+';
+
+                        size_t num_expected = is_space ? (offset != 0) + (tail != 0) : 1 + (tail != 0);
+                        is_exact = is_exact && cc_lexer_readall(buffer, buffer + n, &tokens, &num_tokens) && num_tokens == num_expected;
+                        if (is_exact && !is_space)
+                            is_exact = tokens[0].tokenid == run_tokenids[kind] && tokens[0].begin == buffer + offset
+                                && tokens[0].end == buffer + offset + len;
+                        if (is_exact && tail)
+                            is_exact = tokens[num_tokens - 1].begin == buffer + offset + len;
+                        free(tokens);
+                    }
+                }
+            }
+        }
+        test_assert("Expected runs to end exactly, at any length and offset", is_exact);
+
+        // Unknown chars end a run wherever they are, then stop the lexer
+        const cc_char invalid[] = "@\x80\xff";
+        int is_stopped = 1;
+        for (size_t i = 0; i < sizeof(invalid) - 1; ++i)
+        {
+            for (size_t len = 1; len <= 40; ++len)
+            {
+                size_t n = 0;
+                for (; n < len; ++n)
+                    buffer[n] = run_chars[0][n % strlen(run_chars[0])];
+                buffer[n++] = invalid[i];
+                for (size_t j = 0; j < 18; ++j)
+                    buffer[n++] = 'a';
+                is_stopped = is_stopped && !cc_lexer_readall(buffer, buffer + n, &tokens, &num_tokens)
+                    && num_tokens == 1 && cc_token_len(&tokens[0]) == len;
+                free(tokens);
+            }
+        }
+        test_assert("Expected unknown chars to end a run and stop the lexer", is_stopped);
+    }
+    // Test lexing into an arena, which is reused
+    {
+        const cc_char* sources[] = { "int x = 1;", "while (x) { x = x - 1; }", "", "return x;" };
+        cc_arena* arena = cc_arena_create();
+        size_t capacity = 0;
+        int is_same = 1;
+        for (size_t i = 0; i < sizeof(sources) / sizeof(sources[0]); ++i)
+        {
+            cc_token* expected, *tokens;
+            size_t num_expected, num_tokens;
+            cc_arena_clear(&arena);
+            test_assert("Expected tokens to be read", cc_lexer_readall(sources[i], NULL, &expected, &num_expected));
+            test_assert("Expected tokens to be read into an arena", cc_lexer_readall_arena(sources[i], NULL, &arena, &tokens, &num_tokens));
+            is_same = is_same && num_tokens == num_expected && (!num_tokens || !memcmp(tokens, expected, num_tokens * sizeof(tokens[0])));
+            free(expected);
+            if (i == 1)
+                capacity = arena->capacity;
+        }
+        test_assert("Expected the same tokens in an arena", is_same);
+        test_assert("Expected a cleared arena to be reused for smaller strings", arena->capacity == capacity);
+        cc_arena_destroy(arena);
+    }
+
+    // Test streaming chunks, with tokens split between them
+    {
+        const char source[] = "int main(void) { return a_long_identifier--->x + 12345 ; }\n  while";
+        const size_t source_len = sizeof(source) - 1;
+        cc_token* expected;
+        size_t num_expected;
+        test_assert("Expected tokens to be read", cc_lexer_readall(source, NULL, &expected, &num_expected));
+
+        int is_same = 1;
+        for (size_t chunk_len = 1; chunk_len <= 8; ++chunk_len)
+        {
+            // A small ring, so lexing must wait for tokens to be read
+            cc_streamlexer lex;
+            cc_streamlexer_create(&lex, 2);
+            size_t num_tokens = 0, fed = 0;
+            cc_token tk;
+            while (!lex.is_finished)
+            {
+                size_t len = source_len - fed < chunk_len ? source_len - fed : chunk_len;
+                cc_streamlexer_feed(&lex, source + fed, len);
+                fed += len;
+                if (fed == source_len)
+                    cc_streamlexer_finish(&lex);
+                while (cc_streamlexer_read(&lex, &tk))
+                {
+                    is_same = is_same && num_tokens < num_expected && is_same_token(&tk, &expected[num_tokens]);
+                    ++num_tokens;
+                }
+                is_same = is_same && lex.num_ring == 0 && lex.text_len - lex.pos < 32;
+            }
+            is_same = is_same && num_tokens == num_expected && !lex.is_invalid;
+            cc_streamlexer_destroy(&lex);
+        }
+        test_assert("Expected the same tokens from every chunk size", is_same);
+
+        // Read chunks from a stream, and look ahead
+        cc_stream* stream = cc_stream_create_static((uint8_t*)source, source_len);
+        cc_streamlexer lex;
+        cc_streamlexer_create(&lex, 4);
+        size_t num_tokens = 0;
+        cc_token tk, ahead;
+        for (;;)
+        {
+            int is_fed = cc_streamlexer_feed_stream(&lex, stream, 5);
+            while (cc_streamlexer_peek(&lex, 3, &ahead))
+            {
+                test_assert("Expected a token to be read after peeking", cc_streamlexer_read(&lex, &tk));
+                is_same = is_same && is_same_token(&tk, &expected[num_tokens])
+                    && ahead.tokenid == expected[num_tokens + 3].tokenid;
+                ++num_tokens;
+            }
+            test_assert("Expected at most ring_cap tokens to be lexed ahead", lex.num_ring <= 4);
+            if (!is_fed)
+            {
+                while (cc_streamlexer_read(&lex, &tk))
+                    is_same = is_same && num_tokens < num_expected && is_same_token(&tk, &expected[num_tokens++]);
+                break;
+            }
+        }
+        test_assert("Expected the same tokens from a stream", is_same && num_tokens == num_expected);
+        test_assert("Expected nothing to peek past the ring", !cc_streamlexer_peek(&lex, 4, &tk));
+        cc_streamlexer_destroy(&lex);
+        cc_stream_destroy(stream);
+        free(expected);
+
+        // Text which is not a token stops the lexer, even before the input is finished
+        cc_streamlexer_create(&lex, 8);
+        cc_streamlexer_feed(&lex, "x = @", 5);
+        test_assert("Expected tokens before invalid text", cc_streamlexer_read(&lex, &tk) && cc_streamlexer_read(&lex, &tk));
+        test_assert("Expected invalid text to be found", !cc_streamlexer_read(&lex, &tk) && lex.is_invalid);
+        cc_streamlexer_destroy(&lex);
+    }
+
+    return 1;
+}
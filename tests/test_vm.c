@@ -1,15 +1,23 @@
 #include "test.h"
 #include <stdio.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
 #include <cc/vm.h>
 #include <cc/ir.h>
 #include <cc/bigint.h>
+#include <cc/cache.h>
+#ifndef _WIN32
+    #include <pthread.h>
+#endif
 
 #define INT_SIZE 8
 // Pop an int off the stack and checks it against the answer. Throws assertion errors.
 #define INTERRUPT_CHECK_ANSWER 111
 #define INTERRUPT_EXIT 222
 #define INTERRUPT_PUTCHAR 333
+// Check the int on top of the stack against the answer, without popping it
+#define INTERRUPT_PEEK_ANSWER 444
 #define FUNCTION_CHECK_ANSWER "check_answer"
 #define FUNCTION_PRINT_INT "print_int"
 
@@ -19,9 +27,31 @@ static bool was_exit_reached = false;
 static char virtual_print_buffer[64];
 static size_t virtual_print_cursor = 0;
 
-cc_ir_object* create_main_object();
-cc_ir_object* create_library_object();
-void interrupt_handler(cc_vm* vm, uint32_t interrupt);
+static cc_ir_object* create_main_object();
+static cc_ir_object* create_library_object();
+static cc_ir_object* create_trusted_object();
+static cc_ir_object* create_native_object();
+static cc_ir_object* create_hashed_object(const char* name, const char* import_name);
+static void interrupt_handler(cc_vm* vm, uint32_t interrupt);
+/// @brief How @ref run_until_exit runs a VM
+typedef enum run_mode
+{
+    RUN_CHECKED,
+    RUN_TRUSTED,
+    /// @brief One instruction at a time, with @ref cc_vm_run
+    RUN_STEPPED,
+} run_mode;
+
+static size_t run_until_exit(const cc_vmprogram* program, const cc_vmsymbol* entry, run_mode mode, cc_vmprofile* profile);
+static cc_vmexception run_ins(const cc_ir_ins* ins, const uint8_t* operands, size_t operands_size, uint8_t* out_stack, size_t stack_size);
+static void* run_shared(void* instance);
+
+/// @brief One VM's results from @ref run_shared
+struct shared_instance
+{
+    const cc_vmprogram* program;
+    int64_t answer;
+};
 
 int test_vm(void)
 {
@@ -58,7 +88,7 @@ int test_vm(void)
         // Print instruction with indentation based on call depth
         for (int i = 0; i < call_depth; ++i)
             printf("  ");
-        print_ir_ins(ins, NULL);
+        print_vm_ins(ins);
         putchar('\n');
 
         // Execute instruction
@@ -91,6 +121,608 @@ int test_vm(void)
     int32_t printed_int;
     cc_bigint_atoi(sizeof(printed_int), &printed_int, 10, virtual_print_buffer, virtual_print_cursor);
     test_assert("Expected the answer to be printed correctly", printed_int == TEST_ANSWER);
+
+    // Run the same program again, without single-stepping
+    size_t stack_steps = run_until_exit(&program, symbol_main, RUN_CHECKED, NULL);
+    test_assert("Expected the answer to be found by cc_vm_run", was_answer_found);
+    cc_bigint_atoi(sizeof(printed_int), &printed_int, 10, virtual_print_buffer, virtual_print_cursor);
+    test_assert("Expected the answer to be printed correctly by cc_vm_run", printed_int == TEST_ANSWER);
+    test_assert("Interrupts that pop from the stack must fail verification", !program.is_verified);
+    cc_vmprogram_destroy(&program);
+
+    // Run the same program with three-address instructions, by running and by single-stepping
+    cc_vmprogram_create(&program);
+    program.target = CC_VMTARGET_REGISTER;
+    {
+        cc_ir_object* obj_main = create_main_object();
+        cc_ir_object* obj_library = create_library_object();
+        test_assert("main object must link for the register target", cc_vmprogram_link(&program, obj_main));
+        test_assert("library object must link for the register target", cc_vmprogram_link(&program, obj_library));
+        cc_ir_object_destroy(obj_main);
+        cc_ir_object_destroy(obj_library);
+    }
+    symbol_main = cc_vmprogram_get_symbol(&program, "main", -1);
+    const cc_ir_ins* register_ins = (const cc_ir_ins*)symbol_main->ptr;
+    test_assert("Expected `x = 9` to be one instruction", register_ins[1].opcode == CC_VMOPCODE_MOV_K_I64);
+    test_assert("Expected `x -= 1` to be one instruction", register_ins[4].opcode == CC_VMOPCODE_SUB_RK_I64);
+
+    for (int is_stepping = 0; is_stepping < 2; ++is_stepping)
+    {
+        size_t register_steps = run_until_exit(&program, symbol_main, is_stepping ? RUN_STEPPED : RUN_CHECKED, NULL);
+        test_assert("Expected the answer to be found by the register VM", was_answer_found);
+        cc_bigint_atoi(sizeof(printed_int), &printed_int, 10, virtual_print_buffer, virtual_print_cursor);
+        test_assert("Expected the answer to be printed correctly by the register VM", printed_int == TEST_ANSWER);
+        test_assert("Expected one step for every replaced instruction", register_steps == stack_steps);
+    }
+    cc_vmprogram_destroy(&program);
+
+    // Run a verified program without stack checks
+    cc_vmprogram_create(&program);
+    {
+        cc_ir_object* obj_trusted = create_trusted_object();
+        test_assert("trusted object must link successfully", cc_vmprogram_link(&program, obj_trusted));
+        cc_ir_object_destroy(obj_trusted);
+    }
+    test_assert("A balanced program must pass verification", program.is_verified);
+    symbol_main = cc_vmprogram_get_symbol(&program, "main", -1);
+
+    run_until_exit(&program, symbol_main, RUN_TRUSTED, NULL);
+    test_assert("Expected the answer to be found by cc_vm_run_trusted", was_answer_found);
+
+    // `addrl x; store` is fused after the FRAME and UCONST instructions
+    const cc_ir_ins* main_ins = (const cc_ir_ins*)symbol_main->ptr;
+    test_assert("Expected `addrl; store` to be a superinstruction", main_ins[2].opcode == CC_VMOPCODE_ADDRL_STORE_I64);
+    test_assert("Expected the rest of the superinstruction to be kept", main_ins[3].opcode == CC_VMOPCODE_STORE_I64);
+
+    // Count the executed sequences
+    cc_vmprofile profile;
+    cc_vmprofile_create(&profile);
+    run_until_exit(&program, symbol_main, RUN_CHECKED, &profile);
+    test_assert("Expected the answer to be found by cc_vm_run_profiled", was_answer_found);
+
+    cc_vmprofile_sort(&profile);
+    printf("Hottest sequences:\n");
+    for (size_t i = 0; i < profile.num_ngrams && i < 5; ++i)
+    {
+        const cc_vmngram* ngram = &profile.ngrams[i];
+        printf("  %llu:", (unsigned long long)ngram->count);
+        for (size_t j = 0; j < ngram->length; ++j)
+            printf(" %s", cc_vm_ins_format(ngram->opcodes[j])->mnemonic);
+        putchar('\n');
+    }
+    // double_arg loads its argument twice. Ties with `addrl; store` are ordered by opcode.
+    test_assert("Expected `argp; load` to be the hottest sequence", profile.num_ngrams > 0
+        && profile.ngrams[0].length == 2 && profile.ngrams[0].count == 2
+        && profile.ngrams[0].opcodes[0] == CC_IR_OPCODE_ARGP && profile.ngrams[0].opcodes[1] == CC_VMOPCODE_LOAD_I64);
+    cc_vmprofile_destroy(&profile);
+
+    // The stack is checked once, when the frame is reserved
+    cc_vm_create(&vm, 16, &program);
+    vm.ip = (uint8_t*)symbol_main->ptr;
+    cc_vm_run_trusted(&vm, (size_t)-1);
+    test_assert("Expected a stack overflow when reserving the frame", vm.vmexception == CC_VMEXCEPTION_INVALID_SP);
+    test_assert("Expected the overflow before any stack writes", vm.sp == vm.stack + vm.stack_size);
+    cc_vm_destroy(&vm);
+    cc_vmprogram_destroy(&program);
+
+    // Run a program without native code, compiled at link, and compiled when hot, which must have the same result
+    for (int jit_mode = 0; jit_mode < 3; ++jit_mode)
+    {
+        bool is_tiered = jit_mode == 2;
+        cc_vmprogram_create(&program);
+        program.jit = jit_mode != 0;
+        // triangle(17) enters its loop 17 times, which is hot enough
+        program.jit_threshold = is_tiered ? 10 : 0;
+        {
+            cc_ir_object* obj_native = create_native_object();
+            test_assert("native object must link successfully", cc_vmprogram_link(&program, obj_native));
+            cc_ir_object_destroy(obj_native);
+        }
+        symbol_main = cc_vmprogram_get_symbol(&program, "main", -1);
+        const cc_vmsymbol* symbol_triangle = cc_vmprogram_get_symbol(&program, "triangle", -1);
+        bool is_native = ((const cc_ir_ins*)symbol_triangle->ptr)->opcode == CC_VMOPCODE_NATIVE;
+        test_assert("Expected only leaf functions to be compiled to native code when linked",
+            is_native == (jit_mode == 1 && CC_VM_NATIVE)
+            && ((const cc_ir_ins*)symbol_main->ptr)->opcode == CC_IR_OPCODE_FRAME);
+        test_assert("Expected hot functions to be counted",
+            (((const cc_ir_ins*)symbol_main->ptr)[1].opcode == CC_VMOPCODE_COUNT) == (is_tiered && CC_VM_NATIVE));
+
+        for (int is_trusted = 0; is_trusted < 2; ++is_trusted)
+        {
+            run_until_exit(&program, symbol_main, is_trusted ? RUN_TRUSTED : RUN_CHECKED, NULL);
+            test_assert("Expected the same answer with or without native code", was_answer_found);
+        }
+
+        // The first run crossed the threshold in triangle's loop, but main was only entered twice
+        is_native = ((const cc_ir_ins*)symbol_triangle->ptr)->opcode == CC_VMOPCODE_NATIVE;
+        test_assert("Expected hot functions to be compiled to native code", is_native == (jit_mode != 0 && CC_VM_NATIVE)
+            && ((const cc_ir_ins*)symbol_main->ptr)->opcode == CC_IR_OPCODE_FRAME);
+
+        // Relinking frees the native code, and the new code starts cold
+        size_t num_natives = program.num_natives;
+        {
+            cc_ir_object* obj_native = create_native_object();
+            test_assert("native object must relink successfully", cc_vmprogram_relink(&program, 0, obj_native));
+            cc_ir_object_destroy(obj_native);
+        }
+        symbol_main = cc_vmprogram_get_symbol(&program, "main", -1);
+        symbol_triangle = cc_vmprogram_get_symbol(&program, "triangle", -1);
+        is_native = ((const cc_ir_ins*)symbol_triangle->ptr)->opcode == CC_VMOPCODE_NATIVE;
+        test_assert("Expected a relinked function to be compiled again", is_native == (jit_mode == 1 && CC_VM_NATIVE));
+        test_assert("Expected a relinked function to reuse its native code's entry", program.num_natives == num_natives);
+        run_until_exit(&program, symbol_main, RUN_CHECKED, NULL);
+        test_assert("Expected the same answer after relinking", was_answer_found);
+        cc_vmprogram_destroy(&program);
+    }
+
+    // Link objects which import each other, and whose names have the same hash
+    {
+        const char* name_a = "f778b8";
+        const char* name_b = "f3498b";
+        test_assert("Expected the names to have the same hash", cc_fnv1a_32(name_a, 6) == cc_fnv1a_32(name_b, 6));
+        cc_vmprogram_create(&program);
+        cc_ir_object* obj_a = create_hashed_object(name_a, name_b);
+        cc_ir_object* obj_b = create_hashed_object(name_b, name_a);
+        test_assert("hashed objects must link successfully", cc_vmprogram_link(&program, obj_a) && cc_vmprogram_link(&program, obj_b));
+        cc_ir_object_destroy(obj_a);
+        cc_ir_object_destroy(obj_b);
+
+        const cc_vmsymbol* symbol_a = cc_vmprogram_get_symbol(&program, name_a, -1);
+        const cc_vmsymbol* symbol_b = cc_vmprogram_get_symbol(&program, name_b, -1);
+        test_assert("Expected symbols with the same hash to be found by name", symbol_a && symbol_b && symbol_a != symbol_b
+            && !strcmp(symbol_a->name, name_a) && !strcmp(symbol_b->name, name_b));
+        test_assert("Expected a missing symbol with the same hash to not be found", !cc_vmprogram_get_symbol(&program, "f3498", -1));
+        // Each function's ADDRG follows its FRAME
+        test_assert("Expected imports to be resolved by name",
+            ((const cc_ir_ins*)symbol_a->ptr)[1].operand.symbolid == (cc_ir_symbolid)(symbol_b - program.symbols)
+            && ((const cc_ir_ins*)symbol_b->ptr)[1].operand.symbolid == (cc_ir_symbolid)(symbol_a - program.symbols));
+        bool is_resolved = true;
+        for (size_t i = 0; i < program.num_imports; ++i)
+            is_resolved = is_resolved && program.imports[i] == NULL;
+        test_assert("Expected no unresolved imports", is_resolved);
+        cc_vmprogram_destroy(&program);
+    }
+
+    // Replace and remove objects which import each other
+    {
+        cc_vmprogram_create(&program);
+        cc_ir_object* obj_a = create_hashed_object("a", "b");
+        cc_ir_object* obj_b = create_hashed_object("b", "a");
+        test_assert("relinked objects must link successfully", cc_vmprogram_link(&program, obj_a) && cc_vmprogram_link(&program, obj_b));
+        cc_ir_object_destroy(obj_a);
+        cc_ir_object_destroy(obj_b);
+        const size_t chunk_b = program.num_ins_chunks - 1;
+
+        // The new object has the same number of symbols, so its indexes are reused
+        size_t index_b = cc_vmprogram_get_symbol(&program, "b", -1) - program.symbols;
+        obj_b = create_hashed_object("b", "a");
+        test_assert("Expected an object to be relinked", cc_vmprogram_relink(&program, chunk_b, obj_b));
+        cc_ir_object_destroy(obj_b);
+        const cc_vmsymbol* symbol_a = cc_vmprogram_get_symbol(&program, "a", -1);
+        const cc_vmsymbol* symbol_b = cc_vmprogram_get_symbol(&program, "b", -1);
+        test_assert("Expected a relinked object to keep its symbol indexes", symbol_b - program.symbols == (ptrdiff_t)index_b
+            && ((const cc_ir_ins*)symbol_b->ptr)[1].operand.symbolid == (cc_ir_symbolid)(symbol_a - program.symbols));
+
+        // The new object has more symbols, so it moves, and its importers are patched
+        obj_b = create_hashed_object("b", "a");
+        cc_ir_block_ret(cc_ir_object_add_func(obj_b, "c", -1)->entry_block);
+        test_assert("Expected a larger object to be relinked", cc_vmprogram_relink(&program, chunk_b, obj_b));
+        cc_ir_object_destroy(obj_b);
+        symbol_a = cc_vmprogram_get_symbol(&program, "a", -1);
+        symbol_b = cc_vmprogram_get_symbol(&program, "b", -1);
+        test_assert("Expected importers to reference the moved symbol", symbol_b && symbol_b - program.symbols != (ptrdiff_t)index_b
+            && ((const cc_ir_ins*)symbol_a->ptr)[1].operand.symbolid == (cc_ir_symbolid)(symbol_b - program.symbols)
+            && cc_vmprogram_get_symbol(&program, "c", -1) != NULL);
+
+        // Importers of a removed object become unresolved, until it is linked again
+        cc_vmprogram_unlink(&program, chunk_b);
+        test_assert("Expected an unlinked object's symbols to be removed", !cc_vmprogram_get_symbol(&program, "b", -1)
+            && !cc_vmprogram_get_symbol(&program, "c", -1)
+            && ((const cc_ir_ins*)symbol_a->ptr)[1].operand.symbolid == (cc_ir_symbolid)-1);
+        obj_b = create_hashed_object("b", "a");
+        test_assert("Expected an unlinked object to be relinked", cc_vmprogram_relink(&program, chunk_b, obj_b));
+        cc_ir_object_destroy(obj_b);
+        symbol_b = cc_vmprogram_get_symbol(&program, "b", -1);
+        test_assert("Expected importers to be resolved again", symbol_b
+            && ((const cc_ir_ins*)symbol_a->ptr)[1].operand.symbolid == (cc_ir_symbolid)(symbol_b - program.symbols));
+        bool is_resolved = true;
+        for (size_t i = 0; i < program.num_imports; ++i)
+            is_resolved = is_resolved && program.imports[i] == NULL;
+        test_assert("Expected no unresolved imports after relinking", is_resolved);
+        cc_vmprogram_destroy(&program);
+    }
+
+    // Save a program as an image, and load it without compiling
+    {
+        cc_vmprogram_create(&program);
+        program.jit = true;
+        program.jit_threshold = 0;
+        cc_ir_object* obj_native = create_native_object();
+        cc_ir_object* obj_a = create_hashed_object("a", "b");
+        test_assert("image objects must link successfully", cc_vmprogram_link(&program, obj_native) && cc_vmprogram_link(&program, obj_a));
+        cc_ir_object_destroy(obj_native);
+        cc_ir_object_destroy(obj_a);
+        cc_stream* stream = cc_stream_create_dynamic();
+        test_assert("Expected a program to be written as an image", cc_vmprogram_write(&program, stream));
+        cc_vmprogram_destroy(&program);
+
+        cc_dynamicstream* image = (cc_dynamicstream*)stream;
+        test_assert("Expected an image to be loaded", cc_vmprogram_load(&program, image->buffer, image->size));
+        test_assert("Expected a loaded image to not be trusted", !program.is_verified);
+        symbol_main = cc_vmprogram_get_symbol(&program, "main", -1);
+        size_t main_offset = (size_t)((uint8_t*)symbol_main->ptr - image->buffer);
+        const cc_vmsymbol* symbol_triangle = cc_vmprogram_get_symbol(&program, "triangle", -1);
+        test_assert("Expected code to be used in place, and native code to be interpreted", symbol_main && symbol_triangle
+            && (uint8_t*)symbol_triangle->ptr >= image->buffer && (uint8_t*)symbol_triangle->ptr < image->buffer + image->size
+            && ((const cc_ir_ins*)symbol_triangle->ptr)->opcode == CC_IR_OPCODE_FRAME);
+        run_until_exit(&program, symbol_main, RUN_CHECKED, NULL);
+        test_assert("Expected the same answer from a loaded image", was_answer_found);
+
+        // The unresolved import was saved, and is resolved by a later link
+        cc_ir_object* obj_b = create_hashed_object("b", "a");
+        test_assert("Expected an object to link into a loaded image", cc_vmprogram_link(&program, obj_b));
+        cc_ir_object_destroy(obj_b);
+        const cc_vmsymbol* symbol_a = cc_vmprogram_get_symbol(&program, "a", -1);
+        const cc_vmsymbol* symbol_b = cc_vmprogram_get_symbol(&program, "b", -1);
+        test_assert("Expected a loaded import to be resolved", symbol_a && symbol_b
+            && ((const cc_ir_ins*)symbol_a->ptr)[1].operand.symbolid == (cc_ir_symbolid)(symbol_b - program.symbols));
+        cc_vmprogram_destroy(&program);
+
+        // Map the image from a file
+        const char* path = "test_vm_image.ccvm";
+        FILE* file = fopen(path, "wb");
+        test_assert("Expected the image file to be created", file && fwrite(image->buffer, 1, image->size, file) == image->size);
+        fclose(file);
+        // The code of a tampered image is caught by the checked loop, even when run as trusted
+        image->buffer[main_offset + offsetof(cc_ir_ins, opcode)] = 0xFF;
+        test_assert("Expected a tampered image to be loaded", cc_vmprogram_load(&program, image->buffer, image->size));
+        cc_vm_create(&vm, 0x1000, &program);
+        vm.ip = (uint8_t*)cc_vmprogram_get_symbol(&program, "main", -1)->ptr;
+        cc_vm_run_trusted(&vm, (size_t)-1);
+        test_assert("Expected an invalid opcode to raise an exception", vm.vmexception == CC_VMEXCEPTION_INVALID_CODE);
+        cc_vm_destroy(&vm);
+        cc_vmprogram_destroy(&program);
+        const cc_vmimage_header* header = (const cc_vmimage_header*)image->buffer;
+        cc_vmimage_symbol* image_symbols = (cc_vmimage_symbol*)(image->buffer + header->symbols_offset);
+        ++image_symbols[0].code_offset;
+        test_assert("Expected a misaligned symbol to be rejected", !cc_vmprogram_load(&program, image->buffer, image->size));
+        image->buffer[0] = 'X';
+        test_assert("Expected an image with the wrong magic to be rejected", !cc_vmprogram_load(&program, image->buffer, image->size));
+        cc_stream_destroy(stream);
+        test_assert("Expected an image file to be mapped", cc_vmprogram_map(&program, path));
+        run_until_exit(&program, cc_vmprogram_get_symbol(&program, "main", -1), RUN_CHECKED, NULL);
+        test_assert("Expected the same answer from a mapped image", was_answer_found);
+        cc_vmprogram_destroy(&program);
+        remove(path);
+    }
+
+    // Cache objects and images by the hash of their source
+    {
+        const char source_main[] = "main.c", source_library[] = "library.c", options[] = "-O1";
+        uint64_t key_main = cc_cache_key(source_main, sizeof(source_main) - 1, NULL, 0);
+        uint64_t key_library = cc_cache_key(source_library, sizeof(source_library) - 1, NULL, 0);
+        test_assert("Expected different options to have a different key",
+            key_main != cc_cache_key(source_main, sizeof(source_main) - 1, options, sizeof(options) - 1));
+
+        cc_cache cache;
+        const char* dir = "test_vm_cache";
+        test_assert("Expected a cache directory to be created", cc_cache_create(&cache, dir, 1 << 20));
+        cc_ir_object obj_main, obj_library;
+        test_assert("Expected a missing entry to not be loaded", !cc_cache_load_ir(&cache, key_main, &obj_main));
+        cc_ir_object* compiled_main = create_main_object();
+        cc_ir_object* compiled_library = create_library_object();
+        test_assert("Expected objects to be cached", cc_cache_store_ir(&cache, key_main, compiled_main)
+            && cc_cache_store_ir(&cache, key_library, compiled_library));
+        cc_ir_object_destroy(compiled_main);
+        cc_ir_object_destroy(compiled_library);
+        // Replacing an entry only counts its new size
+        const uint8_t entry[] = "entry";
+        uint64_t size_before = cache.size;
+        test_assert("Expected an entry to be replaced", cc_cache_store(&cache, key_main, ".test", entry, 5)
+            && cc_cache_store(&cache, key_main, ".test", entry, 3) && cache.size == size_before + 3);
+
+        test_assert("Expected cached objects to be loaded", cc_cache_load_ir(&cache, key_main, &obj_main)
+            && cc_cache_load_ir(&cache, key_library, &obj_library));
+        cc_vmprogram_create(&program);
+        test_assert("Expected cached objects to link", cc_vmprogram_link(&program, &obj_main) && cc_vmprogram_link(&program, &obj_library));
+        cc_ir_object_destroy(&obj_main);
+        cc_ir_object_destroy(&obj_library);
+        run_until_exit(&program, cc_vmprogram_get_symbol(&program, "main", -1), RUN_CHECKED, NULL);
+        test_assert("Expected the same answer from cached objects", was_answer_found);
+
+        uint64_t key_program = cc_fnv1a_64_append(key_main, &key_library, sizeof(key_library));
+        test_assert("Expected an image to be cached", cc_cache_store_program(&cache, key_program, &program));
+        cc_vmprogram_destroy(&program);
+        test_assert("Expected a cached image to be loaded", cc_cache_load_program(&cache, key_program, &program));
+        run_until_exit(&program, cc_vmprogram_get_symbol(&program, "main", -1), RUN_CHECKED, NULL);
+        test_assert("Expected the same answer from a cached image", was_answer_found);
+        cc_vmprogram_destroy(&program);
+        cc_cache_destroy(&cache);
+
+        // A smaller bound evicts older entries, but keeps the newest
+        cc_ir_object* small = create_hashed_object("small", "other");
+        test_assert("Expected a cache to be reopened", cc_cache_create(&cache, dir, 1));
+        test_assert("Expected reopening to evict everything over the bound", cache.size == 0);
+        test_assert("Expected an object larger than the bound to be cached", cc_cache_store_ir(&cache, key_main, small));
+        cc_ir_object_destroy(small);
+        test_assert("Expected the newest entry to be kept", cc_cache_load_ir(&cache, key_main, &obj_main)
+            && !cc_cache_load_ir(&cache, key_library, &obj_library));
+        cc_ir_object_destroy(&obj_main);
+        cc_cache_destroy(&cache);
+
+        cc_cache_create(&cache, dir, 0);
+        cc_cache_destroy(&cache);
+        remove(dir);
+    }
+
+    // Compile objects on several threads, then link them in order
+    {
+        enum { NUM_OBJECTS = 64, NUM_THREADS = 4 };
+        cc_ir_object* objs[NUM_OBJECTS + 2];
+        for (int i = 0; i < NUM_OBJECTS; ++i)
+        {
+            char name[16], import_name[16];
+            snprintf(name, sizeof(name), "f%d", i);
+            snprintf(import_name, sizeof(import_name), "f%d", (i + 1) % NUM_OBJECTS);
+            objs[i] = create_hashed_object(name, import_name);
+        }
+        objs[NUM_OBJECTS] = create_main_object();
+        objs[NUM_OBJECTS + 1] = create_library_object();
+
+        cc_vmprogram serial;
+        cc_vmprogram_create(&serial);
+        for (int i = 0; i < NUM_OBJECTS + 2; ++i)
+            cc_vmprogram_link(&serial, objs[i]);
+        cc_vmprogram_create(&program);
+        test_assert("Expected objects to be linked in parallel",
+            cc_vmprogram_link_many(&program, (const cc_ir_object* const*)objs, NUM_OBJECTS + 2, NUM_THREADS));
+        bool is_same = program.num_symbols == serial.num_symbols && program.num_ins_chunks == serial.num_ins_chunks;
+        for (size_t i = 0; is_same && i < program.num_ins_chunks; ++i)
+        {
+            is_same = program.ins_chunk_lengths[i] == serial.ins_chunk_lengths[i]
+                && !memcmp(program.ins_chunks[i], serial.ins_chunks[i], program.ins_chunk_lengths[i] * sizeof(cc_ir_ins));
+        }
+        test_assert("Expected the same program as linking one at a time", is_same);
+        bool is_resolved = true;
+        for (size_t i = 0; i < program.num_imports; ++i)
+            is_resolved = is_resolved && program.imports[i] == NULL;
+        test_assert("Expected imports between parallel objects to be resolved", is_resolved);
+        run_until_exit(&program, cc_vmprogram_get_symbol(&program, "main", -1), RUN_CHECKED, NULL);
+        test_assert("Expected the same answer from objects linked in parallel", was_answer_found);
+        cc_vmprogram_destroy(&serial);
+        cc_vmprogram_destroy(&program);
+
+        // An object that fails to compile links nothing
+        cc_ir_block_addrl(objs[1]->symbols[0].ptr.func->entry_block, 1000);
+        cc_vmprogram_create(&program);
+        test_assert("Expected an invalid object to fail",
+            !cc_vmprogram_link_many(&program, (const cc_ir_object* const*)objs, NUM_OBJECTS, NUM_THREADS));
+        test_assert("Expected no object to be linked after a failure", program.num_symbols == 0 && program.num_ins_chunks == 0);
+        cc_vmprogram_destroy(&program);
+        for (int i = 0; i < NUM_OBJECTS + 2; ++i)
+            cc_ir_object_destroy(objs[i]);
+    }
+
+    // Share one program between VMs on several threads
+    {
+        enum { NUM_INSTANCES = 8 };
+        cc_vmprogram_create(&program);
+        program.jit = true;
+        cc_ir_object* obj_trusted = create_trusted_object();
+        test_assert("shared object must link successfully", cc_vmprogram_link(&program, obj_trusted));
+
+        cc_vmprogram_share(&program);
+        bool is_pending = false;
+        for (size_t i = 0; i < program.num_symbols; ++i)
+            is_pending = is_pending || program.tiers[i].func;
+        test_assert("Expected no function to wait for compilation in a shared program", program.is_shared && !is_pending);
+        test_assert("Expected a shared program to refuse linking", !cc_vmprogram_link(&program, obj_trusted)
+            && !cc_vmprogram_relink(&program, 0, obj_trusted) && !cc_vmprogram_unlink(&program, 0) && program.num_ins_chunks == 1);
+        cc_ir_object_destroy(obj_trusted);
+
+        struct shared_instance instances[NUM_INSTANCES];
+        memset(instances, 0, sizeof(instances));
+#ifndef _WIN32
+        pthread_t threads[NUM_INSTANCES];
+        for (int i = 0; i < NUM_INSTANCES; ++i)
+        {
+            instances[i].program = &program;
+            pthread_create(&threads[i], NULL, &run_shared, &instances[i]);
+        }
+        for (int i = 0; i < NUM_INSTANCES; ++i)
+            pthread_join(threads[i], NULL);
+#else
+        for (int i = 0; i < NUM_INSTANCES; ++i)
+        {
+            instances[i].program = &program;
+            run_shared(&instances[i]);
+        }
+#endif
+        bool is_answered = true;
+        for (int i = 0; i < NUM_INSTANCES; ++i)
+            is_answered = is_answered && instances[i].answer == TEST_ANSWER;
+        test_assert("Expected every VM to find the answer", is_answered);
+        cc_vmprogram_destroy(&program);
+    }
+
+    // Run arithmetic at every native width, and one bigint width
+    {
+        const cc_ir_datasize widths[] = { 1, 2, 4, 8 };
+        int is_correct = 1, is_raised = 1;
+        for (size_t i = 0; i < sizeof(widths) / sizeof(widths[0]); ++i)
+        {
+            const cc_ir_datasize w = widths[i];
+            const uint64_t bits = w * 8;
+            const uint64_t mask = w == 8 ? UINT64_MAX : ((uint64_t)1 << bits) - 1;
+            const uint64_t min = (uint64_t)1 << (bits - 1);
+            // Operands are pushed as one block: `lhs`, which is popped first, then `rhs`
+            uint8_t operands[16], stack[16];
+            cc_ir_ins ins;
+            memset(&ins, 0, sizeof(ins));
+            ins.data_size = w;
+            #define OPERANDS(lhs, rhs) (memcpy(operands, &(uint64_t){ lhs }, w), memcpy(operands + w, &(uint64_t){ rhs }, w))
+            #define RESULT() (memcpy(&result, stack, w), result & mask)
+            uint64_t result = 0;
+
+            // Dividing by zero leaves both operands on the stack
+            const uint8_t divides[] = { CC_IR_OPCODE_DIV, CC_IR_OPCODE_UDIV, CC_IR_OPCODE_MOD, CC_IR_OPCODE_UMOD };
+            for (size_t j = 0; j < sizeof(divides); ++j)
+            {
+                ins.opcode = divides[j];
+                OPERANDS(7, 0);
+                is_raised = is_raised && run_ins(&ins, operands, w * 2, stack, w * 2) == CC_VMEXCEPTION_DIVIDE_BY_ZERO
+                    && !memcmp(stack, operands, w * 2);
+            }
+
+            ins.opcode = CC_IR_OPCODE_DIV;
+            OPERANDS(-7, 2);
+            is_correct = is_correct && !run_ins(&ins, operands, w * 2, stack, w) && RESULT() == (-3 & mask);
+            OPERANDS(min, -1);
+            is_correct = is_correct && !run_ins(&ins, operands, w * 2, stack, w) && RESULT() == min;
+            ins.opcode = CC_IR_OPCODE_MOD;
+            OPERANDS(-7, 2);
+            is_correct = is_correct && !run_ins(&ins, operands, w * 2, stack, w) && RESULT() == (-1 & mask);
+            OPERANDS(min, -1);
+            is_correct = is_correct && !run_ins(&ins, operands, w * 2, stack, w) && RESULT() == 0;
+            ins.opcode = CC_IR_OPCODE_UDIV;
+            OPERANDS(mask, 2);
+            is_correct = is_correct && !run_ins(&ins, operands, w * 2, stack, w) && RESULT() == mask >> 1;
+            ins.opcode = CC_IR_OPCODE_UMOD;
+            OPERANDS(mask, 16);
+            is_correct = is_correct && !run_ins(&ins, operands, w * 2, stack, w) && RESULT() == 15;
+
+            ins.opcode = CC_IR_OPCODE_NEG;
+            OPERANDS(1, 0);
+            is_correct = is_correct && !run_ins(&ins, operands, w, stack, w) && RESULT() == mask;
+            OPERANDS(min, 0);
+            is_correct = is_correct && !run_ins(&ins, operands, w, stack, w) && RESULT() == min;
+
+            // Shifting by the width or more clears every bit
+            ins.opcode = CC_IR_OPCODE_LSH;
+            OPERANDS(1, bits - 1);
+            is_correct = is_correct && !run_ins(&ins, operands, w * 2, stack, w) && RESULT() == min;
+            OPERANDS(1, bits);
+            is_correct = is_correct && !run_ins(&ins, operands, w * 2, stack, w) && RESULT() == 0;
+            OPERANDS(mask, bits + 1);
+            is_correct = is_correct && !run_ins(&ins, operands, w * 2, stack, w) && RESULT() == 0;
+            ins.opcode = CC_IR_OPCODE_RSH;
+            OPERANDS(min, bits - 1);
+            is_correct = is_correct && !run_ins(&ins, operands, w * 2, stack, w) && RESULT() == 1;
+            OPERANDS(mask, bits);
+            is_correct = is_correct && !run_ins(&ins, operands, w * 2, stack, w) && RESULT() == 0;
+
+            // Extend (or truncate) to every width
+            const uint64_t pattern = 0x8182838485868788;
+            for (size_t j = 0; j < sizeof(widths) / sizeof(widths[0]); ++j)
+            {
+                const cc_ir_datasize to = widths[j];
+                const uint64_t to_mask = to == 8 ? UINT64_MAX : ((uint64_t)1 << (to * 8)) - 1;
+                const uint64_t zext = pattern & mask, sext = zext | ~mask;
+                ins.operand.extend_data_size = to;
+                OPERANDS(pattern, 0);
+                ins.opcode = CC_IR_OPCODE_ZEXT;
+                result = 0;
+                is_correct = is_correct && !run_ins(&ins, operands, w, stack, to) && (memcpy(&result, stack, to), result) == (zext & to_mask);
+                ins.opcode = CC_IR_OPCODE_SEXT;
+                result = 0;
+                is_correct = is_correct && !run_ins(&ins, operands, w, stack, to) && (memcpy(&result, stack, to), result) == (sext & to_mask);
+            }
+            #undef OPERANDS
+            #undef RESULT
+        }
+        test_assert("Expected dividing by zero to raise an exception, and restore the operands", is_raised);
+        test_assert("Expected the same results at every native width", is_correct);
+
+        // Wider operations run through bigint
+        cc_ir_ins ins;
+        memset(&ins, 0, sizeof(ins));
+        ins.data_size = 16;
+        uint8_t operands[32], stack[32], expected[16];
+        ins.opcode = CC_IR_OPCODE_DIV;
+        cc_bigint_i32(16, operands, -7);
+        cc_bigint_i32(16, operands + 16, 2);
+        cc_bigint_i32(16, expected, -3);
+        test_assert("Expected a bigint division", !run_ins(&ins, operands, 32, stack, 16) && !memcmp(stack, expected, 16));
+        cc_bigint_i32(16, operands + 16, 0);
+        test_assert("Expected a bigint division by zero to raise an exception",
+            run_ins(&ins, operands, 32, stack, 32) == CC_VMEXCEPTION_DIVIDE_BY_ZERO && !memcmp(stack, operands, 32));
+        ins.opcode = CC_IR_OPCODE_LSH;
+        cc_bigint_i32(16, operands, 1);
+        cc_bigint_i32(16, operands + 16, 100);
+        cc_bigint_i32(16, expected, 0);
+        expected[100 / 8] = 1 << (100 % 8);
+        test_assert("Expected a bigint shift", !run_ins(&ins, operands, 32, stack, 16) && !memcmp(stack, expected, 16));
+    }
+
+    // Lay out locals with their natural alignment
+    {
+        cc_ir_object* obj = (cc_ir_object*)calloc(1, sizeof(*obj));
+        cc_ir_object_create(obj);
+        cc_ir_func* func = cc_ir_object_add_func(obj, "aligned", -1);
+        cc_ir_func_int(func, 1, "a");
+        cc_ir_localid b = cc_ir_func_int(func, 8, "b");
+        cc_ir_block_uconst(func->entry_block, 8, 1);    // b = 1
+        cc_ir_block_addrl(func->entry_block, b);
+        cc_ir_block_store(func->entry_block, 8);
+        cc_ir_block_ret(func->entry_block);
+        cc_vmprogram_create(&program);
+        test_assert("aligned object must link successfully", cc_vmprogram_link(&program, obj));
+        cc_ir_object_destroy(obj);
+
+        const cc_ir_ins* ins = (const cc_ir_ins*)cc_vmprogram_get_symbol(&program, "aligned", -1)->ptr;
+        test_assert("Expected an 8-byte local after a 1-byte local to be 8-byte aligned", ins[2].operand.u32 == 8);
+        test_assert("Expected the frame size to be a multiple of the largest alignment", ins[0].operand.u32 == 16);
+        cc_vmprogram_destroy(&program);
+    }
+
+    // Link an object with many symbols and imports, which each function references
+    {
+        enum { NUM_FUNCS = 200 };
+        cc_ir_object* obj = (cc_ir_object*)calloc(1, sizeof(*obj));
+        cc_ir_object_create(obj);
+        cc_ir_symbolid funcs[NUM_FUNCS];
+        for (int i = 0; i < NUM_FUNCS; ++i)
+        {
+            char name[16];
+            snprintf(name, sizeof(name), "f%d", i);
+            cc_ir_object_add_func(obj, name, -1);
+            funcs[i] = obj->symbols[obj->num_symbols - 1].symbolid;
+            snprintf(name, sizeof(name), "g%d", i);
+            cc_ir_object_import(obj, false, name, -1);
+        }
+        // f[i] takes the address of f[i + 1] and g[i]
+        for (int i = 0; i < NUM_FUNCS; ++i)
+        {
+            const cc_ir_symbol* symbol = &obj->symbols[2 * i];
+            cc_ir_block* block = symbol->ptr.func->entry_block;
+            cc_ir_block_addrg(block, funcs[(i + 1) % NUM_FUNCS]);
+            cc_ir_block_free(block, 0);
+            cc_ir_block_addrg(block, obj->symbols[2 * i + 1].symbolid);
+            cc_ir_block_free(block, 0);
+            cc_ir_block_ret(block);
+        }
+        cc_vmprogram_create(&program);
+        test_assert("large object must link successfully", cc_vmprogram_link(&program, obj));
+        cc_ir_object_destroy(obj);
+
+        bool is_remapped = true;
+        for (int i = 0; i < NUM_FUNCS; ++i)
+        {
+            char name[16];
+            snprintf(name, sizeof(name), "f%d", i);
+            const cc_vmsymbol* symbol = cc_vmprogram_get_symbol(&program, name, -1);
+            snprintf(name, sizeof(name), "f%d", (i + 1) % NUM_FUNCS);
+            const cc_vmsymbol* next = cc_vmprogram_get_symbol(&program, name, -1);
+            is_remapped = is_remapped && symbol && next
+                && ((const cc_ir_ins*)symbol->ptr)[1].operand.symbolid == (cc_ir_symbolid)(next - program.symbols);
+        }
+        test_assert("Expected every internal reference to be remapped", is_remapped);
+        size_t num_unresolved = 0;
+        for (size_t i = 0; i < program.num_imports; ++i)
+            num_unresolved += program.imports[i] != NULL;
+        test_assert("Expected every import to be unresolved", num_unresolved == NUM_FUNCS);
+        cc_vmprogram_destroy(&program);
+    }
     return 1;
 }
 
@@ -242,6 +874,137 @@ static cc_ir_object* create_library_object()
     return obj;
 }
 
+static cc_ir_object* create_trusted_object()
+{
+    cc_ir_object* obj = (cc_ir_object*)calloc(1, sizeof(*obj));
+    cc_ir_object_create(obj);
+    cc_ir_symbolid double_arg;
+
+    // void double_arg(int* i) { *i = *i + *i; }
+    {
+        cc_ir_func* func = cc_ir_object_add_func(obj, "double_arg", -1);
+        cc_ir_block* block = func->entry_block;
+        double_arg = func->symbolid;
+
+        cc_ir_block_argp(block);
+        cc_ir_block_load(block, INT_SIZE);
+        cc_ir_block_argp(block);
+        cc_ir_block_load(block, INT_SIZE);
+        cc_ir_block_add(block, INT_SIZE);
+        cc_ir_block_argp(block);
+        cc_ir_block_store(block, INT_SIZE);
+        cc_ir_block_ret(block);
+    }
+    // Calls double_arg(x) until x == TEST_ANSWER
+    {
+        cc_ir_func* func = cc_ir_object_add_func(obj, "main", -1);
+        cc_ir_block* entry = func->entry_block;
+        cc_ir_block* loop = cc_ir_func_insert(func, entry, "loop", -1);
+        cc_ir_block* end = cc_ir_func_insert(func, loop, "end", -1);
+        cc_ir_localid x = cc_ir_func_int(func, INT_SIZE, "x");
+
+        cc_ir_block_uconst(entry, INT_SIZE, TEST_ANSWER / 2);   // x = TEST_ANSWER / 2
+        cc_ir_block_addrl(entry, x);
+        cc_ir_block_store(entry, INT_SIZE);
+
+        cc_ir_block_loadl(loop, x);                             // double_arg(x)
+        cc_ir_block_addrg(loop, double_arg);
+        cc_ir_block_call(loop);
+        cc_ir_block_addrl(loop, x);                             // x = result
+        cc_ir_block_store(loop, INT_SIZE);
+        cc_ir_block_uconst(loop, INT_SIZE, TEST_ANSWER);        // if (x != TEST_ANSWER) goto loop
+        cc_ir_block_loadl(loop, x);
+        cc_ir_block_sub(loop, INT_SIZE);
+        cc_ir_block_jnz(loop, INT_SIZE, loop);
+
+        cc_ir_block_loadl(end, x);
+        cc_ir_block_int(end, INTERRUPT_PEEK_ANSWER);
+        cc_ir_block_free(end, INT_SIZE);
+        cc_ir_block_int(end, INTERRUPT_EXIT);
+        cc_ir_block_ret(end);
+    }
+
+    return obj;
+}
+
+static cc_ir_object* create_native_object()
+{
+    cc_ir_object* obj = (cc_ir_object*)calloc(1, sizeof(*obj));
+    cc_ir_object_create(obj);
+    cc_ir_symbolid triangle;
+
+    // void triangle(int* n) { int32_t sum = 0; for (int i = *n; i != 0; --i) sum += i; *n = -~sum + 4; }
+    {
+        cc_ir_func* func = cc_ir_object_add_func(obj, "triangle", -1);
+        cc_ir_block* entry = func->entry_block;
+        cc_ir_block* loop = cc_ir_func_insert(func, entry, "loop", -1);
+        cc_ir_block* end = cc_ir_func_insert(func, loop, "end", -1);
+        cc_ir_localid sum = cc_ir_func_int(func, 4, "sum");
+        cc_ir_localid i = cc_ir_func_int(func, INT_SIZE, "i");
+        triangle = func->symbolid;
+
+        cc_ir_block_uconst(entry, 4, 0);            // sum = 0
+        cc_ir_block_addrl(entry, sum);
+        cc_ir_block_store(entry, 4);
+        cc_ir_block_argp(entry);                    // i = *n
+        cc_ir_block_load(entry, INT_SIZE);
+        cc_ir_block_addrl(entry, i);
+        cc_ir_block_store(entry, INT_SIZE);
+
+        cc_ir_block_loadl(loop, i);                 // sum += (int32_t)i
+        cc_ir_block_zext(loop, INT_SIZE, 4);
+        cc_ir_block_loadl(loop, sum);
+        cc_ir_block_add(loop, 4);
+        cc_ir_block_addrl(loop, sum);
+        cc_ir_block_store(loop, 4);
+        cc_ir_block_uconst(loop, INT_SIZE, 1);      // if (--i != 0) goto loop
+        cc_ir_block_loadl(loop, i);
+        cc_ir_block_sub(loop, INT_SIZE);
+        cc_ir_block_dupe(loop, INT_SIZE);
+        cc_ir_block_addrl(loop, i);
+        cc_ir_block_store(loop, INT_SIZE);
+        cc_ir_block_jnz(loop, INT_SIZE, loop);
+
+        cc_ir_block_loadl(end, sum);                // *n = -~sum + 4
+        cc_ir_block_not(end, 4);
+        cc_ir_block_neg(end, 4);
+        cc_ir_block_sext(end, 4, INT_SIZE);
+        cc_ir_block_iconst(end, INT_SIZE, 4);
+        cc_ir_block_add(end, INT_SIZE);
+        cc_ir_block_argp(end);
+        cc_ir_block_store(end, INT_SIZE);
+        cc_ir_block_ret(end);
+    }
+    // Calls triangle(17), which is TEST_ANSWER
+    {
+        cc_ir_func* func = cc_ir_object_add_func(obj, "main", -1);
+        cc_ir_block* entry = func->entry_block;
+
+        cc_ir_block_uconst(entry, INT_SIZE, 17);
+        cc_ir_block_addrg(entry, triangle);
+        cc_ir_block_call(entry);
+        cc_ir_block_int(entry, INTERRUPT_PEEK_ANSWER);
+        cc_ir_block_free(entry, INT_SIZE);
+        cc_ir_block_int(entry, INTERRUPT_EXIT);
+        cc_ir_block_ret(entry);
+    }
+
+    return obj;
+}
+
+static cc_ir_object* create_hashed_object(const char* name, const char* import_name)
+{
+    cc_ir_object* obj = (cc_ir_object*)calloc(1, sizeof(*obj));
+    cc_ir_object_create(obj);
+
+    // Takes the address of the imported function and discards it
+    cc_ir_func* func = cc_ir_object_add_func(obj, name, -1);
+    cc_ir_symbolid import = cc_ir_object_import(obj, false, import_name, -1);
+    cc_ir_block_addrg(func->entry_block, import);
+    cc_ir_block_free(func->entry_block, 0);
+    cc_ir_block_ret(func->entry_block);
+    return obj;
+}
 static void interrupt_handler(cc_vm* vm, uint32_t code)
 {
     switch (code)
@@ -255,6 +1018,14 @@ static void interrupt_handler(cc_vm* vm, uint32_t code)
         test_assert("Expected the correct answer", !memcmp(result, answer_extended, INT_SIZE));
         was_answer_found = true;
         break;
+    case INTERRUPT_PEEK_ANSWER:
+    {
+        int64_t answer;
+        memcpy(&answer, vm->sp, sizeof(answer));
+        test_assert("Expected the correct answer on top of the stack", answer == TEST_ANSWER);
+        was_answer_found = true;
+        break;
+    }
     case INTERRUPT_EXIT:
         printf("VM has reached the exit interrupt\n");
         was_exit_reached = true;
@@ -270,4 +1041,89 @@ static void interrupt_handler(cc_vm* vm, uint32_t code)
         break;
     }
     }
-}
\ No newline at end of file
+}
+/**
+ * @brief Run from `entry` until the exit interrupt, and handle every other interrupt
+ * @param profile (optional) Count executed sequences with @ref cc_vm_run_profiled, instead of running by `mode`
+ * @return The number of executed instructions
+ */
+static size_t run_until_exit(const cc_vmprogram* program, const cc_vmsymbol* entry, run_mode mode, cc_vmprofile* profile)
+{
+    cc_vm vm;
+    size_t steps = 0;
+    was_answer_found = false;
+    was_exit_reached = false;
+    virtual_print_cursor = 0;
+    cc_vm_create(&vm, 0x1000, program);
+    vm.ip = (uint8_t*)entry->ptr;
+    while (!was_exit_reached)
+    {
+        size_t run_steps;
+        if (profile)
+            run_steps = cc_vm_run_profiled(&vm, (size_t)-1, profile);
+        else if (mode == RUN_TRUSTED)
+            run_steps = cc_vm_run_trusted(&vm, (size_t)-1);
+        else
+            run_steps = cc_vm_run(&vm, mode == RUN_STEPPED ? 1 : (size_t)-1);
+        test_assert("The VM must execute at least one instruction", run_steps > 0);
+        steps += run_steps;
+        if (mode == RUN_STEPPED && vm.vmexception == CC_VMEXCEPTION_NONE)
+            continue;
+        test_assert("The VM must only stop for interrupts", vm.vmexception == CC_VMEXCEPTION_INTERRUPT);
+        vm.vmexception = CC_VMEXCEPTION_NONE;
+        interrupt_handler(&vm, vm.interrupt);
+    }
+    cc_vm_destroy(&vm);
+    return steps;
+}
+static void* run_shared(void* instance)
+{
+    struct shared_instance* shared = (struct shared_instance*)instance;
+    cc_vm vm;
+    cc_vm_create(&vm, 0x1000, shared->program);
+    vm.ip = (uint8_t*)cc_vmprogram_get_symbol(shared->program, "main", -1)->ptr;
+    // Handle interrupts here, because the test's handler is not thread-safe
+    while (cc_vm_run(&vm, (size_t)-1), vm.vmexception == CC_VMEXCEPTION_INTERRUPT && vm.interrupt != INTERRUPT_EXIT)
+    {
+        if (vm.interrupt == INTERRUPT_PEEK_ANSWER)
+            memcpy(&shared->answer, vm.sp, sizeof(shared->answer));
+        vm.vmexception = CC_VMEXCEPTION_NONE;
+    }
+    cc_vm_destroy(&vm);
+    return NULL;
+}
+/**
+ * @brief Link a function of one instruction, and run it on operands pushed by the host
+ * @param operands Copied to the top of the stack, so the first bytes are popped first
+ * @param out_stack Receives `stack_size` bytes from the top of the stack, when the instruction finished or raised an exception
+ * @return The exception raised by the instruction, or @ref CC_VMEXCEPTION_NONE
+ */
+static cc_vmexception run_ins(const cc_ir_ins* ins, const uint8_t* operands, size_t operands_size, uint8_t* out_stack, size_t stack_size)
+{
+    cc_ir_object obj;
+    cc_ir_object_create(&obj);
+    cc_ir_func* func = cc_ir_object_add_func(&obj, "ins", -1);
+    cc_ir_block_insert(func->entry_block, func->entry_block->num_ins, ins);
+    cc_ir_block_int(func->entry_block, INTERRUPT_EXIT);
+    cc_ir_block_ret(func->entry_block);
+
+    cc_vmprogram program;
+    cc_vmprogram_create(&program);
+    test_assert("An instruction must link successfully", cc_vmprogram_link(&program, &obj));
+    cc_ir_object_destroy(&obj);
+    const cc_ir_ins* code = (const cc_ir_ins*)cc_vmprogram_get_symbol(&program, "ins", -1)->ptr;
+    test_assert("Expected a function to begin with its frame", code->opcode == CC_IR_OPCODE_FRAME);
+
+    // Skip the frame, which the instruction does not use, so the operands are on top
+    cc_vm vm;
+    cc_vm_create(&vm, 0x1000, &program);
+    vm.sp -= operands_size;
+    memcpy(vm.sp, operands, operands_size);
+    vm.ip = (uint8_t*)(code + 1);
+    cc_vm_run(&vm, (size_t)-1);
+    cc_vmexception vmexception = vm.vmexception == CC_VMEXCEPTION_INTERRUPT ? CC_VMEXCEPTION_NONE : vm.vmexception;
+    memcpy(out_stack, vm.sp, stack_size);
+    cc_vm_destroy(&vm);
+    cc_vmprogram_destroy(&program);
+    return vmexception;
+}
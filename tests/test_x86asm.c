@@ -281,6 +281,50 @@ int test_x86asm(void)
         
         x86func_destroy(&func);
     }
+    { // Test logic, shifts, and lea in long mode
+        x86func_create(&func, X86_MODE_LONG);
+
+        size_t offset = func.size_code;
+        x86func_and(&func, X86_OPSIZE_QWORD, x86_deref(X86_REG_SP), x86_reg(X86_REG_A));
+        test_assert("Expected `and QWORD PTR [rsp], rax`", equal_code(&func, offset, "\x48\x21\x04\x24"));
+
+        offset = func.size_code;
+        x86func_xor(&func, 0, x86_reg(X86_REG_C), x86_const(0x1000));
+        test_assert("Expected `xor ecx, 0x1000`", equal_code(&func, offset, "\x81\xF1\x00\x10\x00\x00"));
+
+        offset = func.size_code;
+        x86func_not(&func, X86_OPSIZE_QWORD, x86_reg(X86_REG_R8));
+        test_assert("Expected `not r8`", equal_code(&func, offset, "\x49\xF7\xD0"));
+
+        offset = func.size_code;
+        x86func_sar(&func, X86_OPSIZE_QWORD, x86_reg(X86_REG_A), x86_const(56));
+        test_assert("Expected `sar rax, 56`", equal_code(&func, offset, "\x48\xC1\xF8\x38"));
+
+        offset = func.size_code;
+        x86func_shl(&func, 0, x86_reg(X86_REG_D), x86_reg(X86_REG_C));
+        test_assert("Expected `shl edx, cl`", equal_code(&func, offset, "\xD3\xE2"));
+
+        offset = func.size_code;
+        x86func_lea(&func, X86_OPSIZE_QWORD, X86_REG_A, x86_index(X86_REG_BP, X86_REG_SP, X86_SIB_SCALE_1, -24));
+        test_assert("Expected `lea rax, [rbp-24]`", equal_code(&func, offset, "\x48\x8D\x45\xE8"));
+
+        x86func_destroy(&func);
+    }
+    { // Test a backward jump that does not fit in 8 bits
+        x86func_create(&func, X86_MODE_LONG);
+        x86label loop = x86func_newlabel(&func);
+        x86func_label(&func, loop);
+        for (int i = 0; i < 100; ++i)
+            x86func_add(&func, 0, x86_reg(X86_REG_A), x86_reg(X86_REG_C)); // 200 bytes
+
+        size_t offset = func.size_code;
+        x86func_jnz(&func, loop);
+        test_assert("Expected `jnz` to the start of the code", equal_code(&func, offset, "\x0F\x85\x32\xFF\xFF\xFF"));
+        offset = func.size_code;
+        x86func_jmp(&func, loop);
+        test_assert("Expected `jmp` to the start of the code", equal_code(&func, offset, "\xE9\x2D\xFF\xFF\xFF"));
+        x86func_destroy(&func);
+    }
 
     return 1;
 }
\ No newline at end of file
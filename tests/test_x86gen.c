@@ -2,7 +2,148 @@
 #include <cc/x86_gen.h>
 #include <stdio.h>
 
+/// @brief Check if an x86 function is exactly the sequence of bytes in `expected`
+static int equal_code(const x86func* func, const char* expected, size_t expected_len)
+{
+    int result = func->size_code == expected_len && memcmp(func->code, expected, expected_len) == 0;
+    if (!result)
+    {
+        printf("Expected x86:  ");
+        for (size_t i = 0; i < expected_len; ++i)
+            printf(" %.2X", (uint8_t)expected[i]);
+        printf("\n");
+        printf("Incorrect x86: ");
+        for (size_t i = 0; i < func->size_code; ++i)
+            printf(" %.2X", func->code[i]);
+        printf("\n");
+    }
+    return result;
+}
+
 int test_x86gen(void)
 {
+    { // Test the prologue and epilogue
+        cc_ir_func* irfunc = cc_ir_func_create(0);
+        cc_ir_block_ret(irfunc->entry_block);
+
+        x86gen gen;
+        x86func func;
+        x86gen_create(&gen, &X86_CONV_SYSV64_CDECL, irfunc);
+        test_assert("Expected an empty function to compile", x86gen_dump(&gen, &func));
+
+        // push rbp; mov rbp, rsp; push rbx; mov rbx, rdi
+        // mov rbx, [rbp-8]; mov rsp, rbp; pop rbp; ret
+        const char expected[] = "\x55\x48\x89\xE5\x53\x48\x89\xFB" "\x48\x8B\x5D\xF8\x48\x89\xEC\x5D\xC3";
+        // The last block falls through to a second epilogue
+        test_assert("Expected a prologue and an epilogue", func.size_code > sizeof(expected) - 1
+            && !memcmp(func.code, expected, sizeof(expected) - 1));
+        x86func_destroy(&func);
+        x86gen_destroy(&gen);
+        cc_ir_func_destroy(irfunc);
+    }
+    { // Test locals and instruction templates
+        cc_ir_func* irfunc = cc_ir_func_create(0);
+        cc_ir_localid x = cc_ir_func_int(irfunc, 4, "x");
+        cc_ir_block* block = irfunc->entry_block;
+        cc_ir_block_argp(block);        // x = *(int32_t*)argp
+        cc_ir_block_load(block, 4);
+        cc_ir_block_addrl(block, x);
+        cc_ir_block_store(block, 4);
+
+        x86gen gen;
+        x86func func;
+        x86gen_create(&gen, &X86_CONV_SYSV64_CDECL, irfunc);
+        test_assert("Expected a function with locals to compile", x86gen_dump(&gen, &func));
+
+        // The operand stack starts at RDX, and x is in RSI. Nothing is in memory, so there is no frame.
+        const char expected[] =
+            "\x55\x48\x89\xE5\x53\x48\x89\xFB"  // Prologue
+            "\x48\x89\xDA"                      // mov rdx, rbx
+            "\x8B\x12"                          // mov edx, [rdx]
+            "\x48\x89\xD6"                      // mov rsi, rdx
+            "\x48\x8B\x5D\xF8\x48\x89\xEC\x5D\xC3"; // Epilogue
+        test_assert("Expected matching code for `x = *argp`", equal_code(&func, expected, sizeof(expected) - 1));
+        x86func_destroy(&func);
+        x86gen_destroy(&gen);
+        cc_ir_func_destroy(irfunc);
+    }
+    { // Test locals whose address is taken
+        cc_ir_func* irfunc = cc_ir_func_create(0);
+        cc_ir_localid x = cc_ir_func_int(irfunc, 8, "x");
+        cc_ir_block* block = irfunc->entry_block;
+        cc_ir_block_uconst(block, 8, 1);    // *&x = 1
+        cc_ir_block_addrl(block, x);
+        cc_ir_block_dupe(block, 8);
+        cc_ir_block_free(block, 8);
+        cc_ir_block_store(block, 8);
+
+        x86gen gen;
+        x86func func;
+        uint32_t value;
+        x86gen_create(&gen, &X86_CONV_SYSV64_CDECL, irfunc);
+        test_assert("Expected a function with an addressed local to compile", x86gen_dump(&gen, &func));
+        test_assert("Expected an addressed local to stay in memory", cc_hmap32_get(&gen.map_locals, x, &value)
+            && !cc_hmap32_get(&gen.map_registers, x, &value));
+        x86func_destroy(&func);
+        x86gen_destroy(&gen);
+        cc_ir_func_destroy(irfunc);
+    }
+    { // Test register pressure
+        enum { NUM_LOCALS = 16 };
+        cc_ir_func* irfunc = cc_ir_func_create(0);
+        cc_ir_localid locals[NUM_LOCALS];
+        cc_ir_block* block = irfunc->entry_block;
+        for (int i = 0; i < NUM_LOCALS; ++i)
+        {
+            char name[8];
+            snprintf(name, sizeof(name), "x%d", i);
+            locals[i] = cc_ir_func_int(irfunc, 8, name);
+            cc_ir_block_uconst(block, 8, (uint32_t)i);
+            cc_ir_block_addrl(block, locals[i]);
+            cc_ir_block_store(block, 8);
+        }
+        // Every local is live until here
+        for (int i = 0; i < NUM_LOCALS; ++i)
+        {
+            cc_ir_block_loadl(block, locals[i]);
+            cc_ir_block_free(block, 8);
+        }
+
+        x86gen gen;
+        x86func func;
+        x86gen_create(&gen, &X86_CONV_SYSV64_CDECL, irfunc);
+        test_assert("Expected a function with many locals to compile", x86gen_dump(&gen, &func));
+        int num_registers = 0, num_spilled = 0;
+        for (int i = 0; i < NUM_LOCALS; ++i)
+        {
+            uint32_t value;
+            num_registers += cc_hmap32_get(&gen.map_registers, locals[i], &value);
+            num_spilled += cc_hmap32_get(&gen.map_locals, locals[i], &value);
+        }
+        // 11 registers are free, and one holds the operand stack
+        test_assert("Expected locals to spill only when registers run out", num_registers == 10 && num_spilled == NUM_LOCALS - 10);
+        test_assert("Expected callee-saved registers to be saved", gen.save_offsets[X86_REG_R12] && gen.save_offsets[X86_REG_R15]
+            && !gen.save_offsets[X86_REG_D]);
+        x86func_destroy(&func);
+        x86gen_destroy(&gen);
+        cc_ir_func_destroy(irfunc);
+    }
+    { // Test unsupported instructions
+        cc_ir_func* irfunc = cc_ir_func_create(0);
+        cc_ir_block* block = irfunc->entry_block;
+        cc_ir_block_uconst(block, 8, 10);
+        cc_ir_block_uconst(block, 8, 0);
+        cc_ir_block_udiv(block, 8);
+        cc_ir_block_free(block, 8);
+        cc_ir_block_ret(block);
+
+        x86gen gen;
+        x86func func;
+        x86gen_create(&gen, &X86_CONV_SYSV64_CDECL, irfunc);
+        test_assert("Expected division to be unsupported", !x86gen_dump(&gen, &func));
+        x86gen_destroy(&gen);
+        cc_ir_func_destroy(irfunc);
+    }
+
     return 1;
-}
\ No newline at end of file
+}